@@ -0,0 +1,449 @@
+#include "AnalysisServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <utility>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Bootstrapper.h"
+#include "StockGrouper.h"
+#include "ThreadUtils.h"
+
+using namespace std;
+
+namespace fre {
+
+    namespace {
+        // Set by SIGINT / SIGTERM; the poll loop checks it every kPollMs
+        atomic<bool> g_stopServing{false};
+
+        void onStopSignal(int) { g_stopServing.store(true); }
+
+        const int kPollMs = 200;
+        const size_t kMaxRequest = 4096;  // longer lines are rejected and the connection closed
+        const int kSendTimeoutSec = 5;
+        const int kMaxResamples = 10000;
+
+        string upper(string s) {
+            for (char& c : s) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+            return s;
+        }
+
+        string reply(const vector<string>& lines) {
+            string out = "OK " + to_string(lines.size()) + "\n";
+            for (const string& line : lines) out += line + "\n";
+            return out;
+        }
+
+        string fail(const string& message) {
+            return "ERR " + message + "\n";
+        }
+
+        string number(double v) {
+            ostringstream os;
+            os << setprecision(10) << v;
+            return os.str();
+        }
+
+        string testColumns(const EventTestRow& r) {
+            return number(r.meanAR) + "," + number(r.tCS) + "," + number(r.patellZ) + ","
+                 + number(r.bmpT) + "," + number(r.corradoT);
+        }
+
+        // Row of the result matrix and the group of the state: 0 = Miss, 1 = Meet, 2 = Beat
+        int groupIndex(const string& name) {
+            string g = upper(name);
+            if (g == "MISS") return 0;
+            if (g == "MEET") return 1;
+            if (g == "BEAT") return 2;
+            return -1;
+        }
+
+        bool allDigits(const string& token) {
+            return all_of(token.begin(), token.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)) != 0; });
+        }
+
+        bool parseCount(const string& token, int& value) {
+            if (token.empty() || !allDigits(token) || token.size() > 9) return false;
+            value = stoi(token);
+            return true;
+        }
+
+        bool sendAll(int fd, const string& data) {
+            size_t sent = 0;
+            while (sent < data.size()) {
+                ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return false;
+                sent += static_cast<size_t>(n);
+            }
+            return true;
+        }
+    }
+
+    shared_ptr<const ServerState> captureServerState(const StockRegistry& registry,
+                                                     const StatCalculator& stats,
+                                                     AbnormalReturnModel model)
+    {
+        auto state = make_shared<ServerState>();
+        state->N = stats.getN();
+        state->model = model;
+        for (EventId id = 0; id < registry.size(); ++id)
+            state->events.emplace(registry.key(id), registry.snapshot(id));
+        StockGrouper::extractValidGroups(registry, state->beat, state->meet, state->miss);
+        state->stats.reset(new StatCalculator(stats));
+        return state;
+    }
+
+    void AnalysisServer::publish(shared_ptr<const ServerState> state)
+    {
+        lock_guard<mutex> lock(stateMutex_);
+        state_ = std::move(state);
+    }
+
+    shared_ptr<const ServerState> AnalysisServer::current() const
+    {
+        lock_guard<mutex> lock(stateMutex_);
+        return state_;
+    }
+
+    string AnalysisServer::handle(const string& request) const
+    {
+        istringstream in(request);
+        string cmd;
+        in >> cmd;
+        cmd = upper(cmd);
+        if (cmd.empty()) return fail("empty request");
+        if (cmd == "PING") return reply({"pong"});
+
+        shared_ptr<const ServerState> state = current();
+        if (!state || !state->stats) return fail("no results published");
+        const StatCalculator& calc = *state->stats;
+        const int N = state->N;
+
+        // --- 1. Universe and single events (Option 2) ---
+        if (cmd == "INFO") {
+            return reply({
+                "N," + to_string(N),
+                string("model,") + (state->model == AbnormalReturnModel::MarketModel ? "market-model" : "market-adjusted"),
+                "events," + to_string(state->events.size()),
+                "miss," + to_string(state->miss.size()),
+                "meet," + to_string(state->meet.size()),
+                "beat," + to_string(state->beat.size()),
+                "requests," + to_string(requests_.load())
+            });
+        }
+
+        if (cmd == "STOCK") {
+            string ticker;
+            if (!(in >> ticker)) return fail("usage: STOCK <ticker>");
+            ticker = upper(ticker);
+
+            vector<string> lines;
+            auto it = state->events.lower_bound(EventKey(ticker, ""));
+            for (; it != state->events.end() && it->first.first == ticker; ++it) {
+                ostringstream os;
+                os << it->second;
+                string line;
+                istringstream text(os.str());
+                while (getline(text, line)) lines.push_back(line);
+            }
+            if (lines.empty()) return fail("unknown ticker " + ticker);
+            return reply(lines);
+        }
+
+        // --- 2. Group results of the run (Options 3 and 4) ---
+        if (cmd == "STATS" || cmd == "SERIES") {
+            string name;
+            in >> name;
+            int g = groupIndex(name);
+            if (g < 0) return fail("usage: " + cmd + " <miss|meet|beat>");
+
+            const GroupStats& stats = (g == 0) ? calc.getMissStats() : (g == 1) ? calc.getMeetStats() : calc.getBeatStats();
+            const EventTestResult& tests = (g == 0) ? calc.getMissTests() : (g == 1) ? calc.getMeetTests() : calc.getBeatTests();
+
+            vector<string> lines;
+            if (cmd == "STATS") {
+                const Matrix& result = calc.getResultMatrix();
+                if (g >= static_cast<int>(result.size()) || result[g].size() < 4) return fail("no results published");
+                lines.push_back("expected_aar," + number(result[g][0]));
+                lines.push_back("aar_std," + number(result[g][1]));
+                lines.push_back("expected_caar," + number(result[g][2]));
+                lines.push_back("caar_std," + number(result[g][3]));
+                lines.push_back("window,n,n_std,mean_car,t_cs,patell_z,bmp_t,corrado");
+                for (size_t w = 0; w < tests.car.size(); ++w) {
+                    const EventTestRow& r = tests.car[w];
+                    lines.push_back(to_string(tests.carWindows[w].first) + ":" + to_string(tests.carWindows[w].second)
+                                    + "," + to_string(r.n) + "," + to_string(r.nStd) + "," + testColumns(r));
+                }
+                return reply(lines);
+            }
+
+            lines.push_back("t,aar_mean,aar_std,caar_mean,caar_std,mean_ar,t_cs,patell_z,bmp_t,corrado");
+            for (int t = -N + 1; t <= N; ++t) {
+                size_t i = static_cast<size_t>(t + N - 1);
+                if (i >= stats.AAR_mean.size()) break;
+                string line = to_string(t) + "," + number(stats.AAR_mean[i]) + "," + number(stats.AAR_std[i]) + ","
+                            + number(stats.CAAR_mean[i]) + "," + number(stats.CAAR_std[i]) + ",";
+                line += (i < tests.daily.size()) ? testColumns(tests.daily[i]) : ",,,,";
+                lines.push_back(line);
+            }
+            return reply(lines);
+        }
+
+        if (cmd == "CAAR") {
+            const vector<Vector>& caar = calc.getCAARMeanForGnuplot();  // Beat, Meet, Miss
+            if (caar.size() < 3) return fail("no results published");
+            vector<string> lines{"t,beat,meet,miss"};
+            for (size_t i = 0; i < caar[0].size(); ++i) {
+                lines.push_back(to_string(static_cast<int>(i) - N + 1) + "," + number(caar[0][i]) + ","
+                                + number(caar[1][i]) + "," + number(caar[2][i]));
+            }
+            return reply(lines);
+        }
+
+        // --- 3. A new bootstrap of the published groups ---
+        if (cmd == "BOOTSTRAP") {
+            string resamplesText, sizeText, seedText;
+            int resamples = 0, sampleSize = 0;
+            in >> resamplesText >> sizeText >> seedText;
+            if (!parseCount(resamplesText, resamples) || !parseCount(sizeText, sampleSize)
+                || resamples < 1 || sampleSize < 1 || resamples > kMaxResamples)
+                return fail("usage: BOOTSTRAP <resamples 1-" + to_string(kMaxResamples) + "> <sample size> [seed]");
+
+            Bootstrapper bootstrapper(N, resamples, sampleSize);
+            if (!seedText.empty()) {
+                if (!allDigits(seedText) || seedText.size() > 19)
+                    return fail("seed must be a non-negative integer");
+                bootstrapper.setSeed(stoull(seedText));
+            }
+
+            GroupBootstrapResult missResult, meetResult, beatResult;
+            bootstrapper.runBootstrap(state->miss, state->meet, state->beat, missResult, meetResult, beatResult);
+            StatCalculator fresh(N);
+            fresh.computeForAllGroup(missResult, meetResult, beatResult);
+            const Matrix& result = fresh.getResultMatrix();
+
+            vector<string> lines{"seed," + to_string(bootstrapper.getSeed()),
+                                 "group,expected_aar,aar_std,expected_caar,caar_std"};
+            const char* names[3] = {"Miss", "Meet", "Beat"};
+            for (int g = 0; g < 3 && g < static_cast<int>(result.size()); ++g) {
+                lines.push_back(string(names[g]) + "," + number(result[g][0]) + "," + number(result[g][1]) + ","
+                                + number(result[g][2]) + "," + number(result[g][3]));
+            }
+            return reply(lines);
+        }
+
+        return fail("unknown command " + cmd);
+    }
+
+    string AnalysisServer::answer(const string& line, ostream& log)
+    {
+        auto t0 = chrono::steady_clock::now();
+        string out = handle(line);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        ++requests_;
+        lock_guard<mutex> lock(logMutex_);
+        log << "[Serve] " << line << " -> " << out.substr(0, out.find('\n'))
+            << " (" << fixed << setprecision(3) << ms << " ms)" << endl;
+        return out;
+    }
+
+    bool AnalysisServer::serve(const string& path, ostream& log, string& error)
+    {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            error = "socket path must be 1-" + to_string(sizeof(addr.sun_path) - 1) + " characters";
+            return false;
+        }
+        memcpy(addr.sun_path, path.c_str(), path.size());
+
+        // Replace only a socket no server answers on: never another file, never a live server
+        struct stat st;
+        if (lstat(path.c_str(), &st) == 0) {
+            if (!S_ISSOCK(st.st_mode)) {
+                error = path + " exists and is not a socket";
+                return false;
+            }
+            int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+            bool live = probe >= 0 && connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+            if (probe >= 0) close(probe);
+            if (live) {
+                error = "a server is already listening on " + path;
+                return false;
+            }
+            unlink(path.c_str());  // stale socket of a server that is gone
+        }
+
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) {
+            error = string("socket: ") + strerror(errno);
+            return false;
+        }
+        if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listener, 64) < 0) {
+            error = "cannot listen on " + path + ": " + strerror(errno);
+            close(listener);
+            return false;
+        }
+        int wakePipe[2];
+        if (pipe(wakePipe) != 0) {
+            error = string("pipe: ") + strerror(errno);
+            close(listener);
+            unlink(path.c_str());
+            return false;
+        }
+
+        // No SA_RESTART, so a signal wakes the poll below at once
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = onStopSignal;
+        sigemptyset(&action.sa_mask);
+        struct sigaction oldInt, oldTerm;
+        sigaction(SIGINT, &action, &oldInt);
+        sigaction(SIGTERM, &action, &oldTerm);
+        g_stopServing.store(false);
+
+        {
+            lock_guard<mutex> lock(logMutex_);
+            log << "[Serve] Listening on " << path << " with " << threads_
+                << " request threads; Ctrl-C stops the server." << endl;
+        }
+
+        // One thread polls every connection; a complete request line becomes one pool task.
+        // A connection is not read while its request is in flight, so replies keep their
+        // order, and an idle connection holds no thread at all.
+        struct Connection {
+            int fd;
+            string buffer;
+            bool busy = false;
+        };
+        map<int, shared_ptr<Connection>> connections;
+        mutex doneMutex;
+        vector<pair<int, bool>> done;  // (fd, still open) of finished requests
+
+        auto drop = [&](int fd) {
+            close(fd);
+            connections.erase(fd);
+        };
+
+        {
+            ThreadPool2 pool(threads_);
+
+            // Next complete line of an idle connection to the pool; false if it was closed
+            auto dispatch = [&](const shared_ptr<Connection>& c) {
+                size_t nl;
+                while (!c->busy && (nl = c->buffer.find('\n')) != string::npos) {
+                    string line = c->buffer.substr(0, nl);
+                    c->buffer.erase(0, nl + 1);
+                    if (!line.empty() && line.back() == '\r') line.pop_back();
+
+                    istringstream in(line);
+                    string cmd;
+                    in >> cmd;
+                    if (upper(cmd) == "QUIT") { drop(c->fd); return false; }
+
+                    c->busy = true;
+                    try {
+                        pool.submit([this, c, line, &log, &doneMutex, &done, wakePipe]() {
+                            bool open = sendAll(c->fd, answer(line, log));
+                            {
+                                lock_guard<mutex> lock(doneMutex);
+                                done.emplace_back(c->fd, open);
+                            }
+                            char b = 0;
+                            if (write(wakePipe[1], &b, 1) < 0) {}  // poll also times out
+                        });
+                    } catch (const exception&) {
+                        drop(c->fd);
+                        return false;
+                    }
+                }
+                if (c->buffer.size() > kMaxRequest) {
+                    sendAll(c->fd, fail("request too long"));
+                    drop(c->fd);
+                    return false;
+                }
+                return true;
+            };
+
+            while (!g_stopServing.load()) {
+                vector<pollfd> fds{ { listener, POLLIN, 0 }, { wakePipe[0], POLLIN, 0 } };
+                for (const auto& p : connections)
+                    if (!p.second->busy) fds.push_back({ p.first, POLLIN, 0 });
+                if (poll(fds.data(), fds.size(), kPollMs) <= 0) continue;
+
+                if (fds[1].revents & POLLIN) {
+                    char sink[64];
+                    if (read(wakePipe[0], sink, sizeof(sink)) < 0) {}
+                    vector<pair<int, bool>> finished;
+                    {
+                        lock_guard<mutex> lock(doneMutex);
+                        finished.swap(done);
+                    }
+                    for (const auto& f : finished) {
+                        auto it = connections.find(f.first);
+                        if (it == connections.end()) continue;
+                        shared_ptr<Connection> c = it->second;
+                        c->busy = false;
+                        if (!f.second) drop(c->fd);
+                        else dispatch(c);  // requests pipelined behind the one just answered
+                    }
+                }
+
+                for (size_t i = 2; i < fds.size(); ++i) {
+                    if (!fds[i].revents) continue;
+                    auto it = connections.find(fds[i].fd);
+                    if (it == connections.end()) continue;
+                    shared_ptr<Connection> c = it->second;
+                    char chunk[4096];
+                    ssize_t n = recv(c->fd, chunk, sizeof(chunk), 0);
+                    if (n < 0 && errno == EINTR) continue;
+                    if (n <= 0) { drop(c->fd); continue; }
+                    c->buffer.append(chunk, static_cast<size_t>(n));
+                    dispatch(c);
+                }
+
+                if (fds[0].revents & POLLIN) {
+                    int client = accept(listener, nullptr, nullptr);
+                    if (client >= 0) {
+                        // A client that stops reading cannot hold a request thread for long
+                        timeval timeout{ kSendTimeoutSec, 0 };
+                        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                        auto c = make_shared<Connection>();
+                        c->fd = client;
+                        connections[client] = c;
+                    }
+                }
+            }
+            // Requests in flight finish here; the pool joins them before the sockets close
+        }
+
+        for (const auto& p : connections) close(p.first);
+        close(listener);
+        close(wakePipe[0]);
+        close(wakePipe[1]);
+        unlink(path.c_str());
+        sigaction(SIGINT, &oldInt, nullptr);
+        sigaction(SIGTERM, &oldTerm, nullptr);
+
+        log << "[Serve] Stopped after " << requests_.load() << " requests." << endl;
+        return true;
+    }
+
+}
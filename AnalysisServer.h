@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ReturnPanel.h"
+#include "StatCalculator.h"
+#include "StockRegistry.h"
+#include "StockStructure.h"
+
+namespace fre {
+
+    // Everything a query reads, frozen when published: the events, the three groups as
+    // the bootstrap sees them and the Option 1 results. Shared by all connections.
+    struct ServerState {
+        int N = 0;
+        AbnormalReturnModel model = AbnormalReturnModel::MarketAdjusted;
+        StockMap events;  // (ticker, date) order, as in the registry
+        std::vector<Stock> miss, meet, beat;  // events with abnormal returns
+        std::unique_ptr<const StatCalculator> stats;
+    };
+
+    // Copy of the registry and the results of a completed Option 1 run
+    std::shared_ptr<const ServerState> captureServerState(const StockRegistry& registry,
+                                                          const StatCalculator& stats,
+                                                          AbnormalReturnModel model);
+
+    // Query daemon on a Unix domain socket. Each request is one line; each reply starts
+    // with "OK <n>" followed by n lines, or is the single line "ERR <message>":
+    //   PING                              -> pong
+    //   INFO                              -> N, model, event and group counts
+    //   STOCK <ticker>                    -> every event of the ticker (Option 2)
+    //   STATS <miss|meet|beat>            -> summary and CAR window tests (Option 3)
+    //   SERIES <miss|meet|beat>           -> daily AAR / CAAR mean and STD with the daily tests
+    //   CAAR                              -> t, Beat, Meet, Miss CAAR means (Option 4)
+    //   BOOTSTRAP <resamples> <size> [seed] -> a new bootstrap of the three groups
+    //   QUIT                              -> closes the connection
+    // One thread polls every connection and hands each complete request line to a fixed
+    // pool of threads, so idle connections hold no thread. Every request reads the state
+    // current when it arrived, which is never modified once published.
+    class AnalysisServer {
+    public:
+        explicit AnalysisServer(std::size_t threads = 8) : threads_(threads) {}  // request threads
+
+        void publish(std::shared_ptr<const ServerState> state);
+        std::shared_ptr<const ServerState> current() const;
+
+        // Listen on path until SIGINT or SIGTERM. A stale socket file is replaced; false with
+        // error set if path is another kind of file, a server answers on it, or the socket
+        // cannot be set up
+        bool serve(const std::string& path, std::ostream& log, std::string& error);
+
+        // Reply to one request line; the protocol without the socket
+        std::string handle(const std::string& request) const;
+
+    private:
+        // handle() with the request counted and logged with its time
+        std::string answer(const std::string& line, std::ostream& log);
+
+        std::size_t threads_;
+        mutable std::mutex stateMutex_;
+        std::shared_ptr<const ServerState> state_;
+        std::mutex logMutex_;
+        std::atomic<std::size_t> requests_{0};
+    };
+
+}
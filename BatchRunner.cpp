@@ -0,0 +1,288 @@
+#include "BatchRunner.h"
+#include "Bootstrapper.h"
+#include "CsvReader.h"
+#include "Diagnostics.h"
+#include "StatCalculator.h"
+#include "StockUtils.h"
+#include "ThreadUtils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <set>
+
+using namespace std;
+
+namespace fre {
+
+    namespace {
+        string_view trim(string_view s) {
+            while (!s.empty() && isspace(static_cast<unsigned char>(s.front()))) s.remove_prefix(1);
+            while (!s.empty() && isspace(static_cast<unsigned char>(s.back()))) s.remove_suffix(1);
+            return s;
+        }
+
+        string lower(string_view s) {
+            string out(s);
+            transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+            return out;
+        }
+
+        // Whole field as an integer; false if empty, malformed or out of range
+        template <class T>
+        bool parseInteger(string_view field, T& value) {
+            field = trim(field);
+            if (field.empty()) return false;
+            auto r = from_chars(field.data(), field.data() + field.size(), value);
+            return r.ec == errc() && r.ptr == field.data() + field.size();
+        }
+
+        bool parseScheme(string_view field, GroupingScheme& scheme) {
+            string name = lower(trim(field));
+            for (const GroupingScheme& s : StockGrouper::defaultSchemes()) {
+                if (lower(s.name) == name) { scheme = s; return true; }
+            }
+            size_t colon = name.find(':');
+            if (colon == string::npos) return false;
+            int groups = 0;
+            double trimPct = 0.0;
+            if (!parseInteger(string_view(name).substr(0, colon), groups) ||
+                !parseCsvNumber(string_view(name).substr(colon + 1), trimPct)) return false;
+            if (groups < 2 || groups > 20 || trimPct < 0 || trimPct > 20) return false;
+            scheme = GroupingScheme{"Custom " + name, groups, trimPct / 100.0};
+            return true;
+        }
+
+        bool parseModel(string_view field, AbnormalReturnModel& model) {
+            string name = lower(trim(field));
+            if (name == "1" || name == "market-adjusted") model = AbnormalReturnModel::MarketAdjusted;
+            else if (name == "2" || name == "market-model") model = AbnormalReturnModel::MarketModel;
+            else return false;
+            return true;
+        }
+
+        const char* modelName(AbnormalReturnModel model) {
+            return model == AbnormalReturnModel::MarketModel ? "market-model" : "market-adjusted";
+        }
+
+        // Scenario names become file names: keep letters, digits, '-', '_' and '.'
+        string fileStem(string_view name) {
+            string out;
+            for (char c : name) out += (isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.') ? c : '_';
+            return out;
+        }
+    }
+
+    bool loadScenarios(const string& path, vector<Scenario>& scenarios, string& error)
+    {
+        CsvFile csv;
+        if (!csv.open(path)) {
+            error = csv.error();
+            return false;
+        }
+        vector<int> columns;
+        if (!csv.project({ "N" }, columns)) {
+            error = path + ": " + csv.error();
+            return false;
+        }
+        columns.insert(columns.begin(), csv.column("name"));
+        for (const char* optional : { "model", "resamples", "sample_size", "scheme", "seed" }) {
+            columns.push_back(csv.column(optional));
+        }
+
+        scenarios.clear();
+        set<string> names;
+        vector<CsvChunk> chunks = csv.split(1);
+        for (const CsvChunk& chunk : chunks) {
+            csv.parse(chunk, columns, [&](const CsvRow& row) {
+                if (!error.empty()) return;
+                Scenario s;
+                size_t line = scenarios.size() + 1;
+                auto fail = [&](const string& what) {
+                    error = path + ", scenario " + to_string(line) + ": " + what;
+                };
+
+                s.name = fileStem(trim(row[0]));
+                if (s.name.empty()) s.name = "scenario" + to_string(line);
+                if (!names.insert(s.name).second) return fail("duplicate name " + s.name);
+
+                if (!parseInteger(row[1], s.N) || s.N < 30 || s.N > 60) return fail("N must be 30-60");
+                if (!trim(row[2]).empty() && !parseModel(row[2], s.model))
+                    return fail("model must be market-adjusted (1) or market-model (2)");
+                if (!trim(row[3]).empty() && (!parseInteger(row[3], s.resamples) || s.resamples < 1))
+                    return fail("resamples must be a positive integer");
+                if (!trim(row[4]).empty() && (!parseInteger(row[4], s.sampleSize) || s.sampleSize < 1))
+                    return fail("sample_size must be a positive integer");
+                if (!trim(row[5]).empty() && !parseScheme(row[5], s.scheme))
+                    return fail("scheme must be Terciles, Quintiles, Deciles or groups:trim% (2-20, 0-20)");
+                if (!trim(row[6]).empty()) {
+                    if (!parseInteger(row[6], s.seed)) return fail("seed must be a non-negative integer");
+                    s.hasSeed = true;
+                }
+                scenarios.push_back(std::move(s));
+            });
+        }
+        if (!error.empty()) return false;
+        if (scenarios.empty()) {
+            error = path + ": no scenarios";
+            return false;
+        }
+        return true;
+    }
+
+    // --- 1. One pull of the registry per (N, model); the result is copied out and frozen ---
+    shared_ptr<const ScenarioData> BatchRunner::load(int N, AbnormalReturnModel model, ostream& log)
+    {
+        auto start = chrono::steady_clock::now();
+        EstimationWindow est;
+        est.end = min(est.end, -N);
+
+        log << "\n===== Pull: N = " << N << ", " << modelName(model) << " =====" << endl;
+        Diagnostics diagnostics;
+        map<string, string> dateWarns;
+        SETALLStocks(registry_, benchmarkPrices_, N, diagnostics, dateWarns, 1 - est.start,
+                     journal_, archive_, nullptr, log);
+        diagnostics.printSummary(log);
+
+        if (model == AbnormalReturnModel::MarketModel) {
+            ReturnPanel panel = buildReturnPanel(registry_, benchmarkPrices_, N, est);
+            MarketModelFit fit = fitAbnormalReturnModel(panel, est, model);
+            int updated = applyAbnormalReturns(panel, fit, N, registry_);
+            log << "Market-model abnormal returns set for " << updated << " events." << endl;
+        }
+
+        auto data = make_shared<ScenarioData>();
+        data->N = N;
+        data->model = model;
+        data->events.resize(keys_.size());
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            // Tercile outliers stay in the registry ungrouped, so every key has an event
+            EventId id = registry_.find(EventKey(keys_[i].ticker, keys_[i].date));
+            if (id == kNoEvent) continue;
+            Stock s = registry_.snapshot(id);
+            if (!StockGrouper::hasReturns(s)) continue;  // the rule Option 1 draws by
+            data->events[i] = std::move(s);
+            ++data->usable;
+        }
+        data->loadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return data;
+    }
+
+    // --- 2. One scenario: quantile buckets, a bootstrap per bucket, one result file ---
+    ScenarioResult BatchRunner::runOne(const Scenario& scenario, const ScenarioData& data, const string& outDir) const
+    {
+        auto start = chrono::steady_clock::now();
+        ScenarioResult result;
+        const int N = data.N;
+
+        QuantileGrouping grouping = StockGrouper::assignQuantileGroups(keys_, { scenario.scheme });
+        const vector<int>& labels = grouping.labels[0];
+        // Buckets point into the shared event list; the scenario copies no returns
+        vector<vector<const Stock*>> buckets(scenario.scheme.numGroups);
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            if (labels[i] < 0) continue;
+            if (data.events[i].getAbnormReturns().empty()) { ++result.dropped; continue; }
+            buckets[labels[i]].push_back(&data.events[i]);
+        }
+
+        // Buckets hold the events with returns in registry order (keys_ follows the universe's
+        // (ticker, date) order) and are bootstrapped in label order, so the default tercile
+        // scenario draws Miss, Meet and Beat exactly as Option 1 does under the same seed
+        Bootstrapper bootstrap(N, scenario.resamples, scenario.sampleSize);
+        if (scenario.hasSeed) bootstrap.setSeed(scenario.seed);
+        result.seed = bootstrap.getSeed();
+        StatCalculator calc(N);
+        for (int q = 0; q < scenario.scheme.numGroups; ++q) {
+            result.groupNames.push_back(StockGrouper::labelName(scenario.scheme, q));
+            result.stats.push_back(calc.computeForOneGroup(bootstrap.bootstrapSingleGroup(buckets[q])));
+            result.events += buckets[q].size();
+        }
+
+        result.file = (filesystem::path(outDir) / (scenario.name + ".csv")).string();
+        ofstream out(result.file);
+        if (out) {
+            out << "group,stocks,t,AAR_mean,AAR_std,CAAR_mean,CAAR_std\n";
+            out << setprecision(10);
+            for (int q = 0; q < scenario.scheme.numGroups; ++q) {
+                const GroupStats& s = result.stats[q];
+                for (size_t d = 0; d < s.AAR_mean.size(); ++d) {
+                    out << result.groupNames[q] << ',' << buckets[q].size() << ',' << static_cast<int>(d) - N + 1 << ','
+                        << s.AAR_mean[d] << ',' << s.AAR_std[d] << ',' << s.CAAR_mean[d] << ',' << s.CAAR_std[d] << '\n';
+                }
+            }
+            result.ok = static_cast<bool>(out.flush());
+        }
+        result.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    bool BatchRunner::run(const vector<Scenario>& scenarios, const string& outDir, ostream& os)
+    {
+        auto start = chrono::steady_clock::now();
+        error_code ec;
+        filesystem::create_directories(outDir, ec);
+        ofstream log((filesystem::path(outDir) / "batch.log").string());
+        if (ec || !log) {
+            os << "[Batch] Cannot write to " << outDir << "." << endl;
+            return false;
+        }
+
+        // Pulls change the registry, so they run one after another before any scenario
+        map<pair<int, AbnormalReturnModel>, shared_ptr<const ScenarioData>> data;
+        for (const Scenario& s : scenarios) data[{ s.N, s.model }];
+        for (auto& d : data) {
+            d.second = load(d.first.first, d.first.second, log);
+            os << "[Batch] Loaded N = " << d.first.first << ", " << modelName(d.first.second) << ": "
+               << d.second->usable << " events with returns in " << fixed << setprecision(1)
+               << d.second->loadMs << " ms." << endl;
+        }
+        auto pulled = chrono::steady_clock::now();
+
+        // Scenarios run side by side; each bootstrap fans out its resamples on the same pool
+        vector<ScenarioResult> results(scenarios.size());
+        parallel_for(computePool(), IndexRange{0, scenarios.size()}, 1, [&](size_t i) {
+            const Scenario& s = scenarios[i];
+            results[i] = runOne(s, *data.at({ s.N, s.model }), outDir);
+        });
+        auto done = chrono::steady_clock::now();
+
+        // --- 3. Summary file and timing table ---
+        const string summaryFile = (filesystem::path(outDir) / "summary.csv").string();
+        ofstream summary(summaryFile);
+        summary << "name,N,model,resamples,sample_size,scheme,seed,groups,events,dropped,ms,file,status\n";
+        os << "\n===== Batch Scenarios =====\n";
+        os << left << setw(16) << "Scenario" << setw(6) << "N" << setw(17) << "Model" << setw(11) << "Scheme"
+           << setw(8) << "Events" << setw(9) << "Dropped" << setw(10) << "ms" << "Result\n";
+        bool allOk = true;
+        for (size_t i = 0; i < scenarios.size(); ++i) {
+            const Scenario& s = scenarios[i];
+            const ScenarioResult& r = results[i];
+            allOk = allOk && r.ok;
+            summary << s.name << ',' << s.N << ',' << modelName(s.model) << ',' << s.resamples << ','
+                    << s.sampleSize << ',' << s.scheme.name << ',' << r.seed << ',' << s.scheme.numGroups << ','
+                    << r.events << ',' << r.dropped << ',' << fixed << setprecision(1) << r.ms << ',' << r.file << ','
+                    << (r.ok ? "ok" : "write failed") << '\n';
+            os << left << setw(16) << s.name << setw(6) << s.N << setw(17) << modelName(s.model)
+               << setw(11) << s.scheme.name << setw(8) << r.events << setw(9) << r.dropped
+               << setw(10) << fixed << setprecision(1) << r.ms
+               << (r.ok ? r.file : "write failed: " + r.file) << "\n";
+        }
+        if (!summary.flush()) {
+            os << "[Batch] Error: could not write " << summaryFile << "." << endl;
+            allOk = false;
+        }
+
+        double pullMs = chrono::duration<double, milli>(pulled - start).count();
+        double runMs = chrono::duration<double, milli>(done - pulled).count();
+        os << "[Batch] " << scenarios.size() << " scenario(s) over " << data.size() << " pull(s): "
+           << fixed << setprecision(1) << pullMs << " ms loading, " << runMs
+           << " ms running on " << computePool().worker_count() << " worker(s). Summary in "
+           << summaryFile << "." << endl;
+        return allOk;
+    }
+
+}
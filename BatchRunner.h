@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "DownloadJournal.h"
+#include "PriceArchive.h"
+#include "ReturnPanel.h"
+#include "StatCalculator.h"
+#include "StockGrouper.h"
+#include "StockRegistry.h"
+
+namespace fre {
+
+    // One configuration of a headless run, one row of the scenario file
+    struct Scenario {
+        std::string name;  // also the result file name, <name>.csv
+        int N = 60;
+        AbnormalReturnModel model = AbnormalReturnModel::MarketAdjusted;
+        int resamples = 40;
+        int sampleSize = 30;
+        GroupingScheme scheme{"Terciles", 3, 0.02};
+        bool hasSeed = false;  // otherwise the bootstrap draws a seed, reported with the results
+        std::uint64_t seed = 0;
+    };
+
+    // Scenario file: CSV with a header row. Only N is required; a missing name is scenario<k>:
+    //   name,N,model,resamples,sample_size,scheme,seed
+    //   base,60,market-adjusted,40,30,Terciles,1
+    //   mm_quint,45,market-model,200,50,Quintiles,7
+    // scheme is Terciles, Quintiles or Deciles (2% trim), or groups:trim% such as 4:5.
+    // model is market-adjusted (1) or market-model (2). Empty fields take the defaults above.
+    bool loadScenarios(const std::string& path, std::vector<Scenario>& scenarios, std::string& error);
+
+    // The abnormal returns of the whole universe for one (N, model), aligned with the
+    // grouping keys. Built once, then only read by every scenario that needs it.
+    struct ScenarioData {
+        int N = 0;
+        AbnormalReturnModel model = AbnormalReturnModel::MarketAdjusted;
+        std::vector<Stock> events;  // empty abnormal returns: no price data for this N
+        std::size_t usable = 0;
+        double loadMs = 0.0;
+    };
+
+    struct ScenarioResult {
+        bool ok = false;
+        std::string file;
+        std::uint64_t seed = 0;
+        std::size_t events = 0;  // bootstrapped, over all groups
+        std::size_t dropped = 0; // labelled by the scheme but without abnormal returns
+        std::vector<std::string> groupNames;
+        std::vector<GroupStats> stats;
+        double ms = 0.0;
+    };
+
+    // Headless execution of many scenarios over one loaded universe. The registry is
+    // pulled once per distinct (N, model), through the journal or archive like Option 1;
+    // the scenarios then run concurrently on the compute pool and share that data.
+    class BatchRunner {
+    public:
+        BatchRunner(StockRegistry& registry, const std::vector<GroupingKey>& keys,
+                    const std::map<std::string, double>& benchmarkPrices,
+                    DownloadJournal* journal, const PriceArchive* archive)
+            : registry_(registry), keys_(keys), benchmarkPrices_(benchmarkPrices),
+              journal_(journal), archive_(archive) {}
+
+        // Writes <outDir>/<name>.csv per scenario, <outDir>/summary.csv and the pull
+        // reports to <outDir>/batch.log; timings go to os. False if any scenario failed.
+        bool run(const std::vector<Scenario>& scenarios, const std::string& outDir, std::ostream& os);
+
+    private:
+        std::shared_ptr<const ScenarioData> load(int N, AbnormalReturnModel model, std::ostream& log);
+        ScenarioResult runOne(const Scenario& scenario, const ScenarioData& data, const std::string& outDir) const;
+
+        StockRegistry& registry_;
+        const std::vector<GroupingKey>& keys_;
+        const std::map<std::string, double>& benchmarkPrices_;
+        DownloadJournal* journal_;
+        const PriceArchive* archive_;
+    };
+
+}
@@ -1,22 +1,53 @@
 #include "Bootstrapper.h"
+#include "ThreadUtils.h"
 #include <algorithm>
+#include <cmath>
 #include <ctime>
 #include <iostream>
 
 namespace fre{
     Bootstrapper::Bootstrapper(int N, int numSamples, int sampleSize):  
-        N_(N), numSamples_(numSamples), sampleSize_(sampleSize){}
+        N_(N), numSamples_(numSamples), sampleSize_(sampleSize), nextStream_(0){
+        std::random_device rd;
+            // std::random_device provides a non-deterministic source 
+            // of randomness (when supported by the system).
+        seed_ = (static_cast<std::uint64_t>(rd()) << 32) | rd();
+    }
 
-    // Perform bootstrap sampling for a single group
-    GroupBootstrapResult Bootstrapper::bootstrapSingleGroup(
-        const std::vector<Stock>& group){
-        GroupBootstrapResult result;
+    std::mt19937 Bootstrapper::resampleEngine(unsigned stream, std::size_t sample) const{
+        std::seed_seq seq{ static_cast<std::uint32_t>(seed_), static_cast<std::uint32_t>(seed_ >> 32),
+                           static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(sample) };
+        return std::mt19937(seq);
+    }
+
+    namespace {
+        ResampleSum::Fixed toFixed(double x){
+            // Exact in long double (a power-of-two scale), then rounded to the grid
+            return static_cast<ResampleSum::Fixed>(roundl(static_cast<long double>(x) * ResampleSum::kScale));
+        }
+    }
+
+    void ResampleSum::add(const Vector& abnormReturns){
+        if (sumAR.empty() || abnormReturns.size() != sumAR.size()) return;
+        for (size_t t = 0; t < sumAR.size(); ++t) sumAR[t] += toFixed(abnormReturns[t]);
+        ++used;
+    }
+
+    void ResampleSum::merge(const ResampleSum& other){
+        if (other.sumAR.size() != sumAR.size()) return;
+        for (size_t t = 0; t < sumAR.size(); ++t) sumAR[t] += other.sumAR[t];
+        used += other.used;
+    }
+
+    // Draw the resamples of one group and sum what was drawn
+    std::vector<ResampleSum> Bootstrapper::resampleSums(std::size_t size, const std::function<const Vector*(int)>& drawn){
+        std::vector<ResampleSum> sums;
 
         int T = 2*N_; // Event window length
 
-        if (group.empty()){
+        if (size == 0){
             std::cerr<<"[Bootstrapper] Warning size is 0, skip bootstrap.\n";
-            return result;
+            return sums;
         }
 
         // std::mt19937 random_engine(static_cast<unsigned>(std::time(nullptr))); // ⚠️ delete 
@@ -24,22 +55,22 @@ namespace fre{
             // Since C++ executes very fast, the three groups may 
             // end up using the same random seed,
             // which can negatively affect the bootstrap results.
-            // Therefore, we use the following approach:
-        std::random_device rd; 
-            // std::random_device provides a non-deterministic source 
-            // of randomness (when supported by the system).
-        std::mt19937 random_engine(rd()); 
-            // initializes a Mersenne Twister random engine (mt19937)
-            //  using the value produced by random_device as the seed.
-        std::uniform_int_distribution<int> dist(0, static_cast<int>(group.size()) - 1); // a more accurate version to generate randomness
-        int M = std::min<int>(sampleSize_, static_cast<int>(group.size()));  // Unnecessary actually, but safer
-        // Outer loop: number of bootstrap repetitions
-        for (int s = 0; s < numSamples_; ++s){
+            // Therefore every group gets its own stream and every resample its own engine,
+            // seeded from (seed_, stream, s); resamples then run in parallel and the
+            // result is the same for any number of threads.
+        unsigned stream = nextStream_++;
+        int M = std::min<int>(sampleSize_, static_cast<int>(size));  // Unnecessary actually, but safer
+
+        sums.resize(numSamples_);
 
-            Vector aar(T, 0.0); // Length T, all elements are zero.
-            Vector caar(T, 0.0);
+        // Outer loop: number of bootstrap repetitions, one engine per repetition
+        parallel_for(computePool(), IndexRange{0, static_cast<size_t>(numSamples_)}, 0, [&](size_t s){
 
-            int usedStocks = 0; // Number of valid stocks used in this sample
+            std::mt19937 random_engine = resampleEngine(stream, s);
+            std::uniform_int_distribution<int> dist(0, static_cast<int>(size) - 1); // a more accurate version to generate randomness
+
+            ResampleSum& sum = sums[s];
+            sum.sumAR.assign(T, 0);
 
             // Inner loop: draw M stocks for one bootstrap sample
             for (int i = 0; i < M; ++i){ 
@@ -47,36 +78,44 @@ namespace fre{
                     // ⭐️ Ensure the uniformly random for bootstrap
                     // random_index is sampled from a discrete uniform distribution, 
                     // which assigns equal probability to each integer in {0, 1, ..., group.size()-1}
-                const Stock& stock = group[random_index];
-                Vector ar = stock.getAbnormReturns(); // dependency on stockstructure.cpp 
-
-                if (static_cast<int>(ar.size()) != T){
-                    continue;
-                }
-                aar = aar + ar; // Vector addition: accumulate abnormal returns
-                ++usedStocks;
+                const Vector* ar = drawn(random_index);
+                if (ar) sum.add(*ar); // accumulate abnormal returns; other lengths are skipped
             }
+        });
 
-            if (usedStocks == 0){
-                std::cerr << "[Bootstrapper] Warning: no valid stocks in this sampling. \n";
-                continue;
-            }
+        return sums;
+    }
 
-            aar = aar / static_cast<double>(usedStocks); // Vector division
+    GroupBootstrapResult Bootstrapper::resultFromSums(const std::vector<ResampleSum>& sums){
+        GroupBootstrapResult result;
 
+        // Keep resample order. Groups hold only events with returns, so every draw is used
+        for (const ResampleSum& sum : sums){
+            if (sum.used == 0) continue;
+            size_t T = sum.sumAR.size();
+            Vector aar(T, 0.0), caar(T, 0.0);
             double cum = 0.0;
-            for (int t = 0; t < T; ++t){
+            for (size_t t = 0; t < T; ++t){
+                aar[t] = static_cast<double>(static_cast<long double>(sum.sumAR[t]) / ResampleSum::kScale / sum.used);
                 cum += aar[t];
                 caar[t] = cum;
             }
-
-            result.AAR_samples.push_back(aar);
-            result.CAAR_samples.push_back(caar);
+            result.AAR_samples.push_back(std::move(aar));
+            result.CAAR_samples.push_back(std::move(caar));
         }
 
         return result;
     }
 
+    // Perform bootstrap sampling for a single group
+    GroupBootstrapResult Bootstrapper::bootstrapSingleGroup(const std::vector<Stock>& group){
+        return resultFromSums(resampleSums(group.size(), [&](int i){ return &group[i].getAbnormReturns(); }));
+    }
+
+    GroupBootstrapResult Bootstrapper::bootstrapSingleGroup(const std::vector<const Stock*>& group){
+        return resultFromSums(resampleSums(group.size(), [&](int i){ return &group[i]->getAbnormReturns(); }));
+    }
+
     // Perform bootstrap sampling for all three groups simultaneously
     void Bootstrapper::runBootstrap(const std::vector<Stock>& missGroup,
                                     const std::vector<Stock>& meetGroup,
@@ -89,4 +128,111 @@ namespace fre{
         meetResult = bootstrapSingleGroup(meetGroup);
         beatResult = bootstrapSingleGroup(beatGroup);
     }
+
+    // Sample-size sweep for a single group.
+    // Each resample draws max(M) stocks once; a running sum over the draws is
+    // snapshotted whenever the draw count reaches one of the requested sizes,
+    // so the prefix of length M serves as the resample for sample size M.
+    SampleSizeSweepResult Bootstrapper::bootstrapSampleSizeSweep(
+        const std::vector<Stock>& group, std::vector<int> sampleSizes){
+        SampleSizeSweepResult sweep;
+
+        int T = 2*N_;
+
+        // Keep positive sizes only, ascending and unique
+        sampleSizes.erase(std::remove_if(sampleSizes.begin(), sampleSizes.end(),
+                                         [](int m){ return m <= 0; }),
+                          sampleSizes.end());
+        std::sort(sampleSizes.begin(), sampleSizes.end());
+        sampleSizes.erase(std::unique(sampleSizes.begin(), sampleSizes.end()), sampleSizes.end());
+
+        // A size above the group size would be capped to it, as in bootstrapSingleGroup, and
+        // then reported under the wrong M; such sizes are dropped and listed instead
+        int groupSize = static_cast<int>(group.size());
+        auto fits = std::upper_bound(sampleSizes.begin(), sampleSizes.end(), groupSize);
+        sweep.droppedSizes.assign(fits, sampleSizes.end());
+        sampleSizes.erase(fits, sampleSizes.end());
+
+        sweep.sampleSizes = sampleSizes;
+        sweep.results.resize(sampleSizes.size());
+
+        if (group.empty()){
+            std::cerr<<"[Bootstrapper] Warning size is 0, skip sweep.\n";
+            return sweep;
+        }
+        if (sampleSizes.empty()){
+            std::cerr<<"[Bootstrapper] Warning: no valid sample sizes, skip sweep.\n";
+            return sweep;
+        }
+
+        unsigned stream = nextStream_++;
+        int maxM = sampleSizes.back();
+
+        // rows[s][k]: AAR / CAAR of resample s at sampleSizes[k], empty if it had no valid stock
+        std::vector<Matrix> aarRows(numSamples_, Matrix(sampleSizes.size()));
+        std::vector<Matrix> caarRows(numSamples_, Matrix(sampleSizes.size()));
+
+        parallel_for(computePool(), IndexRange{0, static_cast<size_t>(numSamples_)}, 0, [&](size_t s){
+
+            std::mt19937 random_engine = resampleEngine(stream, s);
+            std::uniform_int_distribution<int> dist(0, groupSize - 1);
+
+            Vector sum(T, 0.0); // Running sum of abnormal returns over the draws so far
+            int usedStocks = 0;
+            size_t next = 0;    // Next sample size waiting for its snapshot
+
+            for (int i = 1; i <= maxM; ++i){
+                const Stock& stock = group[dist(random_engine)]; // sampling with replacement
+                const Vector& ar = stock.getAbnormReturns();
+
+                if (static_cast<int>(ar.size()) == T){
+                    for (int t = 0; t < T; ++t) sum[t] += ar[t];
+                    ++usedStocks;
+                }
+
+                // Snapshot the size whose prefix ends at this draw
+                while (next < sampleSizes.size() && sampleSizes[next] == i){
+                    if (usedStocks == 0){
+                        std::cerr << "[Bootstrapper] Warning: no valid stocks in this sampling. \n";
+                    }
+                    else {
+                        Vector aar = sum / static_cast<double>(usedStocks);
+                        Vector caar(T, 0.0);
+                        double cum = 0.0;
+                        for (int t = 0; t < T; ++t){
+                            cum += aar[t];
+                            caar[t] = cum;
+                        }
+                        aarRows[s][next] = aar;
+                        caarRows[s][next] = caar;
+                    }
+                    ++next;
+                }
+            }
+        });
+
+        for (int s = 0; s < numSamples_; ++s){
+            for (size_t k = 0; k < sampleSizes.size(); ++k){
+                if (aarRows[s][k].empty()) continue;
+                sweep.results[k].AAR_samples.push_back(std::move(aarRows[s][k]));
+                sweep.results[k].CAAR_samples.push_back(std::move(caarRows[s][k]));
+            }
+        }
+
+        return sweep;
+    }
+
+    // Sample-size sweep for all three groups
+    void Bootstrapper::runSampleSizeSweep(const std::vector<Stock>& missGroup,
+                                          const std::vector<Stock>& meetGroup,
+                                          const std::vector<Stock>& beatGroup,
+                                          const std::vector<int>& sampleSizes,
+                                          SampleSizeSweepResult& missResult,
+                                          SampleSizeSweepResult& meetResult,
+                                          SampleSizeSweepResult& beatResult)
+    {
+        missResult = bootstrapSampleSizeSweep(missGroup, sampleSizes);
+        meetResult = bootstrapSampleSizeSweep(meetGroup, sampleSizes);
+        beatResult = bootstrapSampleSizeSweep(beatGroup, sampleSizes);
+    }
 }
\ No newline at end of file
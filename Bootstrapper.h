@@ -1,6 +1,8 @@
 #pragma once 
 #include <vector>
 #include <random>
+#include <cstdint>
+#include <functional>
 #include "StockStructure.h"
 #include "MatrixOperator.h"
 
@@ -15,17 +17,60 @@ namespace fre{
         // where Vector is `typedef vector<double>`
     };
 
+    // Abnormal returns drawn by one resample, summed on a fixed-point grid of 2^-60 in
+    // 128-bit integers: under 1e-18 per return, far below the rounding of the double mean
+    // Option 1 reports. Sums of disjoint parts of the draws add up to
+    // the same bits in any order, so shards of a run reproduce the resample exactly.
+    struct ResampleSum{
+        typedef __int128 Fixed;
+        static constexpr long double kScale = 1152921504606846976.0L;  // 2^60
+
+        std::int64_t used = 0;     // draws with a full event window of abnormal returns
+        std::vector<Fixed> sumAR;  // per event day
+
+        // One draw; ignored unless the length matches sumAR
+        void add(const Vector& abnormReturns);
+        // Add another part of the same resample's draws
+        void merge(const ResampleSum& other);
+    };
+
+    // Bootstrap results for several sample sizes evaluated on one stream of draws.
+    // results[k] is built from the first sampleSizes[k] draws of every resample,
+    // so all sizes share the same underlying random sequence.
+    struct SampleSizeSweepResult{
+        std::vector<int> sampleSizes;               // ascending, duplicates removed
+        std::vector<GroupBootstrapResult> results;  // one entry per sample size
+        std::vector<int> droppedSizes;              // requested sizes above the group size, not run
+    };
+
     class Bootstrapper{
         private:  
             int N_;  // Half window length (event window size = 2 * N_)
             int numSamples_; // Number of bootstrap repetitions
             int sampleSize_; // Number of stocks sampled in each bootstrap draw
+            std::uint64_t seed_;    // Base seed of every random stream of this bootstrapper
+            unsigned nextStream_;   // One stream per group bootstrap, so groups never share draws
+
+            // Engine for one resample: seeded from (seed_, stream, resample index) only,
+            // so results do not depend on which thread runs the resample
+            std::mt19937 resampleEngine(unsigned stream, std::size_t sample) const;
+
         public:
             // Constructor
             Bootstrapper(int N, int numSamples = 40, int sampleSize = 30);
 
+            // Draw every resample of the next group bootstrap over a group of size events and
+            // sum them. drawn(i) is the abnormal returns of event i, or null for an event whose
+            // draws are summed elsewhere (by the shard that owns it); either way the draw is made.
+            std::vector<ResampleSum> resampleSums(std::size_t size, const std::function<const Vector*(int)>& drawn);
+
+            // AAR / CAAR rows of complete resample sums (of an empty group: none)
+            static GroupBootstrapResult resultFromSums(const std::vector<ResampleSum>& sums);
+
             // Bootstrap one group
             GroupBootstrapResult bootstrapSingleGroup(const std::vector<Stock>& group);
+            // Same draws for a group held elsewhere, e.g. a bucket of a shared event list
+            GroupBootstrapResult bootstrapSingleGroup(const std::vector<const Stock*>& group);
 
             // Bootstrap all three group
             void runBootstrap(const std::vector<Stock>& missGroup, 
@@ -34,9 +79,27 @@ namespace fre{
                               GroupBootstrapResult& missResult,
                               GroupBootstrapResult& meetResult,
                               GroupBootstrapResult& beatResult);
+
+            // Bootstrap one group for a list of sample sizes at the cost of one run at the largest size
+            SampleSizeSweepResult bootstrapSampleSizeSweep(const std::vector<Stock>& group,
+                                                           std::vector<int> sampleSizes);
+
+            // Sample-size sweep for all three groups
+            void runSampleSizeSweep(const std::vector<Stock>& missGroup,
+                                    const std::vector<Stock>& meetGroup,
+                                    const std::vector<Stock>& beatGroup,
+                                    const std::vector<int>& sampleSizes,
+                                    SampleSizeSweepResult& missResult,
+                                    SampleSizeSweepResult& meetResult,
+                                    SampleSizeSweepResult& beatResult);
             
+            // Fix the base seed to reproduce a run; also restarts the stream sequence
+            void setSeed(std::uint64_t seed) {seed_ = seed; nextStream_ = 0;}
+
             // Accessor
             int getWindowSize() const {return N_;}
             int getNumSamples() const {return numSamples_;}
+            int getSampleSize() const {return sampleSize_;}
+            std::uint64_t getSeed() const {return seed_;}
     };
 }
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "CsvReader.h"
+#include "ThreadUtils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+
+using namespace std;
+
+namespace fre {
+
+    namespace {
+        // Pieces smaller than this are not worth a task of their own
+        const size_t kMinChunkBytes = 64 * 1024;
+
+        string_view trim(string_view s) {
+            while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+            while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+            return s;
+        }
+
+        bool sameName(string_view a, string_view b) {
+            if (a.size() != b.size()) return false;
+            for (size_t i = 0; i < a.size(); ++i) {
+                if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i])))
+                    return false;
+            }
+            return true;
+        }
+    }
+
+    bool CsvFile::open(const string& path)
+    {
+        header_.clear();
+        body_ = end_ = nullptr;
+        if (!file_.open(path)) {
+            error_ = file_.error();
+            return false;
+        }
+
+        const char* p = file_.data();
+        end_ = p + file_.size();
+        if (file_.size() >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) p += 3;  // UTF-8 byte order mark
+
+        // The first non-blank record is the header
+        CsvRow row;
+        bool blank = true;
+        while (blank && p < end_) p = readRow(p, end_, nullptr, row, blank);
+        if (blank) {
+            error_ = path + ": no header row";
+            return false;
+        }
+        for (size_t i = 0; i < row.size(); ++i) header_.emplace_back(trim(row[i]));
+        body_ = p;
+        error_.clear();
+        return true;
+    }
+
+    int CsvFile::column(const string& name) const
+    {
+        string_view wanted = trim(name);
+        for (size_t i = 0; i < header_.size(); ++i) {
+            if (sameName(header_[i], wanted)) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    bool CsvFile::project(const vector<string>& names, vector<int>& columns)
+    {
+        columns.clear();
+        for (const string& name : names) {
+            int c = column(name);
+            if (c < 0) {
+                error_ = "missing column \"" + name + "\"";
+                return false;
+            }
+            columns.push_back(c);
+        }
+        return true;
+    }
+
+    vector<CsvChunk> CsvFile::split(size_t maxChunks) const
+    {
+        vector<CsvChunk> chunks;
+        size_t bytes = static_cast<size_t>(end_ - body_);
+        if (bytes == 0) return chunks;
+
+        size_t pieces = max<size_t>(1, min(maxChunks, bytes / kMinChunkBytes));
+        auto pieceStart = [&](size_t k) { return body_ + bytes / pieces * k; };
+
+        // Quote parity of every piece in parallel; the parity before a piece says whether
+        // its first byte is inside a quoted field (a doubled quote counts twice)
+        vector<size_t> quotes(pieces);
+        forEachChunk(computePool(), pieces, [&](size_t k) {
+            const char* e = k + 1 == pieces ? end_ : pieceStart(k + 1);
+            quotes[k] = static_cast<size_t>(count(pieceStart(k), e, '"'));
+        });
+
+        // Move each piece start to just past the first line break outside quotes
+        const char* start = body_;
+        size_t parity = 0;
+        for (size_t k = 1; k < pieces; ++k) {
+            parity += quotes[k - 1];
+            const char* p = pieceStart(k);
+            if (p < start) continue;  // the previous boundary already lies past this piece
+
+            bool inQuotes = (parity & 1) != 0;
+            while (p < end_ && (inQuotes || *p != '\n')) {
+                if (*p == '"') inQuotes = !inQuotes;
+                ++p;
+            }
+            if (p == end_) break;
+            chunks.push_back(CsvChunk{ start, p + 1 });
+            start = p + 1;
+        }
+        if (start < end_) chunks.push_back(CsvChunk{ start, end_ });
+        return chunks;
+    }
+
+    const char* CsvFile::readRow(const char* p, const char* end, const vector<int>* slotOf,
+                                 CsvRow& row, bool& blank) const
+    {
+        if (slotOf) {
+            for (string_view& f : row.fields_) f = string_view();
+        } else {
+            row.fields_.clear();
+        }
+        row.unescaped_.clear();
+
+        const char* q = p;
+        if (q < end && *q == '\r') ++q;
+        blank = q == end || *q == '\n';
+        if (blank) return q == end ? end : q + 1;
+
+        size_t col = 0;
+        while (true) {
+            int slot = !slotOf ? static_cast<int>(col)
+                     : col < slotOf->size() ? (*slotOf)[col] : -1;
+            string_view value;
+
+            if (p < end && *p == '"') {
+                const char* b = ++p;
+                bool doubled = false;
+                while (p < end) {
+                    if (*p == '"') {
+                        if (p + 1 < end && p[1] == '"') { doubled = true; p += 2; continue; }
+                        break;
+                    }
+                    ++p;
+                }
+                value = string_view(b, static_cast<size_t>(p - b));
+                if (p < end) ++p;  // closing quote
+                while (p < end && *p != ',' && *p != '\n') ++p;  // stray text after it, or '\r'
+
+                if (doubled && slot >= 0) {
+                    string s;
+                    s.reserve(value.size());
+                    for (size_t i = 0; i < value.size(); ++i) {
+                        s += value[i];
+                        if (value[i] == '"') ++i;
+                    }
+                    row.unescaped_.push_back(std::move(s));
+                    value = row.unescaped_.back();
+                }
+            } else {
+                const char* b = p;
+                while (p < end && *p != ',' && *p != '\n') ++p;
+                const char* e = p;
+                if (e > b && e[-1] == '\r' && (p == end || *p == '\n')) --e;
+                value = string_view(b, static_cast<size_t>(e - b));
+            }
+
+            if (!slotOf) row.fields_.push_back(value);
+            else if (slot >= 0) row.fields_[slot] = value;
+
+            if (p < end && *p == ',') {
+                ++p;
+                ++col;
+                continue;
+            }
+            if (p < end) ++p;  // line break
+            return p;
+        }
+    }
+
+    void CsvFile::parse(const CsvChunk& chunk, const vector<int>& columns,
+                        const function<void(const CsvRow&)>& rowFn) const
+    {
+        // File column -> position in the projected row
+        vector<int> slotOf;
+        for (size_t i = 0; i < columns.size(); ++i) {
+            int c = columns[i];
+            if (c < 0) continue;
+            if (slotOf.size() <= static_cast<size_t>(c)) slotOf.resize(c + 1, -1);
+            slotOf[c] = static_cast<int>(i);
+        }
+
+        CsvRow row;
+        row.fields_.resize(columns.size());
+        const char* p = chunk.begin;
+        while (p < chunk.end) {
+            bool blank = false;
+            p = readRow(p, chunk.end, &slotOf, row, blank);
+            if (!blank) rowFn(row);
+        }
+    }
+
+    bool parseCsvNumber(string_view field, double& value)
+    {
+        field = trim(field);
+        if (!field.empty() && field.front() == '+') field.remove_prefix(1);
+        if (field.empty()) return false;
+
+        // Drop thousands separators into a small buffer; plain numbers are parsed in place
+        char buf[64];
+        if (field.find(',') != string_view::npos) {
+            size_t n = 0;
+            for (char c : field) {
+                if (c == ',') continue;
+                if (n == sizeof(buf)) return false;
+                buf[n++] = c;
+            }
+            field = string_view(buf, n);
+        }
+
+        const char* last = field.data() + field.size();
+        from_chars_result r = from_chars(field.data(), last, value);
+        return r.ec == errc() && r.ptr == last;
+    }
+
+}
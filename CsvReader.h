@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MappedFile.h"
+
+namespace fre {
+
+    // One data row projected onto the requested columns. A field views the mapped file,
+    // or the row's own storage when a quoted field had to be unescaped; either way it is
+    // valid only inside the row callback.
+    class CsvRow {
+    public:
+        std::size_t size() const { return fields_.size(); }
+        std::string_view operator[](std::size_t i) const { return fields_[i]; }
+
+    private:
+        friend class CsvFile;
+        std::vector<std::string_view> fields_;
+        std::deque<std::string> unescaped_;
+    };
+
+    // Byte range of the body holding whole rows
+    struct CsvChunk {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+    };
+
+    // Memory-mapped RFC 4180 CSV file with a header row.
+    //
+    // Fields may be quoted; a quoted field may hold commas, line breaks and doubled quotes.
+    // Lines end in LF or CRLF. The body is split into chunks that start on a row boundary,
+    // found by quote parity, so chunks can be parsed on different threads.
+    class CsvFile {
+    public:
+        // False with error() set if the file cannot be mapped or has no header row
+        bool open(const std::string& path);
+        const std::string& error() const { return error_; }
+
+        // Header names with surrounding spaces removed
+        const std::vector<std::string>& header() const { return header_; }
+
+        // Index of a header name, compared without case and surrounding spaces; -1 if absent
+        int column(const std::string& name) const;
+
+        // Indices of the named columns, in the given order; false with error() naming the
+        // first missing column
+        bool project(const std::vector<std::string>& names, std::vector<int>& columns);
+
+        // At most maxChunks row-aligned chunks covering the body, in file order.
+        // Quote parity of the pieces is counted on the compute pool.
+        std::vector<CsvChunk> split(std::size_t maxChunks) const;
+
+        // rowFn(row) for every non-blank row of the chunk, in order. Field i of the row is
+        // column columns[i], or empty if columns[i] is -1 or past the end of the row.
+        void parse(const CsvChunk& chunk, const std::vector<int>& columns,
+                   const std::function<void(const CsvRow&)>& rowFn) const;
+
+    private:
+        // Parse the record at p into row (every field, appended, if slotOf is null);
+        // returns the start of the next record. Skipped fields are not unescaped.
+        const char* readRow(const char* p, const char* end, const std::vector<int>* slotOf,
+                            CsvRow& row, bool& blank) const;
+
+        MappedFile file_;
+        const char* body_ = nullptr;
+        const char* end_ = nullptr;
+        std::vector<std::string> header_;
+        std::string error_;
+    };
+
+    // Numeric field, e.g. "-0.05", "3.9683" or "10,886,901.76": surrounding spaces, a
+    // leading '+' and thousands separators are accepted. False if empty or malformed.
+    bool parseCsvNumber(std::string_view field, double& value);
+
+}
@@ -7,6 +7,7 @@
 #include <chrono>
 #include <cstring>
 #include <cstdlib>
+#include <mutex>
 
 using namespace std;
 
@@ -58,46 +59,46 @@ namespace fre {
         return realSize;
     }
 
-    // Normalize date strings into "YYYY-MM-DD".
-    // If the input already contains '-', it is assumed to be normalized and returned as-is.
-    // Otherwise it converts formats like "YYYY/M/D" into zero-padded "YYYY-MM-DD".
-    static string normalize_date(const string& rawDate) {
-        if (rawDate.find('-') != string::npos) return rawDate;
-
-        istringstream ss(rawDate);
-        string year, month, day;
-        getline(ss, year, '/');
-        getline(ss, month, '/');
-        getline(ss, day);
-
-        if (month.size() == 1) month = "0" + month;
-        if (day.size()   == 1) day   = "0" + day;
+    // libcurl progress callback: a non-zero return aborts the transfer (CURLE_ABORTED_BY_CALLBACK).
+    // libcurl calls it at least once a second, also while waiting for the server.
+    static int abort_if_cancelled(void* data, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+        return static_cast<const CancelFlag*>(data)->cancelled() ? 1 : 0;
+    }
 
-        return year + "-" + month + "-" + day;
+    QpsLimiter& apiLimiter()
+    {
+        static QpsLimiter limiter;
+        static once_flag configured;
+        call_once(configured, []() { limiter.set_qps_limit(kApiQpsLimit); });
+        return limiter;
     }
 
     // Fetch daily EOD price data (CSV) for a given ticker and date range from EODHistoricalData.
-    // Parses the CSV, keeps only adjusted close as pd.price, and labels each date relative to eventDate.
     // Retries up to kMaxAttempts with simple backoff if the request fails or returns empty data.
-    vector<PriceData> FetchPriceSeriesWithDates(
+    bool FetchPriceCsv(
         CURL* curlHandle,
         const string& ticker,
         const string& fromDate,
         const string& toDate,
-        const string& eventDate
+        string& csvText,
+        FetchStats* stats,
+        const CancelFlag* cancel
     ) {
-        vector<PriceData> result;
+        csvText.clear();
+        FetchStats local;
+        if (!stats) stats = &local;
+        *stats = FetchStats();
 
         if (!curlHandle) {
             cerr << "[CurlUtils] Invalid CURL handle." << endl;
-            return result;
+            return false;
         }
 
         const string& token = get_api_token();
         if (token.empty()) {
             cerr << "[CurlUtils] Empty API token, skip ticker "
                 << ticker << endl;
-            return result;
+            return false;
         }
 
         string endpoint = "https://eodhistoricaldata.com/api/eod/";
@@ -107,10 +108,22 @@ namespace fre {
                 + "&api_token=" + token
                 + "&period=d";
 
+        // Backoff between attempts; false if cancelled meanwhile
+        auto backoff = [cancel](chrono::milliseconds d) {
+            if (!cancel) { this_thread::sleep_for(d); return true; }
+            return cancel->sleep_for(d);
+        };
+
+        // The handle may be reused by a caller without a cancel flag
+        curl_easy_setopt(curlHandle, CURLOPT_NOPROGRESS, cancel ? 0L : 1L);
+        curl_easy_setopt(curlHandle, CURLOPT_XFERINFOFUNCTION, cancel ? abort_if_cancelled : nullptr);
+        curl_easy_setopt(curlHandle, CURLOPT_XFERINFODATA, const_cast<CancelFlag*>(cancel));
+
         const int kMaxAttempts = 5;
         int attempt = 0;
 
         while (attempt < kMaxAttempts) {
+            if (cancel && cancel->cancelled()) return false;
 
             MemoryStruct buffer;
             buffer.memory = NULL;
@@ -121,81 +134,26 @@ namespace fre {
             curl_easy_setopt(curlHandle, CURLOPT_WRITEDATA, &buffer);
 
             CURLcode rc = curl_easy_perform(curlHandle);
+            ++stats->attempts;
             long http_code = 0;
             curl_easy_getinfo(curlHandle, CURLINFO_RESPONSE_CODE, &http_code);
             
             if (rc == CURLE_OK && http_code == 429) {
+                ++stats->rateLimited;
                 // exponential backoff + jitter: 1s, 2s, 4s, 8s, 16s 
                 int backoff_ms = (1 << attempt) * 1000;
                 int jitter_ms  = rand() % 200; 
-                this_thread::sleep_for(chrono::milliseconds(backoff_ms + jitter_ms));
-
                 if (buffer.memory) free(buffer.memory);
+                if (!backoff(chrono::milliseconds(backoff_ms + jitter_ms))) return false;
+
                 ++attempt;
                 continue;
             }
 
             if (rc == CURLE_OK && http_code == 200 && buffer.memory != NULL && buffer.size > 0) {
-
-                string csvText(buffer.memory, buffer.size);
-                stringstream csvStream(csvText);
-                string line;
-
-                if (!getline(csvStream, line)) {
-                    if (buffer.memory) free(buffer.memory);
-                    break;
-                }
-
-                vector<PriceData> series;
-                series.reserve(256);
-
-                while (getline(csvStream, line)) {
-                    if (line.empty()) continue;
-
-                    vector<string> fields;
-                    string token;
-                    stringstream ls(line);
-
-                    while (getline(ls, token, ',')) {
-                        fields.push_back(token);
-                    }
-
-                    if (fields.size() < 6) continue;
-
-                    string date   = normalize_date(fields[0]);
-                    string adjStr = fields[5];
-
-                    try {
-                        double adjClose = stod(adjStr);
-                        PriceData pd;
-                        pd.date  = date;
-                        pd.price = adjClose;
-                        series.push_back(pd);
-                    } catch (...) {
-                        continue;
-                    }
-                }
-
-                int eventIndex = -1;
-                for (size_t i = 0; i < series.size(); ++i) {
-                    if (series[i].date == eventDate) {
-                        eventIndex = (int)i;
-                        break;
-                    }
-                }
-
-                if (eventIndex != -1) {
-                    for (size_t i = 0; i < series.size(); ++i) {
-                        int offset = (int)i - eventIndex;
-                        series[i].date_label = "date_" + to_string(offset);
-                    }
-                }
-
-                result.swap(series);
-
-                if (buffer.memory) free(buffer.memory);
-
-                break;
+                csvText.assign(buffer.memory, buffer.size);
+                free(buffer.memory);
+                return true;
             }
             //TEST CODE
             // if (rc != CURLE_OK || http_code != 200) {
@@ -207,11 +165,61 @@ namespace fre {
             if (buffer.memory) free(buffer.memory);
 
             ++attempt;
-            if (attempt < kMaxAttempts) {
-                this_thread::sleep_for(chrono::seconds(attempt));
+            if (attempt < kMaxAttempts && !backoff(chrono::seconds(attempt))) return false;
+        }
+        return false;
+    }
+
+    // Parses the CSV into (day number, adjusted close); rows with a malformed date or price are skipped.
+    PriceHistory ParsePriceCsv(const string& csvText) {
+        PriceHistory series;
+
+        stringstream csvStream(csvText);
+        string line;
+
+        if (!getline(csvStream, line)) {
+            return series;
+        }
+
+        series.reserve(256);
+
+        while (getline(csvStream, line)) {
+            if (line.empty()) continue;
+
+            vector<string> fields;
+            string token;
+            stringstream ls(line);
+
+            while (getline(ls, token, ',')) {
+                fields.push_back(token);
+            }
+
+            if (fields.size() < 6) continue;
+
+            DayNumber day = toDayNumber(fields[0]);
+            if (day == kNoDay) continue;
+
+            try {
+                series.push_back(day, stod(fields[5]));
+            } catch (...) {
+                continue;
             }
         }
-        return result;
+
+        return series;
+    }
+
+    PriceHistory FetchPriceSeriesWithDates(
+        CURL* curlHandle,
+        const string& ticker,
+        const string& fromDate,
+        const string& toDate
+    ) {
+        string csvText;
+        if (!FetchPriceCsv(curlHandle, ticker, fromDate, toDate, csvText)) {
+            return PriceHistory();
+        }
+        return ParsePriceCsv(csvText);
     }
 
 } // namespace fre
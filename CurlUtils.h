@@ -5,6 +5,7 @@
 #include <curl/curl.h>
 
 #include "StockStructure.h" 
+#include "ThreadUtils.h"
 using namespace std;
 namespace fre 
 {
@@ -19,12 +20,43 @@ namespace fre
 
     size_t write_data2(void* ptr, size_t size, size_t nmemb, void* data);
 
-    vector<PriceData> FetchPriceSeriesWithDates(
+    // The provider's quota of EOD API requests per second, per API token
+    const int kApiQpsLimit = 30;
+
+    // Rate limit shared by every EOD API request of the process (kApiQpsLimit), so the
+    // background prefetcher and Option 1 together stay within the provider's quota.
+    // Sharded workers on one host lower it to their part of the quota.
+    QpsLimiter& apiLimiter();
+
+    // Request counts of one FetchPriceCsv call
+    struct FetchStats {
+        int attempts = 0;
+        int rateLimited = 0;  // HTTP 429 responses
+    };
+
+    // Download the raw EOD CSV body for a ticker and date range (retries, 429 backoff).
+    // Returns false if no non-empty 200 response arrived within the retry budget.
+    // Once cancel is set, a transfer in flight is aborted within about a second,
+    // a backoff wakes at once, and false is returned.
+    bool FetchPriceCsv(
         CURL* curlHandle,
         const string& ticker,
         const string& fromDate,
         const string& toDate,
-        const string& eventDate
+        string& csvText,
+        FetchStats* stats = nullptr,
+        const CancelFlag* cancel = nullptr
+    );
+
+    // Parse an EOD CSV body into (day number, adjusted close)
+    PriceHistory ParsePriceCsv(const string& csvText);
+
+    // FetchPriceCsv followed by ParsePriceCsv
+    PriceHistory FetchPriceSeriesWithDates(
+        CURL* curlHandle,
+        const string& ticker,
+        const string& fromDate,
+        const string& toDate
     );
 
 }
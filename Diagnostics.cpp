@@ -0,0 +1,180 @@
+#include "Diagnostics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+
+using namespace std;
+
+namespace fre {
+
+    // --- 1. Codes ---
+    const char* diagCodeName(DiagCode code)
+    {
+        switch (code) {
+            case DiagCode::WindowNoTradingDay:       return "WindowNoTradingDay";
+            case DiagCode::WindowTooFewBefore:       return "WindowTooFewBefore";
+            case DiagCode::WindowTooFewAfter:        return "WindowTooFewAfter";
+            case DiagCode::WindowTooFewBoth:         return "WindowTooFewBoth";
+            case DiagCode::CurlInitFailed:           return "CurlInitFailed";
+            case DiagCode::FetchFailed:              return "FetchFailed";
+            case DiagCode::RateLimited:              return "RateLimited";
+            case DiagCode::PriceCountMismatch:       return "PriceCountMismatch";
+            case DiagCode::ReturnCountMismatch:      return "ReturnCountMismatch";
+            case DiagCode::BenchmarkIndexOutOfRange: return "BenchmarkIndexOutOfRange";
+            case DiagCode::BenchmarkReturnMissing:   return "BenchmarkReturnMissing";
+            case DiagCode::NotInArchive:             return "NotInArchive";
+            default:                                 return "Unknown";
+        }
+    }
+
+    bool diagIsNotice(DiagCode code)
+    {
+        return code == DiagCode::RateLimited;
+    }
+
+    // --- 2. Per-thread buffers ---
+    // One-entry cache per thread: the buffer this thread last used and the id of its owner
+    static atomic<uint64_t> g_nextDiagnosticsId(1);
+    static thread_local uint64_t tl_owner = 0;
+    static thread_local void* tl_buffer = nullptr;
+
+    Diagnostics::Diagnostics() : id_(g_nextDiagnosticsId.fetch_add(1)) {}
+
+    Diagnostics::Buffer& Diagnostics::localBuffer()
+    {
+        if (tl_owner == id_) return *static_cast<Buffer*>(tl_buffer);
+
+        lock_guard<mutex> lock(registerMutex_);
+        buffers_.push_back(make_unique<Buffer>());
+        tl_owner = id_;
+        tl_buffer = buffers_.back().get();
+        return *buffers_.back();
+    }
+
+    void Diagnostics::report(DiagCode code, size_t event, int32_t a, int32_t b, int32_t c)
+    {
+        DiagRecord r;
+        r.event = static_cast<uint32_t>(event);
+        r.code = code;
+        r.a = a;
+        r.b = b;
+        r.c = c;
+        localBuffer().records.push_back(r);
+    }
+
+    const vector<DiagRecord>& Diagnostics::merge()
+    {
+        lock_guard<mutex> lock(registerMutex_);
+        size_t added = 0;
+        for (const auto& buf : buffers_) added += buf->records.size();
+        merged_.reserve(merged_.size() + added);
+
+        for (auto& buf : buffers_) {
+            merged_.insert(merged_.end(), buf->records.begin(), buf->records.end());
+            buf->records.clear();
+        }
+
+        // Thread timing decides buffer contents, so order by (event, code) for a stable report
+        stable_sort(merged_.begin(), merged_.end(), [](const DiagRecord& x, const DiagRecord& y) {
+            if (x.event != y.event) return x.event < y.event;
+            return x.code < y.code;
+        });
+        return merged_;
+    }
+
+    map<DiagCode, size_t> Diagnostics::countsByCode() const
+    {
+        map<DiagCode, size_t> counts;
+        for (const auto& r : merged_) ++counts[r.code];
+        return counts;
+    }
+
+    // --- 3. Deferred formatting ---
+    void Diagnostics::setContext(vector<EventKey> events, vector<string> calendar)
+    {
+        events_ = std::move(events);
+        calendar_ = std::move(calendar);
+    }
+
+    string Diagnostics::format(const DiagRecord& r) const
+    {
+        string ticker = "event #" + to_string(r.event);
+        string date = "?";
+        if (r.event < events_.size()) {
+            ticker = events_[r.event].first;
+            date = events_[r.event].second;
+        }
+
+        auto windowDetails = [&]() {
+            string msg = "Cannot build event window for " + ticker + " (event date = " + date + "). Details:";
+            if (r.code == DiagCode::WindowTooFewBefore || r.code == DiagCode::WindowTooFewBoth) {
+                msg += " Insufficient days BEFORE event. Needed " + to_string(r.a) +
+                       ", only " + to_string(r.b) + ".";
+            }
+            if (r.code == DiagCode::WindowTooFewAfter || r.code == DiagCode::WindowTooFewBoth) {
+                msg += " Insufficient days AFTER event. Needed " + to_string(r.a) +
+                       ", only " + to_string(r.c) + ".";
+            }
+            return msg;
+        };
+
+        switch (r.code) {
+            case DiagCode::WindowNoTradingDay:
+                return "Cannot build event window for " + ticker + " (event date = " + date +
+                       "). Details: Error: No trading day before " + date + ".";
+            case DiagCode::WindowTooFewBefore:
+            case DiagCode::WindowTooFewAfter:
+            case DiagCode::WindowTooFewBoth:
+                return windowDetails();
+            case DiagCode::CurlInitFailed:
+                return "Failed to initialize CURL for " + ticker;
+            case DiagCode::FetchFailed:
+                return "Download failed for " + ticker + " after " + to_string(r.a) +
+                       " attempts (" + to_string(r.b) + " rate limited)";
+            case DiagCode::NotInArchive:
+                return "No price file for " + ticker + " in the import archive";
+            case DiagCode::RateLimited:
+                return "Rate limited " + to_string(r.a) + " times before download of " + ticker;
+            case DiagCode::PriceCountMismatch:
+                return "Price series size mismatch for " + ticker + " (event date = " + date + ")" +
+                       ". Expected " + to_string(r.a) + " points, got " + to_string(r.b);
+            case DiagCode::ReturnCountMismatch:
+                return "Return series size mismatch for " + ticker +
+                       ". Expected " + to_string(r.a) + " returns, got " + to_string(r.b);
+            case DiagCode::BenchmarkIndexOutOfRange:
+                return "Benchmark index out of range for " + ticker + " at offset " + to_string(r.a);
+            case DiagCode::BenchmarkReturnMissing: {
+                string missing = (r.a >= 0 && static_cast<size_t>(r.a) < calendar_.size())
+                    ? calendar_[r.a] : "#" + to_string(r.a);
+                return "No benchmark return for date " + missing + " when processing " + ticker;
+            }
+            default:
+                return string(diagCodeName(r.code)) + " for " + ticker;
+        }
+    }
+
+    void Diagnostics::printWarnings(ostream& os) const
+    {
+        size_t n = 0;
+        for (const auto& r : merged_) {
+            if (diagIsNotice(r.code)) continue;
+            os << "[" << ++n << "] " << format(r) << "\n"
+               << "----------------------------------------\n";
+        }
+        if (n == 0) os << "No warnings.\n";
+    }
+
+    void Diagnostics::printSummary(ostream& os) const
+    {
+        map<DiagCode, size_t> counts = countsByCode();
+        if (counts.empty()) {
+            os << "No diagnostics.\n";
+            return;
+        }
+        for (const auto& kv : counts) {
+            os << left << setw(28) << diagCodeName(kv.first) << right << setw(8) << kv.second << "\n";
+        }
+    }
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "StockStructure.h"
+
+namespace fre {
+
+    // What went wrong (or was worth noting) for one event or ticker
+    enum class DiagCode : std::uint16_t {
+        WindowNoTradingDay,       // a = N
+        WindowTooFewBefore,       // a = N, b = days before day 0, c = days after
+        WindowTooFewAfter,        // same fields
+        WindowTooFewBoth,         // same fields
+        CurlInitFailed,           // ticker level
+        FetchFailed,              // ticker level, a = attempts, b = 429 responses
+        RateLimited,              // ticker level notice, a = 429 responses before success
+        PriceCountMismatch,       // a = expected points, b = got
+        ReturnCountMismatch,      // a = expected returns, b = got
+        BenchmarkIndexOutOfRange, // a = event-day offset
+        BenchmarkReturnMissing,   // a = calendar index of the missing date
+        NotInArchive,             // ticker level, offline import has no file for it
+        Count
+    };
+
+    const char* diagCodeName(DiagCode code);
+
+    // Notices are counted in the summary but not listed as warnings
+    bool diagIsNotice(DiagCode code);
+
+    // One diagnostic: no strings, formatting happens only when the report is printed
+    struct DiagRecord {
+        std::uint32_t event = 0;  // index into the run's event list; ticker-level codes use its first event
+        DiagCode code = DiagCode::Count;
+        std::int32_t a = 0;
+        std::int32_t b = 0;
+        std::int32_t c = 0;
+    };
+
+    // Append-only diagnostics shared by the threads of one run.
+    // Each thread appends to its own buffer; the registry mutex is taken only the first
+    // time a thread reports to this object, never per record. merge() must run after
+    // every producer has finished (pipeline wait, pool drain).
+    class Diagnostics {
+    public:
+        Diagnostics();
+        Diagnostics(const Diagnostics&) = delete;
+        Diagnostics& operator=(const Diagnostics&) = delete;
+
+        void report(DiagCode code, std::size_t event,
+                    std::int32_t a = 0, std::int32_t b = 0, std::int32_t c = 0);
+
+        // Move all thread buffers into one list ordered by (event, code)
+        const std::vector<DiagRecord>& merge();
+        const std::vector<DiagRecord>& records() const { return merged_; }
+
+        // Merged records per code
+        std::map<DiagCode, std::size_t> countsByCode() const;
+
+        // Labels used by format(): event ids index events, calendar indices index calendar
+        void setContext(std::vector<EventKey> events, std::vector<std::string> calendar);
+        std::string format(const DiagRecord& r) const;
+
+        // Numbered warnings (notices skipped), then counts by code
+        void printWarnings(std::ostream& os) const;
+        void printSummary(std::ostream& os) const;
+
+    private:
+        struct Buffer {
+            std::vector<DiagRecord> records;
+        };
+
+        Buffer& localBuffer();
+
+        std::uint64_t id_;  // never reused, so a thread's cached buffer cannot outlive its owner
+        std::mutex registerMutex_;
+        std::vector<std::unique_ptr<Buffer>> buffers_;
+        std::vector<DiagRecord> merged_;
+
+        std::vector<EventKey> events_;
+        std::vector<std::string> calendar_;
+    };
+
+}
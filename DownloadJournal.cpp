@@ -0,0 +1,352 @@
+#include "DownloadJournal.h"
+#include "MappedFile.h"
+#include "Snapshot.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace fre {
+
+    // --- File layout ---
+    // File:   "FREJRNL\0", uint32 version, uint32 reserved, then records back to back
+    // Record: uint32 kRecordMagic, uint32 payload bytes, uint64 checksum of the payload,
+    //         payload = uint32 ticker length, ticker, int32 from, int32 to,
+    //                   int64 fetched at (seconds since the epoch), uint32 n,
+    //                   n int32 days, n double prices
+    namespace {
+        const char kFileMagic[8] = { 'F', 'R', 'E', 'J', 'R', 'N', 'L', '\0' };
+        const uint32_t kJournalVersion = 2;
+        const size_t kFixedPayloadBytes = 24;  // everything but the ticker, days and prices
+        const size_t kFileHeaderBytes = 16;
+        const uint32_t kRecordMagic = 0x4345524a;  // "JREC"
+        const size_t kRecordHeaderBytes = 16;
+
+        template <class T>
+        void put(vector<char>& buf, const T& v) {
+            const char* p = reinterpret_cast<const char*>(&v);
+            buf.insert(buf.end(), p, p + sizeof(T));
+        }
+
+        template <class T>
+        T get(const char* p) {
+            T v;
+            memcpy(&v, p, sizeof(T));
+            return v;
+        }
+
+        bool writeAll(int fd, const char* data, size_t size) {
+            while (size > 0) {
+                ssize_t n = ::write(fd, data, size);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    return false;
+                }
+                data += n;
+                size -= static_cast<size_t>(n);
+            }
+            return true;
+        }
+    }
+
+    DownloadJournal::DownloadJournal(chrono::milliseconds commitDelay, chrono::seconds maxAge)
+        : commitDelay_(commitDelay), maxAge_(maxAge) {}
+
+    DownloadJournal::~DownloadJournal()
+    {
+        close();
+    }
+
+    size_t DownloadJournal::replay(const string& path, size_t& fileSize)
+    {
+        struct Record {
+            string ticker;
+            Entry entry;
+            int64_t fetchedAt;
+            size_t offset, bytes;
+        };
+        vector<Record> records;
+        size_t goodEnd = 0;
+        fileSize = 0;
+
+        MappedFile file;
+        if (!file.open(path)) return 0;
+        fileSize = file.size();
+        if (file.size() < kFileHeaderBytes || memcmp(file.data(), kFileMagic, sizeof(kFileMagic)) != 0 ||
+            get<uint32_t>(file.data() + 8) != kJournalVersion) {
+            return 0;  // not a journal of this version: start over
+        }
+
+        // --- Every intact record, up to the first torn or corrupt one ---
+        const char* base = file.data();
+        size_t pos = kFileHeaderBytes;
+        goodEnd = pos;
+        while (fileSize - pos >= kRecordHeaderBytes) {
+            uint32_t magic = get<uint32_t>(base + pos);
+            uint32_t size = get<uint32_t>(base + pos + 4);
+            uint64_t sum = get<uint64_t>(base + pos + 8);
+            const char* p = base + pos + kRecordHeaderBytes;
+            if (magic != kRecordMagic || size > fileSize - pos - kRecordHeaderBytes) break;
+            if (snapshotChecksum(p, size) != sum || size < kFixedPayloadBytes) break;
+
+            uint32_t tickerLen = get<uint32_t>(p);
+            if (tickerLen > size - kFixedPayloadBytes) break;
+            const char* q = p + 4 + tickerLen;
+            DayNumber from = get<int32_t>(q);
+            DayNumber to = get<int32_t>(q + 4);
+            int64_t fetchedAt = get<int64_t>(q + 8);
+            uint32_t n = get<uint32_t>(q + 16);
+            if (size_t(n) * (sizeof(DayNumber) + sizeof(double)) != size - kFixedPayloadBytes - tickerLen) break;
+
+            auto history = make_shared<PriceHistory>();
+            history->days.resize(n);
+            history->prices.resize(n);
+            memcpy(history->days.data(), q + 20, n * sizeof(DayNumber));
+            memcpy(history->prices.data(), q + 20 + n * sizeof(DayNumber), n * sizeof(double));
+            records.push_back(Record{ string(p + 4, tickerLen), Entry{ from, to, std::move(history) },
+                                      fetchedAt, pos, kRecordHeaderBytes + size });
+            pos += kRecordHeaderBytes + size;
+            goodEnd = pos;
+        }
+
+        // --- Expired: older than maxAge_, or covered by a later record of the ticker ---
+        const int64_t now = static_cast<int64_t>(time(nullptr));
+        vector<bool> live(records.size(), true);
+        unordered_map<string, vector<size_t>> byTicker;
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (now - records[i].fetchedAt > maxAge_.count()) live[i] = false;
+            else byTicker[records[i].ticker].push_back(i);
+        }
+        for (const auto& t : byTicker) {
+            const vector<size_t>& list = t.second;
+            for (size_t a = 0; a < list.size(); ++a) {
+                const Entry& older = records[list[a]].entry;
+                for (size_t b = a + 1; b < list.size(); ++b) {
+                    const Entry& newer = records[list[b]].entry;
+                    if (newer.from <= older.from && newer.to >= older.to) { live[list[a]] = false; break; }
+                }
+            }
+        }
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (!live[i]) { ++stats_.expiredRecords; continue; }
+            index(records[i].ticker, std::move(records[i].entry));
+            ++stats_.replayedRecords;
+        }
+        if (stats_.expiredRecords == 0) return goodEnd;
+
+        // --- Compaction: the live records into a new file, renamed over the journal ---
+        const string tmp = path + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool ok = fd >= 0 && writeAll(fd, base, kFileHeaderBytes);
+        size_t compacted = kFileHeaderBytes;
+        for (size_t i = 0; ok && i < records.size(); ++i) {
+            if (!live[i]) continue;
+            ok = writeAll(fd, base + records[i].offset, records[i].bytes);
+            compacted += records[i].bytes;
+        }
+        ok = ok && fsync(fd) == 0;
+        if (fd >= 0) ::close(fd);
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+            // Keep the old file; the expired records are only not indexed this session
+            remove(tmp.c_str());
+            return goodEnd;
+        }
+        syncParentDirectory(path);
+        stats_.droppedTailBytes = fileSize - goodEnd;
+        fileSize = compacted;
+        return compacted;
+    }
+
+    bool DownloadJournal::open(const string& path, string& error)
+    {
+        close();
+        {
+            lock_guard<mutex> lock(indexMutex_);
+            index_.clear();
+        }
+        stats_ = JournalStats();
+
+        size_t fileSize = 0;
+        size_t goodEnd = replay(path, fileSize);
+
+        // --- Reopen for appending, cutting off whatever follows the last intact record ---
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd_ < 0) {
+            error = path + ": " + strerror(errno);
+            return false;
+        }
+        if (fileSize != goodEnd) {
+            stats_.droppedTailBytes = goodEnd == 0 ? 0 : fileSize - goodEnd;
+            if (ftruncate(fd_, static_cast<off_t>(goodEnd)) != 0) {
+                error = path + ": " + strerror(errno);
+                ::close(fd_);
+                fd_ = -1;
+                return false;
+            }
+        }
+        if (goodEnd == 0) {
+            vector<char> header(kFileMagic, kFileMagic + sizeof(kFileMagic));
+            put(header, kJournalVersion);
+            put(header, uint32_t(0));
+            if (!writeAll(fd_, header.data(), header.size()) || fdatasync(fd_) != 0) {
+                error = path + ": " + strerror(errno);
+                ::close(fd_);
+                fd_ = -1;
+                return false;
+            }
+        }
+        durableBytes_ = static_cast<size_t>(lseek(fd_, 0, SEEK_END));
+
+        path_ = path;
+        stopping_ = false;
+        writeFailed_ = false;
+        pending_.clear();
+        queuedSeq_ = durableSeq_ = 0;
+        writer_ = thread([this]() { writerLoop(); });
+        return true;
+    }
+
+    void DownloadJournal::index(const string& ticker, Entry entry)
+    {
+        lock_guard<mutex> lock(indexMutex_);
+        index_[ticker].push_back(std::move(entry));
+    }
+
+    shared_ptr<const PriceHistory> DownloadJournal::find(const string& ticker, DayNumber from, DayNumber to) const
+    {
+        lock_guard<mutex> lock(indexMutex_);
+        auto it = index_.find(ticker);
+        if (it == index_.end()) return nullptr;
+        // Newest first: a later download of the range has the current adjustments
+        for (auto e = it->second.rbegin(); e != it->second.rend(); ++e) {
+            if (e->from <= from && e->to >= to) return e->history;
+        }
+        return nullptr;
+    }
+
+    void DownloadJournal::append(const string& ticker, DayNumber from, DayNumber to,
+                                 shared_ptr<const PriceHistory> history)
+    {
+        if (!history || fd_ < 0) return;
+
+        // Frame the record before taking the lock; the writer only concatenates
+        const uint32_t n = static_cast<uint32_t>(history->size());
+        vector<char> payload;
+        payload.reserve(kFixedPayloadBytes + ticker.size() + n * (sizeof(DayNumber) + sizeof(double)));
+        put(payload, static_cast<uint32_t>(ticker.size()));
+        payload.insert(payload.end(), ticker.begin(), ticker.end());
+        put(payload, static_cast<int32_t>(from));
+        put(payload, static_cast<int32_t>(to));
+        put(payload, static_cast<int64_t>(time(nullptr)));
+        put(payload, n);
+        const char* days = reinterpret_cast<const char*>(history->days.data());
+        const char* prices = reinterpret_cast<const char*>(history->prices.data());
+        payload.insert(payload.end(), days, days + n * sizeof(DayNumber));
+        payload.insert(payload.end(), prices, prices + n * sizeof(double));
+
+        vector<char> record;
+        record.reserve(kRecordHeaderBytes + payload.size());
+        put(record, kRecordMagic);
+        put(record, static_cast<uint32_t>(payload.size()));
+        put(record, snapshotChecksum(payload.data(), payload.size()));
+        record.insert(record.end(), payload.begin(), payload.end());
+
+        index(ticker, Entry{ from, to, std::move(history) });
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (writeFailed_) return;  // the session's downloads stay in the index only
+            pending_.insert(pending_.end(), record.begin(), record.end());
+            ++queuedSeq_;
+            ++stats_.appendedRecords;
+        }
+        wake_.notify_one();
+    }
+
+    void DownloadJournal::writerLoop()
+    {
+        unique_lock<mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+            if (pending_.empty()) break;  // stopping with nothing left
+
+            // Group commit: let the records of the next few downloads join this batch
+            if (!stopping_) wake_.wait_for(lock, commitDelay_, [this]() { return stopping_; });
+
+            vector<char> batch;
+            batch.swap(pending_);
+            uint64_t seq = queuedSeq_;
+            lock.unlock();
+
+            bool ok = writeAll(fd_, batch.data(), batch.size()) && fdatasync(fd_) == 0;
+            int writeErrno = errno;
+            if (!ok) {
+                // Cut off the partial batch, so replay still reaches every earlier record
+                if (ftruncate(fd_, static_cast<off_t>(durableBytes_)) == 0) fdatasync(fd_);
+                lseek(fd_, static_cast<off_t>(durableBytes_), SEEK_SET);
+            }
+
+            lock.lock();
+            if (!ok) {
+                cerr << "[DownloadJournal] Warning: write to " << path_ << " failed ("
+                     << strerror(writeErrno) << "); later downloads are not journaled." << endl;
+                writeFailed_ = true;
+                pending_.clear();
+                durable_.notify_all();  // flush() returns; durableSeq_ stays at the last real commit
+                break;
+            }
+            ++stats_.commits;
+            stats_.bytesWritten += batch.size();
+            durableBytes_ += batch.size();
+            durableSeq_ = seq;
+            durable_.notify_all();
+        }
+    }
+
+    void DownloadJournal::flush()
+    {
+        unique_lock<mutex> lock(mutex_);
+        if (fd_ < 0) return;
+        uint64_t target = queuedSeq_;
+        wake_.notify_one();
+        durable_.wait(lock, [&]() { return durableSeq_ >= target || writeFailed_; });
+    }
+
+    void DownloadJournal::close()
+    {
+        if (writer_.joinable()) {
+            {
+                lock_guard<mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            wake_.notify_all();
+            writer_.join();
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    JournalStats DownloadJournal::stats() const
+    {
+        lock_guard<mutex> lock(mutex_);
+        return stats_;
+    }
+
+    void DownloadJournal::report(ostream& os) const
+    {
+        JournalStats s = stats();
+        os << s.replayedRecords << " replayed, " << s.appendedRecords << " appended in "
+           << s.commits << " commit(s), " << s.bytesWritten / 1024 << " KB written";
+        if (s.droppedTailBytes > 0) os << ", " << s.droppedTailBytes << " torn bytes dropped";
+        if (s.expiredRecords > 0) os << ", " << s.expiredRecords << " expired record(s) compacted away";
+    }
+
+}
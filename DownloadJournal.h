@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "StockStructure.h"
+
+namespace fre {
+
+    struct JournalStats {
+        std::size_t replayedRecords = 0;  // valid records found by open()
+        std::size_t droppedTailBytes = 0; // torn or corrupt tail cut off by open()
+        std::size_t expiredRecords = 0;   // older than maxAge or covered by a newer record; compacted away by open()
+        std::size_t appendedRecords = 0;  // since open()
+        std::size_t commits = 0;          // write + fdatasync batches since open()
+        std::size_t bytesWritten = 0;
+    };
+
+    // Append-only, crash-safe record of completed price downloads.
+    //
+    // Each record holds one ticker's requested day range and its parsed history, framed
+    // by a length and a checksum. open() replays the file, cuts off a record torn by a
+    // crash, and indexes the rest by ticker; find() then answers later requests without
+    // the network. append() only queues the record: a writer thread gathers everything
+    // queued within commitDelay into one write and one fdatasync (group commit), so a
+    // download never waits on the disk.
+    //
+    // Adjusted closes change with every dividend or split, so a record older than maxAge
+    // is not replayed, and neither is one a newer record of the ticker covers. open()
+    // rewrites the file without them, which keeps it from growing without bound. After a
+    // failed write the file is cut back to its last complete batch and the journal stops
+    // taking records for the rest of the session.
+    class DownloadJournal {
+    public:
+        explicit DownloadJournal(std::chrono::milliseconds commitDelay = std::chrono::milliseconds(50),
+                                 std::chrono::seconds maxAge = std::chrono::hours(24));
+        ~DownloadJournal();  // commits what is queued, then closes
+        DownloadJournal(const DownloadJournal&) = delete;
+        DownloadJournal& operator=(const DownloadJournal&) = delete;
+
+        // Replay and open for appending; false with error set if the file cannot be used.
+        // A file of another format is replaced by an empty journal.
+        bool open(const std::string& path, std::string& error);
+        bool isOpen() const { return fd_ >= 0; }
+        const std::string& path() const { return path_; }
+
+        // A journaled history of ticker covering [from, to], or null
+        std::shared_ptr<const PriceHistory> find(const std::string& ticker, DayNumber from, DayNumber to) const;
+
+        // Queue one completed download; durable after the next commit
+        void append(const std::string& ticker, DayNumber from, DayNumber to,
+                    std::shared_ptr<const PriceHistory> history);
+
+        // Block until every record appended so far is on disk, or a write has failed
+        void flush();
+        void close();
+
+        JournalStats stats() const;
+        void report(std::ostream& os) const;
+
+    private:
+        struct Entry {
+            DayNumber from;
+            DayNumber to;
+            std::shared_ptr<const PriceHistory> history;
+        };
+
+        // Replay path into the index; returns the end of the last intact record (0 if the file
+        // is not a journal of this version), rewriting the file first if records expired
+        std::size_t replay(const std::string& path, std::size_t& fileSize);
+
+        void index(const std::string& ticker, Entry entry);
+        void writerLoop();
+
+        std::chrono::milliseconds commitDelay_;
+        std::chrono::seconds maxAge_;
+        std::string path_;
+        int fd_ = -1;
+
+        mutable std::mutex indexMutex_;
+        std::unordered_map<std::string, std::vector<Entry>> index_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable wake_;     // writer: records queued or stopping
+        std::condition_variable durable_;  // flush(): a commit finished
+        std::vector<char> pending_;
+        std::uint64_t queuedSeq_ = 0;      // records queued so far
+        std::uint64_t durableSeq_ = 0;     // records on disk
+        bool stopping_ = false;
+        bool writeFailed_ = false;         // no more records are queued once set
+        std::size_t durableBytes_ = 0;     // file size after the last successful commit
+        JournalStats stats_;
+        std::thread writer_;
+    };
+
+}
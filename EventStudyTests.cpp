@@ -0,0 +1,188 @@
+#include "EventStudyTests.h"
+#include "ThreadUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace fre {
+
+    using namespace std;
+
+    vector<pair<int, int>> defaultCARWindows(int N)
+    {
+        return { {-1, 1}, {0, 1}, {-N + 1, 0}, {1, N}, {-N + 1, N} };
+    }
+
+    // t statistic of a mean from running sums; 0 when undefined
+    static double tFromSums(double sum, double sumsq, int n)
+    {
+        if (n < 2) return 0.0;
+        double mean = sum / n;
+        double var = (sumsq - sum * mean) / (n - 1);
+        if (var <= 0.0) return 0.0;
+        return mean / sqrt(var / n);
+    }
+
+    EventTestResult runEventStudyTests(const ReturnPanel& panel,
+                                       const MarketModelFit& fit,
+                                       AbnormalReturnModel model,
+                                       int N,
+                                       size_t colBegin,
+                                       size_t colEnd)
+    {
+        EventTestResult result;
+        result.carWindows = defaultCARWindows(N);
+
+        colEnd = min(colEnd, panel.numEvents);
+        if (colBegin >= colEnd) return result;
+
+        const size_t n = colEnd - colBegin;
+        const int T = 2 * N;
+        const bool mm = (model == AbnormalReturnModel::MarketModel);
+
+        // --- Per-event weights and standardization constants ---
+        // w: AR usable, ws: estimation window usable (standardized and rank tests)
+        vector<unsigned char> w(n), ws(n);
+        Vector invS(n, 0.0), cL(n, 0.0), mMean(n, 0.0), invSxx(n, 0.0);
+        double sumVarSAR = 0.0;
+        int nAR = 0, nStd = 0;
+
+        for (size_t i = 0; i < n; ++i) {
+            size_t e = colBegin + i;
+            w[i] = isfinite(fit.alpha[e]) && isfinite(fit.beta[e]);
+            ws[i] = w[i] && fit.obs[e] > 0 && fit.residVar[e] > 0.0;
+            nAR += w[i];
+            if (!ws[i]) continue;
+
+            ++nStd;
+            double L = fit.obs[e];
+            double df = mm ? L - 2.0 : L - 1.0;
+            sumVarSAR += df / (df - 2.0);  // variance of a t-distributed SAR
+            invS[i] = 1.0 / sqrt(fit.residVar[e]);
+            if (mm) {
+                cL[i] = 1.0 / L;
+                mMean[i] = fit.marketMean[e];
+                invSxx[i] = 1.0 / fit.marketSxx[e];
+            }
+        }
+
+        WorkStealingPool& pool = computePool();
+
+        // --- Corrado ranks: each event ranks its ARs over the whole panel span, parallel over events ---
+        // rankDev is day-major like the panel: (K_it - (D + 1) / 2) for standardized events, 0 otherwise
+        const int D = panel.numDays();
+        const double midRank = (D + 1) / 2.0;
+        PanelVector rankDev(static_cast<size_t>(D) * n, 0.0, panel.resource());
+
+        parallel_for(pool, IndexRange{0, n}, 0, [&](size_t b, size_t e) {
+            Vector col(D);
+            vector<int> order(D);
+            for (size_t i = b; i < e; ++i) {
+                if (!ws[i]) continue;
+                for (int d = 0; d < D; ++d) {
+                    col[d] = panel.abnormalRet[panel.index(panel.dayLo + d, colBegin + i)];
+                }
+                iota(order.begin(), order.end(), 0);
+                sort(order.begin(), order.end(), [&](int x, int y) { return col[x] < col[y]; });
+                for (int k = 0; k < D; ++k) {
+                    rankDev[static_cast<size_t>(order[k]) * n + i] = (k + 1) - midRank;
+                }
+            }
+        });
+
+        // --- Daily reductions over contiguous panel rows, parallel over days ---
+        // sar keeps the event-window standardized ARs for the CAR windows below
+        PanelVector sar(static_cast<size_t>(T) * n, 0.0, panel.resource());
+        Vector kbar(D, 0.0);
+        result.days.resize(T);
+        result.daily.resize(T);
+
+        parallel_for(pool, IndexRange{0, static_cast<size_t>(D)}, 0, [&](size_t b, size_t e) {
+            for (size_t row = b; row < e; ++row) {
+                int day = panel.dayLo + static_cast<int>(row);
+
+                const double* u = &rankDev[row * n];
+                double sumU = 0.0;
+                for (size_t i = 0; i < n; ++i) sumU += u[i];
+                kbar[row] = nStd > 0 ? sumU / nStd : 0.0;
+
+                if (day < -N + 1) continue;  // estimation rows only feed the rank statistic
+
+                const double* ar = &panel.abnormalRet[panel.index(day, colBegin)];
+                const double* m  = &panel.marketRet[panel.index(day, colBegin)];
+                double* s = &sar[static_cast<size_t>(day + N - 1) * n];
+
+                double sum = 0.0, sumsq = 0.0, sumS = 0.0, sumS2 = 0.0;
+                for (size_t i = 0; i < n; ++i) {
+                    double x = w[i] ? ar[i] : 0.0;
+                    double dm = m[i] - mMean[i];
+                    double corr = 1.0 + cL[i] + dm * dm * invSxx[i];  // forecast-error correction, 1 for market-adjusted
+                    double z = ws[i] ? x * invS[i] / sqrt(corr) : 0.0;
+                    s[i] = z;
+                    sum += x;    sumsq += x * x;
+                    sumS += z;   sumS2 += z * z;
+                }
+
+                EventTestRow& r = result.daily[day + N - 1];
+                r.n = nAR;
+                r.nStd = nStd;
+                r.meanAR = nAR > 0 ? sum / nAR : 0.0;
+                r.tCS = tFromSums(sum, sumsq, nAR);
+                r.patellZ = sumVarSAR > 0.0 ? sumS / sqrt(sumVarSAR) : 0.0;
+                r.bmpT = tFromSums(sumS, sumS2, nStd);
+                result.days[day + N - 1] = day;
+            }
+        });
+
+        double SK = 0.0;
+        for (int row = 0; row < D; ++row) SK += kbar[row] * kbar[row];
+        SK = sqrt(SK / D);
+
+        for (int t = 0; t < T; ++t) {
+            int row = result.days[t] - panel.dayLo;
+            result.daily[t].corradoT = SK > 0.0 ? kbar[row] / SK : 0.0;
+        }
+
+        // --- CAR windows: accumulate event-window rows per event, then test across events ---
+        for (const auto& win : result.carWindows) {
+            int t1 = max(win.first, -N + 1);
+            int t2 = min(win.second, N);
+            EventTestRow r;
+            r.n = nAR;
+            r.nStd = nStd;
+            if (t1 > t2) { result.car.push_back(r); continue; }
+
+            int len = t2 - t1 + 1;
+            Vector car(n, 0.0), scar(n, 0.0);
+            double sumK = 0.0;
+            for (int day = t1; day <= t2; ++day) {
+                const double* ar = &panel.abnormalRet[panel.index(day, colBegin)];
+                const double* s  = &sar[static_cast<size_t>(day + N - 1) * n];
+                for (size_t i = 0; i < n; ++i) {
+                    car[i]  += w[i] ? ar[i] : 0.0;
+                    scar[i] += s[i];
+                }
+                sumK += kbar[day - panel.dayLo];
+            }
+
+            double sum = 0.0, sumsq = 0.0, sumS = 0.0, sumS2 = 0.0;
+            double norm = 1.0 / sqrt(static_cast<double>(len));
+            for (size_t i = 0; i < n; ++i) {
+                double z = scar[i] * norm;
+                sum += car[i];  sumsq += car[i] * car[i];
+                sumS += z;      sumS2 += z * z;
+            }
+
+            r.meanAR = nAR > 0 ? sum / nAR : 0.0;
+            r.tCS = tFromSums(sum, sumsq, nAR);
+            r.patellZ = sumVarSAR > 0.0 ? sumS / sqrt(sumVarSAR) : 0.0;
+            r.bmpT = tFromSums(sumS, sumS2, nStd);
+            r.corradoT = SK > 0.0 ? sumK / (sqrt(static_cast<double>(len)) * SK) : 0.0;
+            result.car.push_back(r);
+        }
+
+        return result;
+    }
+
+}
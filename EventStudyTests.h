@@ -0,0 +1,42 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "ReturnPanel.h"
+
+namespace fre {
+
+    // Test statistics for one event day or one CAR window
+    struct EventTestRow {
+        int n = 0;              // events used by the cross-sectional t-test
+        int nStd = 0;           // events with an estimation window (Patell / BMP / Corrado)
+        double meanAR = 0.0;    // mean AR (day) or mean CAR (window)
+        double tCS = 0.0;       // cross-sectional t
+        double patellZ = 0.0;   // Patell standardized-residual Z
+        double bmpT = 0.0;      // Boehmer-Musumeci-Poulsen standardized cross-sectional t
+        double corradoT = 0.0;  // Corrado rank test (Cowan's window form for CARs)
+    };
+
+    // Full test suite for one group
+    struct EventTestResult {
+        std::vector<int> days;                       // event days -N+1 .. N
+        std::vector<EventTestRow> daily;             // one row per event day
+        std::vector<std::pair<int, int>> carWindows; // inclusive [t1, t2]
+        std::vector<EventTestRow> car;               // one row per CAR window
+    };
+
+    // CAR windows reported by default: [-1,+1], [0,+1], [-N+1,0], [+1,+N], [-N+1,+N]
+    std::vector<std::pair<int, int>> defaultCARWindows(int N);
+
+    // Run all tests for the events in panel columns [colBegin, colEnd).
+    // Reductions run over contiguous day rows of the panel; Corrado ranks are
+    // computed per event over its estimation + event window, in parallel.
+    EventTestResult runEventStudyTests(const ReturnPanel& panel,
+                                       const MarketModelFit& fit,
+                                       AbnormalReturnModel model,
+                                       int N,
+                                       size_t colBegin,
+                                       size_t colEnd);
+
+}
@@ -5,7 +5,7 @@
 
 namespace fre {
 
-void Gnuplot::plotCAAR(const std::vector<Vector>& caarLines, int N)
+void Gnuplot::plotCAAR(const std::vector<Vector>& caarLines, int N, const std::string& title)
 {
     // // Basic check: need exactly 3 CAAR series
     if (caarLines.size() < 3) {
@@ -40,7 +40,7 @@ void Gnuplot::plotCAAR(const std::vector<Vector>& caarLines, int N)
 
     
     // Basic plot settings: title, labels, grid, legend position
-    std::fprintf(gp, "set title 'Expected CAAR for Beat / Meet / Miss'\n");
+    std::fprintf(gp, "set title '%s'\n", title.c_str());
     std::fprintf(gp, "set xlabel 'Event Day (t)'\n");
     std::fprintf(gp, "set ylabel 'CAAR'\n");
     std::fprintf(gp, "set grid\n");
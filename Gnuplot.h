@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 #include "MatrixOperator.h"   // for Vector typedef
 
@@ -10,7 +11,9 @@ namespace fre {
     public:
         // Accepts the CAAR data prepared by StatCalculator
         // Convention: lines[0] = Beat, lines[1] = Meet, lines[2] = Miss
-        static void plotCAAR(const std::vector<Vector>& caarLines, int N);
+        // The title lets a live estimate from a running Option 1 say so on the plot
+        static void plotCAAR(const std::vector<Vector>& caarLines, int N,
+                             const std::string& title = "Expected CAAR for Beat / Meet / Miss");
     };
 
 } 
@@ -0,0 +1,343 @@
+#include "LogKernel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <random>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FRE_LOG_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace fre {
+
+    // --- Scalar reference ---
+    static void logArrayScalar(const double* x, size_t n, double* out) {
+        for (size_t i = 0; i < n; ++i) out[i] = log(x[i]);
+    }
+
+    static void logReturnsScalar(const double* p, size_t n, double* out) {
+        for (size_t i = 0; i + 1 < n; ++i) out[i] = log(p[i + 1] / p[i]);
+    }
+
+#ifdef FRE_LOG_KERNEL_X86
+    // --- SIMD logarithm ---
+    // fdlibm's reduction and polynomial (as in musl's log.c), evaluated lane-wise:
+    //   x = 2^k * (1 + f), sqrt(2)/2 <= 1 + f < sqrt(2), s = f / (2 + f)
+    //   log(x) = k*ln2_hi + (f - hfsq + s*(hfsq + R(s^2)) + k*ln2_lo)
+    // Valid for positive normal finite lanes; any other lane is recomputed with std::log.
+    namespace {
+        const double kLn2Hi = 6.93147180369123816490e-01;
+        const double kLn2Lo = 1.90821492927058770002e-10;
+        const double kLg1 = 6.666666666666735130e-01;
+        const double kLg2 = 3.999999999940941908e-01;
+        const double kLg3 = 2.857142874366239149e-01;
+        const double kLg4 = 2.222219843214978396e-01;
+        const double kLg5 = 1.818357216161805012e-01;
+        const double kLg6 = 1.531383769920937332e-01;
+        const double kLg7 = 1.479819860511658591e-01;
+
+        // Moves the exponent boundary from 1 down to sqrt(2)/2 (high words 0x3ff00000, 0x3fe6a09e)
+        const int64_t kReduceShift = int64_t(0x3ff00000 - 0x3fe6a09e) << 32;
+        const int64_t kReduceBase  = int64_t(0x3fe6a09e) << 32;
+        const int64_t kMantMask    = 0x000fffffffffffffLL;
+        // k is formed as double(2^52 + biased exponent) - (2^52 + 1023)
+        const int64_t kMagicBits   = 0x4330000000000000LL;
+        const double  kMagicBias   = 4503599627370496.0 + 1023.0;
+    }
+
+    __attribute__((target("avx2,fma")))
+    static inline __m256d log4(__m256d x) {
+        __m256i hx = _mm256_add_epi64(_mm256_castpd_si256(x), _mm256_set1_epi64x(kReduceShift));
+        __m256i ke = _mm256_or_si256(_mm256_srli_epi64(hx, 52), _mm256_set1_epi64x(kMagicBits));
+        __m256d dk = _mm256_sub_pd(_mm256_castsi256_pd(ke), _mm256_set1_pd(kMagicBias));
+        __m256i mb = _mm256_add_epi64(_mm256_and_si256(hx, _mm256_set1_epi64x(kMantMask)),
+                                      _mm256_set1_epi64x(kReduceBase));
+        __m256d f = _mm256_sub_pd(_mm256_castsi256_pd(mb), _mm256_set1_pd(1.0));
+
+        __m256d hfsq = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), f), f);
+        __m256d s = _mm256_div_pd(f, _mm256_add_pd(_mm256_set1_pd(2.0), f));
+        __m256d z = _mm256_mul_pd(s, s);
+        __m256d w = _mm256_mul_pd(z, z);
+        __m256d t1 = _mm256_fmadd_pd(w, _mm256_set1_pd(kLg6), _mm256_set1_pd(kLg4));
+        t1 = _mm256_fmadd_pd(w, t1, _mm256_set1_pd(kLg2));
+        t1 = _mm256_mul_pd(w, t1);
+        __m256d t2 = _mm256_fmadd_pd(w, _mm256_set1_pd(kLg7), _mm256_set1_pd(kLg5));
+        t2 = _mm256_fmadd_pd(w, t2, _mm256_set1_pd(kLg3));
+        t2 = _mm256_fmadd_pd(w, t2, _mm256_set1_pd(kLg1));
+        t2 = _mm256_mul_pd(z, t2);
+        __m256d R = _mm256_add_pd(t2, t1);
+
+        __m256d r = _mm256_fmadd_pd(s, _mm256_add_pd(hfsq, R), _mm256_mul_pd(dk, _mm256_set1_pd(kLn2Lo)));
+        r = _mm256_sub_pd(r, hfsq);
+        r = _mm256_add_pd(r, f);
+        return _mm256_fmadd_pd(dk, _mm256_set1_pd(kLn2Hi), r);
+    }
+
+    __attribute__((target("avx2,fma")))
+    static inline void store4(double* out, __m256d v) {
+        const __m256d lo = _mm256_set1_pd(DBL_MIN);
+        const __m256d hi = _mm256_set1_pd(numeric_limits<double>::infinity());
+        __m256d ok = _mm256_and_pd(_mm256_cmp_pd(v, lo, _CMP_GE_OQ), _mm256_cmp_pd(v, hi, _CMP_LT_OQ));
+        _mm256_storeu_pd(out, log4(v));
+        int mask = _mm256_movemask_pd(ok);
+        if (mask != 0xF) {
+            alignas(32) double in[4];
+            _mm256_store_pd(in, v);
+            for (int l = 0; l < 4; ++l) {
+                if (!(mask & (1 << l))) out[l] = log(in[l]);
+            }
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    static void logArrayAvx2(const double* x, size_t n, double* out) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) store4(out + i, _mm256_loadu_pd(x + i));
+        for (; i < n; ++i) out[i] = log(x[i]);
+    }
+
+    __attribute__((target("avx2,fma")))
+    static void logReturnsAvx2(const double* p, size_t n, double* out) {
+        size_t m = n > 0 ? n - 1 : 0;
+        size_t i = 0;
+        for (; i + 4 <= m; i += 4) {
+            store4(out + i, _mm256_div_pd(_mm256_loadu_pd(p + i + 1), _mm256_loadu_pd(p + i)));
+        }
+        for (; i < m; ++i) out[i] = log(p[i + 1] / p[i]);
+    }
+
+    __attribute__((target("avx512f")))
+    static inline __m512d log8(__m512d x) {
+        __m512i hx = _mm512_add_epi64(_mm512_castpd_si512(x), _mm512_set1_epi64(kReduceShift));
+        // Zero-masked shift: the plain form trips -Wmaybe-uninitialized inside GCC 12's header
+        __m512i ke = _mm512_or_si512(_mm512_maskz_srli_epi64(0xFF, hx, 52), _mm512_set1_epi64(kMagicBits));
+        __m512d dk = _mm512_sub_pd(_mm512_castsi512_pd(ke), _mm512_set1_pd(kMagicBias));
+        __m512i mb = _mm512_add_epi64(_mm512_and_si512(hx, _mm512_set1_epi64(kMantMask)),
+                                      _mm512_set1_epi64(kReduceBase));
+        __m512d f = _mm512_sub_pd(_mm512_castsi512_pd(mb), _mm512_set1_pd(1.0));
+
+        __m512d hfsq = _mm512_mul_pd(_mm512_mul_pd(_mm512_set1_pd(0.5), f), f);
+        __m512d s = _mm512_div_pd(f, _mm512_add_pd(_mm512_set1_pd(2.0), f));
+        __m512d z = _mm512_mul_pd(s, s);
+        __m512d w = _mm512_mul_pd(z, z);
+        __m512d t1 = _mm512_fmadd_pd(w, _mm512_set1_pd(kLg6), _mm512_set1_pd(kLg4));
+        t1 = _mm512_fmadd_pd(w, t1, _mm512_set1_pd(kLg2));
+        t1 = _mm512_mul_pd(w, t1);
+        __m512d t2 = _mm512_fmadd_pd(w, _mm512_set1_pd(kLg7), _mm512_set1_pd(kLg5));
+        t2 = _mm512_fmadd_pd(w, t2, _mm512_set1_pd(kLg3));
+        t2 = _mm512_fmadd_pd(w, t2, _mm512_set1_pd(kLg1));
+        t2 = _mm512_mul_pd(z, t2);
+        __m512d R = _mm512_add_pd(t2, t1);
+
+        __m512d r = _mm512_fmadd_pd(s, _mm512_add_pd(hfsq, R), _mm512_mul_pd(dk, _mm512_set1_pd(kLn2Lo)));
+        r = _mm512_sub_pd(r, hfsq);
+        r = _mm512_add_pd(r, f);
+        return _mm512_fmadd_pd(dk, _mm512_set1_pd(kLn2Hi), r);
+    }
+
+    __attribute__((target("avx512f")))
+    static inline void store8(double* out, __m512d v) {
+        __mmask8 ok = _mm512_cmp_pd_mask(v, _mm512_set1_pd(DBL_MIN), _CMP_GE_OQ) &
+                      _mm512_cmp_pd_mask(v, _mm512_set1_pd(numeric_limits<double>::infinity()), _CMP_LT_OQ);
+        _mm512_storeu_pd(out, log8(v));
+        if (ok != 0xFF) {
+            alignas(64) double in[8];
+            _mm512_store_pd(in, v);
+            for (int l = 0; l < 8; ++l) {
+                if (!(ok & (1 << l))) out[l] = log(in[l]);
+            }
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    static void logArrayAvx512(const double* x, size_t n, double* out) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) store8(out + i, _mm512_loadu_pd(x + i));
+        for (; i < n; ++i) out[i] = log(x[i]);
+    }
+
+    __attribute__((target("avx512f")))
+    static void logReturnsAvx512(const double* p, size_t n, double* out) {
+        size_t m = n > 0 ? n - 1 : 0;
+        size_t i = 0;
+        for (; i + 8 <= m; i += 8) {
+            store8(out + i, _mm512_div_pd(_mm512_loadu_pd(p + i + 1), _mm512_loadu_pd(p + i)));
+        }
+        for (; i < m; ++i) out[i] = log(p[i + 1] / p[i]);
+    }
+#endif
+
+    // --- Dispatch ---
+    const char* logKernelIsaName(LogKernelIsa isa) {
+        switch (isa) {
+            case LogKernelIsa::Avx2:   return "AVX2";
+            case LogKernelIsa::Avx512: return "AVX-512";
+            default:                   return "scalar";
+        }
+    }
+
+    bool logKernelSupported(LogKernelIsa isa) {
+#ifdef FRE_LOG_KERNEL_X86
+        switch (isa) {
+            case LogKernelIsa::Avx2:   return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+            case LogKernelIsa::Avx512: return __builtin_cpu_supports("avx512f");
+            default:                   return true;
+        }
+#else
+        return isa == LogKernelIsa::Scalar;
+#endif
+    }
+
+    LogKernelIsa activeLogKernel() {
+        static const LogKernelIsa isa =
+            logKernelSupported(LogKernelIsa::Avx512) ? LogKernelIsa::Avx512 :
+            logKernelSupported(LogKernelIsa::Avx2)   ? LogKernelIsa::Avx2 : LogKernelIsa::Scalar;
+        return isa;
+    }
+
+    void logArray(LogKernelIsa isa, const double* x, size_t n, double* out) {
+        if (!logKernelSupported(isa)) isa = LogKernelIsa::Scalar;
+        switch (isa) {
+#ifdef FRE_LOG_KERNEL_X86
+            case LogKernelIsa::Avx2:   logArrayAvx2(x, n, out); break;
+            case LogKernelIsa::Avx512: logArrayAvx512(x, n, out); break;
+#endif
+            default:                   logArrayScalar(x, n, out); break;
+        }
+    }
+
+    void logReturns(LogKernelIsa isa, const double* p, size_t n, double* out) {
+        if (!logKernelSupported(isa)) isa = LogKernelIsa::Scalar;
+        switch (isa) {
+#ifdef FRE_LOG_KERNEL_X86
+            case LogKernelIsa::Avx2:   logReturnsAvx2(p, n, out); break;
+            case LogKernelIsa::Avx512: logReturnsAvx512(p, n, out); break;
+#endif
+            default:                   logReturnsScalar(p, n, out); break;
+        }
+    }
+
+    void logArray(const double* x, size_t n, double* out) {
+        logArray(activeLogKernel(), x, n, out);
+    }
+
+    void logReturns(const double* p, size_t n, double* out) {
+        logReturns(activeLogKernel(), p, n, out);
+    }
+
+    // --- Accuracy check ---
+    static double ulpError(double got, double want) {
+        if (got == want) return 0.0;
+        double a = fabs(want);
+        double ulp = nextafter(a, numeric_limits<double>::infinity()) - a;
+        return fabs(got - want) / ulp;
+    }
+
+    static bool sameSpecial(double got, double want) {
+        if (std::isnan(want)) return std::isnan(got);
+        return got == want && signbit(got) == signbit(want);
+    }
+
+    vector<LogKernelAccuracy> checkLogKernel(size_t samples) {
+        samples = max<size_t>(samples, 16);
+        mt19937_64 rng(20240101);
+
+        // Half the samples: a daily price walk, checked through logReturns (the production path),
+        // with returns from a few percent down to the last digits of a flat price
+        const size_t nWalk = samples / 2;
+        vector<double> walk(nWalk + 1);
+        normal_distribution<double> daily(0.0, 0.02);
+        uniform_int_distribution<int> scale(0, 9);
+        walk[0] = 100.0;
+        for (size_t i = 1; i <= nWalk; ++i) {
+            double r = daily(rng) * pow(10.0, -scale(rng) / 2);
+            walk[i] = walk[i - 1] * exp(r);
+        }
+
+        // Other half: positive normal doubles of any exponent, checked through logArray
+        const size_t nWide = samples - nWalk;
+        vector<double> wide(nWide);
+        uniform_int_distribution<int> expo(-1020, 1020);
+        uniform_real_distribution<double> mant(1.0, 2.0);
+        for (size_t i = 0; i < nWide; ++i) wide[i] = ldexp(mant(rng), expo(rng));
+
+        const double special[] = {
+            1.0, 0.0, -0.0, -1.0, DBL_MIN, DBL_MIN / 2, DBL_TRUE_MIN, DBL_MAX,
+            numeric_limits<double>::infinity(), -numeric_limits<double>::infinity(),
+            numeric_limits<double>::quiet_NaN(), 0.5, 2.0, M_SQRT2, M_SQRT1_2
+        };
+        const size_t nSpecial = sizeof(special) / sizeof(special[0]);
+
+        vector<double> wantWalk(nWalk), wantWide(nWide), wantSpecial(nSpecial);
+        logReturnsScalar(walk.data(), walk.size(), wantWalk.data());
+        logArrayScalar(wide.data(), nWide, wantWide.data());
+        logArrayScalar(special, nSpecial, wantSpecial.data());
+
+        vector<LogKernelAccuracy> results;
+        const LogKernelIsa all[] = { LogKernelIsa::Scalar, LogKernelIsa::Avx2, LogKernelIsa::Avx512 };
+        for (LogKernelIsa isa : all) {
+            if (!logKernelSupported(isa)) continue;
+
+            LogKernelAccuracy acc;
+            acc.isa = isa;
+            vector<double> gotWalk(nWalk), gotWide(nWide), gotSpecial(nSpecial);
+
+            auto t0 = chrono::steady_clock::now();
+            logReturns(isa, walk.data(), walk.size(), gotWalk.data());
+            logArray(isa, wide.data(), nWide, gotWide.data());
+            auto t1 = chrono::steady_clock::now();
+            logArray(isa, special, nSpecial, gotSpecial.data());
+
+            double sum = 0.0;
+            for (size_t i = 0; i < nWalk; ++i) {
+                double e = ulpError(gotWalk[i], wantWalk[i]);
+                acc.maxUlp = max(acc.maxUlp, e);
+                sum += e;
+            }
+            for (size_t i = 0; i < nWide; ++i) {
+                double e = ulpError(gotWide[i], wantWide[i]);
+                acc.maxUlp = max(acc.maxUlp, e);
+                sum += e;
+            }
+            for (size_t i = 0; i < nSpecial; ++i) {
+                double want = wantSpecial[i];
+                if (std::isfinite(want) && special[i] >= DBL_MIN) {
+                    acc.maxUlp = max(acc.maxUlp, ulpError(gotSpecial[i], want));
+                } else if (!sameSpecial(gotSpecial[i], want)) {
+                    ++acc.specialMismatches;
+                }
+            }
+
+            acc.samples = nWalk + nWide + nSpecial;
+            acc.meanUlp = sum / static_cast<double>(nWalk + nWide);
+            acc.nsPerValue = chrono::duration<double, nano>(t1 - t0).count() / (nWalk + nWide);
+            acc.passed = acc.maxUlp <= kLogKernelMaxUlp && acc.specialMismatches == 0;
+            results.push_back(acc);
+        }
+        return results;
+    }
+
+    void printLogKernelCheck(const vector<LogKernelAccuracy>& results, ostream& os) {
+        os << "Log kernel check against std::log (active: " << logKernelIsaName(activeLogKernel()) << ")\n";
+        os << left << setw(10) << "ISA" << setw(10) << "Samples" << setw(12) << "Max ulp"
+           << setw(12) << "Mean ulp" << setw(10) << "Special" << setw(12) << "ns/value" << "Result\n";
+        for (const LogKernelAccuracy& r : results) {
+            os << left << setw(10) << logKernelIsaName(r.isa) << setw(10) << r.samples
+               << fixed << setprecision(3) << setw(12) << r.maxUlp << setw(12) << r.meanUlp
+               << setw(10) << r.specialMismatches << setprecision(2) << setw(12) << r.nsPerValue
+               << (r.passed ? "PASS" : "FAIL") << "\n";
+        }
+        os.unsetf(ios::fixed);
+        os << right;
+    }
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+namespace fre {
+
+    // Instruction set of the batch logarithm; the widest one the CPU supports is picked
+    // once at first use. Scalar is std::log and is always available.
+    enum class LogKernelIsa { Scalar, Avx2, Avx512 };
+
+    const char* logKernelIsaName(LogKernelIsa isa);
+    bool logKernelSupported(LogKernelIsa isa);
+    LogKernelIsa activeLogKernel();
+
+    // out[i] = log(x[i]) for i < n
+    void logArray(const double* x, std::size_t n, double* out);
+
+    // out[i] = log(p[i + 1] / p[i]) for i < n - 1: the log returns of a whole price series
+    // in one call. The ratio is taken first and its log second, as the scalar code did;
+    // a difference of two logs would cancel most digits of a small daily return.
+    void logReturns(const double* p, std::size_t n, double* out);
+
+    // Same with an explicit instruction set, used by the accuracy check
+    void logArray(LogKernelIsa isa, const double* x, std::size_t n, double* out);
+    void logReturns(LogKernelIsa isa, const double* p, std::size_t n, double* out);
+
+    // Accuracy of one instruction set against std::log over a fixed set of inputs
+    struct LogKernelAccuracy {
+        LogKernelIsa isa;
+        std::size_t samples = 0;
+        double maxUlp = 0.0;         // largest error in units in the last place of std::log
+        double meanUlp = 0.0;
+        std::size_t specialMismatches = 0;  // zero, negative, subnormal, inf or NaN inputs that differ
+        double nsPerValue = 0.0;
+        bool passed = false;         // maxUlp <= kLogKernelMaxUlp and no special mismatch
+    };
+
+    const double kLogKernelMaxUlp = 1.0;
+
+    // One entry per supported instruction set, Scalar first
+    std::vector<LogKernelAccuracy> checkLogKernel(std::size_t samples = 1000000);
+    void printLogKernelCheck(const std::vector<LogKernelAccuracy>& results, std::ostream& os);
+
+}
@@ -0,0 +1,64 @@
+#include "MappedFile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace fre {
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+    bool MappedFile::open(const string& path)
+    {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error_ = path + ": " + strerror(errno);
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            error_ = path + ": " + strerror(errno);
+            ::close(fd);
+            return false;
+        }
+
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                error_ = path + ": " + strerror(errno);
+                size_ = 0;
+                ::close(fd);
+                return false;
+            }
+            madvise(p, size_, MADV_WILLNEED);
+            data_ = static_cast<const char*>(p);
+        }
+
+        // The mapping keeps the file referenced; the descriptor is no longer needed
+        ::close(fd);
+        open_ = true;
+        error_.clear();
+        return true;
+    }
+
+    void MappedFile::close()
+    {
+        if (data_) munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+        open_ = false;
+    }
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace fre {
+
+    // Read-only memory map of a whole file. The view stays valid until close() or
+    // destruction; an empty file opens successfully with size() == 0.
+    class MappedFile {
+    public:
+        MappedFile() {}
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // False with error() set if the file cannot be opened or mapped
+        bool open(const std::string& path);
+        void close();
+
+        bool isOpen() const { return open_; }
+        const char* data() const { return data_; }
+        std::size_t size() const { return size_; }
+        const std::string& error() const { return error_; }
+
+    private:
+        const char* data_ = nullptr;
+        std::size_t size_ = 0;
+        bool open_ = false;
+        std::string error_;
+    };
+
+}
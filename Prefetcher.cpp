@@ -0,0 +1,135 @@
+#include "Prefetcher.h"
+#include "CurlUtils.h"
+#include "StockUtils.h"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+using namespace std;
+
+namespace fre {
+
+    void Prefetcher::start(vector<EventKey> events, const string& benchFrom, const string& benchTo,
+                           int minN, int maxN, int preEventDays, DownloadJournal& journal)
+    {
+        stop();
+        journal_ = &journal;
+        cancelled_.reset();
+        planned_ = fetched_ = cached_ = failed_ = 0;
+        calendarReady_ = false;
+
+        pool_ = make_unique<ThreadPool2>(threads_);
+        pool_->submit([this, events = std::move(events), benchFrom, benchTo, minN, maxN, preEventDays]() mutable {
+            plan(std::move(events), benchFrom, benchTo, minN, maxN, preEventDays);
+        });
+    }
+
+    void Prefetcher::stop()
+    {
+        if (!pool_) return;
+        cancelled_.cancel();
+        pool_->stop_now();
+        pool_.reset();
+    }
+
+    // --- 1. Calendar and per-ticker ranges, on the first pool thread ---
+    void Prefetcher::plan(vector<EventKey> events, const string& benchFrom, const string& benchTo,
+                          int minN, int maxN, int preEventDays)
+    {
+        unique_ptr<CURL, void (*)(CURL*)> curl(curl_easy_init(), curl_easy_cleanup);
+        if (!curl || cancelled_.cancelled()) return;
+
+        apiLimiter().acquire_permit();
+        string csv;
+        if (cancelled_.cancelled() || !FetchPriceCsv(curl.get(), "IWV", benchFrom, benchTo, csv, nullptr, &cancelled_)) return;
+        PriceHistory bench = ParsePriceCsv(csv);
+
+        map<string, double> benchMap;
+        for (size_t i = 0; i < bench.size(); ++i) benchMap[formatDay(bench.days[i])] = bench.prices[i];
+        vector<string> tradingDays = createTradingDaysList(benchMap);
+        if (tradingDays.empty()) return;
+        calendarReady_ = true;
+
+        // The events usable at minN include those usable at any larger N; running each
+        // range to day +maxN, capped at the calendar end, covers every N in between
+        vector<string> eventDates;
+        eventDates.reserve(events.size());
+        for (const EventKey& k : events) eventDates.push_back(k.second);
+        map<string, string> warnings;  // Option 1 reports these
+        vector<EventWindowPlan> windows = planEventWindows(tradingDays, eventDates, minN, preEventDays, warnings);
+
+        const int lastDay = static_cast<int>(tradingDays.size()) - 1;
+        size_t e = 0;
+        while (e < events.size() && !cancelled_.cancelled()) {
+            const string& ticker = events[e].first;
+            int lo = lastDay, hi = -1;
+            for (; e < events.size() && events[e].first == ticker; ++e) {
+                const EventWindowPlan& w = windows[e];
+                if (!w.ok()) continue;
+                lo = min(lo, w.historyFromIndex);
+                hi = max(hi, min(w.eventIndex + maxN, lastDay));
+            }
+            if (hi < 0) continue;
+
+            ++planned_;
+            try {
+                pool_->submit([this, ticker, from = tradingDays[lo], to = tradingDays[hi]]() {
+                    fetch(ticker, from, to);
+                });
+            } catch (const runtime_error&) {
+                return;  // stop_now() has closed the pool
+            }
+        }
+    }
+
+    // --- 2. One ticker: journal hit, or one rate-limited download appended to the journal ---
+    void Prefetcher::fetch(const string& ticker, const string& from, const string& to)
+    {
+        DayNumber fromDay = toDayNumber(from), toDay = toDayNumber(to);
+        if (journal_->find(ticker, fromDay, toDay)) {
+            ++cached_;
+            return;
+        }
+
+        thread_local unique_ptr<CURL, void (*)(CURL*)> curl(curl_easy_init(), curl_easy_cleanup);
+        if (!curl || cancelled_.cancelled()) return;
+
+        apiLimiter().acquire_permit();
+        if (cancelled_.cancelled()) return;
+
+        string csv;
+        auto history = make_shared<const PriceHistory>(
+            FetchPriceCsv(curl.get(), ticker, from, to, csv, nullptr, &cancelled_) ? ParsePriceCsv(csv) : PriceHistory());
+        if (cancelled_.cancelled()) return;  // aborted, not failed
+        if (history->empty()) {
+            ++failed_;
+            return;
+        }
+        journal_->append(ticker, fromDay, toDay, history);
+        ++fetched_;
+    }
+
+    PrefetchStats Prefetcher::stats() const
+    {
+        PrefetchStats s;
+        s.planned = planned_;
+        s.fetched = fetched_;
+        s.cached = cached_;
+        s.failed = failed_;
+        s.calendarReady = calendarReady_;
+        return s;
+    }
+
+    void Prefetcher::report(ostream& os) const
+    {
+        PrefetchStats s = stats();
+        if (!s.calendarReady) {
+            os << "stopped before the benchmark calendar was ready";
+            return;
+        }
+        os << s.fetched << " downloaded, " << s.cached << " already journaled, "
+           << s.failed << " failed, of " << s.planned << " tickers planned";
+    }
+
+}
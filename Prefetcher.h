@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "DownloadJournal.h"
+#include "StockStructure.h"
+#include "ThreadUtils.h"
+
+namespace fre {
+
+    struct PrefetchStats {
+        std::size_t planned = 0;   // tickers with at least one usable window
+        std::size_t fetched = 0;   // downloaded and journaled
+        std::size_t cached = 0;    // already in the journal
+        std::size_t failed = 0;
+        bool calendarReady = false;
+    };
+
+    // Speculative download, while the user is at the menu, of the price histories that
+    // Option 1 will ask for. Each ticker's range covers its windows for every N in
+    // [minN, maxN] plus the estimation days, so whatever N is entered the request is
+    // answered by DownloadJournal::find(). Downloads take permits from apiLimiter(), as
+    // Option 1's do, and are appended to the journal, which is the cache Option 1 reads.
+    class Prefetcher {
+    public:
+        explicit Prefetcher(std::size_t threads = 8) : threads_(threads) {}
+        ~Prefetcher() { stop(); }
+        Prefetcher(const Prefetcher&) = delete;
+        Prefetcher& operator=(const Prefetcher&) = delete;
+
+        // Returns at once. A pool task downloads the benchmark [benchFrom, benchTo] for the
+        // trading calendar, plans every ticker's range, then queues one download per ticker.
+        void start(std::vector<EventKey> events, const std::string& benchFrom, const std::string& benchTo,
+                   int minN, int maxN, int preEventDays, DownloadJournal& journal);
+
+        // Cancel through ThreadPool2::stop_now: queued tickers are dropped, and a download in
+        // flight is aborted (or woken from its retry backoff) within about a second.
+        // Does nothing if not started.
+        void stop();
+        bool started() const { return pool_ != nullptr; }
+
+        PrefetchStats stats() const;
+        void report(std::ostream& os) const;
+
+    private:
+        void plan(std::vector<EventKey> events, const std::string& benchFrom, const std::string& benchTo,
+                  int minN, int maxN, int preEventDays);
+        void fetch(const std::string& ticker, const std::string& from, const std::string& to);
+
+        std::size_t threads_;
+        std::unique_ptr<ThreadPool2> pool_;
+        DownloadJournal* journal_ = nullptr;
+        CancelFlag cancelled_;
+
+        std::atomic<std::size_t> planned_{0};
+        std::atomic<std::size_t> fetched_{0};
+        std::atomic<std::size_t> cached_{0};
+        std::atomic<std::size_t> failed_{0};
+        std::atomic<bool> calendarReady_{false};
+    };
+
+}
@@ -0,0 +1,171 @@
+#include "PriceArchive.h"
+#include "CurlUtils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+namespace fre {
+
+    namespace {
+        const size_t kTarBlock = 512;
+
+        // "dir/aapl.us.csv" -> "AAPL"; "" unless the name ends in ".csv"
+        string tickerOf(const string& name) {
+            size_t slash = name.find_last_of('/');
+            string stem = slash == string::npos ? name : name.substr(slash + 1);
+            for (char& c : stem) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+
+            if (stem.size() <= 4 || stem.compare(stem.size() - 4, 4, ".CSV") != 0) return "";
+            stem.resize(stem.size() - 4);
+            if (stem.size() > 3 && stem.compare(stem.size() - 3, 3, ".US") == 0) stem.resize(stem.size() - 3);
+            return stem;
+        }
+
+        // NUL- or space-terminated octal number of a tar header field
+        size_t octal(const char* p, size_t len) {
+            size_t v = 0;
+            for (size_t i = 0; i < len && p[i] >= '0' && p[i] <= '7'; ++i) v = v * 8 + (p[i] - '0');
+            return v;
+        }
+
+        string field(const char* p, size_t len) {
+            return string(p, strnlen(p, len));
+        }
+    }
+
+    bool PriceArchive::open(const string& path, string& error)
+    {
+        index_.clear();
+        tar_.close();
+        path_ = path;
+
+        error_code ec;
+        bool ok = filesystem::is_directory(path, ec) ? indexDirectory(path, error) : indexTar(path, error);
+        if (ok && index_.empty()) {
+            error = path + ": no per-ticker CSV files found";
+            ok = false;
+        }
+        if (!ok) {
+            index_.clear();
+            tar_.close();
+        }
+        return ok;
+    }
+
+    void PriceArchive::add(const string& name, Entry entry)
+    {
+        string ticker = tickerOf(name);
+        if (!ticker.empty()) index_[ticker] = std::move(entry);
+    }
+
+    bool PriceArchive::indexDirectory(const string& path, string& error)
+    {
+        isTar_ = false;
+        error_code ec;
+        for (filesystem::recursive_directory_iterator it(path, ec), end; !ec && it != end; it.increment(ec)) {
+            if (!it->is_regular_file(ec)) continue;
+            Entry entry;
+            entry.file = it->path().string();
+            add(it->path().filename().string(), std::move(entry));
+        }
+        if (ec) {
+            error = path + ": " + ec.message();
+            return false;
+        }
+        return true;
+    }
+
+    // POSIX ustar, with GNU long names; other entry types are skipped
+    bool PriceArchive::indexTar(const string& path, string& error)
+    {
+        isTar_ = true;
+        if (!tar_.open(path)) {
+            error = tar_.error();
+            return false;
+        }
+
+        const char* base = tar_.data();
+        const size_t size = tar_.size();
+        size_t pos = 0;
+        string longName;
+        while (size - pos >= kTarBlock) {
+            const char* h = base + pos;
+            if (h[0] == '\0') break;  // end-of-archive block
+
+            size_t bytes = octal(h + 124, 12);
+            size_t data = pos + kTarBlock;
+            if (bytes > size - data) {
+                error = path + ": truncated tar entry at offset " + to_string(pos);
+                return false;
+            }
+
+            char type = h[156];
+            if (type == 'L') {
+                longName = field(base + data, bytes);
+            } else if (type == '0' || type == '\0') {
+                string name = longName;
+                if (name.empty()) {
+                    name = field(h, 100);
+                    if (memcmp(h + 257, "ustar", 5) == 0 && h[345] != '\0') name = field(h + 345, 155) + "/" + name;
+                }
+                Entry entry;
+                entry.offset = data;
+                entry.size = bytes;
+                add(name, std::move(entry));
+                longName.clear();
+            } else {
+                longName.clear();
+            }
+            pos = data + (bytes + kTarBlock - 1) / kTarBlock * kTarBlock;
+        }
+        return true;
+    }
+
+    bool PriceArchive::read(const string& ticker, string& csvText) const
+    {
+        csvText.clear();
+        string key = ticker;
+        for (char& c : key) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+        auto it = index_.find(key);
+        if (it == index_.end()) return false;
+
+        const Entry& entry = it->second;
+        if (isTar_) {
+            csvText.assign(tar_.data() + entry.offset, entry.size);
+        } else {
+            ifstream fin(entry.file, ios::binary);
+            if (!fin.is_open()) return false;
+            ostringstream ss;
+            ss << fin.rdbuf();
+            csvText = ss.str();
+        }
+        return !csvText.empty();
+    }
+
+    PriceHistory PriceArchive::load(const string& ticker, DayNumber from, DayNumber to) const
+    {
+        string csvText;
+        if (!read(ticker, csvText)) return PriceHistory();
+        return clipHistory(ParsePriceCsv(csvText), from, to);
+    }
+
+    PriceHistory clipHistory(const PriceHistory& history, DayNumber from, DayNumber to)
+    {
+        auto lo = lower_bound(history.days.begin(), history.days.end(), from);
+        auto hi = upper_bound(lo, history.days.end(), to);
+        size_t first = static_cast<size_t>(lo - history.days.begin());
+        size_t last = static_cast<size_t>(hi - history.days.begin());
+
+        PriceHistory clipped;
+        clipped.days.assign(lo, hi);
+        clipped.prices.assign(history.prices.begin() + first, history.prices.begin() + last);
+        return clipped;
+    }
+
+}
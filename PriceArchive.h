@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+
+#include "MappedFile.h"
+#include "StockStructure.h"
+
+namespace fre {
+
+    // Local archive of per-ticker EOD CSV files in the provider's format
+    // (Date,Open,High,Low,Close,Adjusted_close,Volume), used in place of the network.
+    //
+    // The archive is a directory, searched recursively, or an uncompressed tar file read
+    // in place through a memory map. A file named TICKER.csv or TICKER.US.csv holds that
+    // ticker's history; the name is matched without case.
+    class PriceArchive {
+    public:
+        // Index the archive; false with error set if it cannot be read or holds no CSV file
+        bool open(const std::string& path, std::string& error);
+        bool isOpen() const { return !index_.empty(); }
+        const std::string& path() const { return path_; }
+        std::size_t size() const { return index_.size(); }  // tickers
+
+        // Raw CSV text of a ticker; false if it is not in the archive or cannot be read.
+        // Safe to call from several threads.
+        bool read(const std::string& ticker, std::string& csvText) const;
+
+        // read() and ParsePriceCsv(), limited to [from, to] as a download of that range would be
+        PriceHistory load(const std::string& ticker, DayNumber from, DayNumber to) const;
+
+    private:
+        struct Entry {
+            std::string file;         // directory archive: file path
+            std::size_t offset = 0;   // tar archive: contents in the mapped file
+            std::size_t size = 0;
+        };
+
+        bool indexDirectory(const std::string& path, std::string& error);
+        bool indexTar(const std::string& path, std::string& error);
+        void add(const std::string& name, Entry entry);
+
+        std::string path_;
+        MappedFile tar_;
+        bool isTar_ = false;
+        std::unordered_map<std::string, Entry> index_;  // upper-case ticker -> file
+    };
+
+    // The rows of history with from <= day <= to
+    PriceHistory clipHistory(const PriceHistory& history, DayNumber from, DayNumber to);
+
+}
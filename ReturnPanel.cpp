@@ -0,0 +1,263 @@
+#include "ReturnPanel.h"
+#include "LogKernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace fre {
+
+    using namespace std;
+
+    // Column order of the groups inside the panel
+    static int groupRank(EventGroup g)
+    {
+        switch (g) {
+            case EventGroup::Miss: return 0;
+            case EventGroup::Meet: return 1;
+            case EventGroup::Beat: return 2;
+            default:               return 3;
+        }
+    }
+
+    ReturnPanel buildReturnPanel(const StockRegistry& stocks,
+                                 const map<string, double>& benchmarkPrices,
+                                 int N,
+                                 const EstimationWindow& est,
+                                 pmr::memory_resource* mr)
+    {
+        ReturnPanel panel(mr);
+        panel.dayLo = min(est.start, -N + 1);
+        panel.dayHi = N;
+
+        // Trading calendar and benchmark log return per calendar index (index 0 has none)
+        vector<DayNumber> calendar;
+        Vector benchPrice;
+        calendar.reserve(benchmarkPrices.size());
+        benchPrice.reserve(benchmarkPrices.size());
+        for (const auto& kv : benchmarkPrices) {
+            calendar.push_back(toDayNumber(kv.first));
+            benchPrice.push_back(kv.second);
+        }
+        if (calendar.size() < 2) {
+            cerr << "[ReturnPanel] Warning: benchmark calendar too short, empty panel.\n";
+            return panel;
+        }
+
+        Vector benchRet(calendar.size(), 0.0);
+        logReturns(benchPrice.data(), benchPrice.size(), benchRet.data() + 1);
+
+        // Columns: every event that holds a full event window
+        // Each column holds its own reference to the history, taken under the event's
+        // registry lock, so a later update of the event cannot pull it away
+        struct Column {
+            EventId id;
+            int rank;  // groupRank of the event's group
+            shared_ptr<const PriceHistory> history;
+            long h0;   // history index of day 0
+            long c0;   // calendar index of day 0
+        };
+        vector<Column> cols;
+        cols.reserve(stocks.size());
+
+        for (EventId id = 0; id < stocks.size(); ++id) {
+            Column col{ id, 3, nullptr, 0, 0 };
+            bool usable = stocks.read(id, [&](const Stock& s) {
+                PriceView px = s.getPrices();
+                if (!s.getHistory() || static_cast<int>(px.size()) != 2 * N + 1) return false;
+                if (static_cast<int>(s.getAbnormReturns().size()) != 2 * N) return false;
+                col.rank = groupRank(s.getGroup());
+                col.history = s.getHistory();
+                col.h0 = static_cast<long>(px.days() - col.history->days.data()) + N;
+                return true;
+            });
+            if (!usable) continue;
+
+            DayNumber day0 = col.history->days[col.h0];
+            auto itCal = lower_bound(calendar.begin(), calendar.end(), day0);
+            if (itCal == calendar.end() || *itCal != day0) continue;
+
+            col.c0 = static_cast<long>(itCal - calendar.begin());
+            cols.push_back(std::move(col));
+        }
+
+        stable_sort(cols.begin(), cols.end(), [](const Column& a, const Column& b) {
+            return a.rank < b.rank;
+        });
+
+        const size_t E = cols.size();
+        panel.numEvents = E;
+        panel.groupBegin.assign(5, E);
+        for (size_t e = E; e-- > 0; ) {
+            panel.groupBegin[cols[e].rank] = e;
+        }
+        for (int g = 3; g >= 0; --g) {
+            panel.groupBegin[g] = min(panel.groupBegin[g], panel.groupBegin[g + 1]);
+        }
+        panel.keys.resize(E);
+        panel.hasEstimation.assign(E, 0);
+
+        const size_t cells = static_cast<size_t>(panel.numDays()) * E;
+        panel.stockRet.assign(cells, 0.0);
+        panel.marketRet.assign(cells, 0.0);
+        panel.abnormalRet.assign(cells, 0.0);
+
+        Vector colRet;
+        for (size_t e = 0; e < E; ++e) {
+            const Column& col = cols[e];
+            const PriceHistory& H = *col.history;
+            panel.keys[e] = stocks.key(col.id);
+
+            // The estimation window is usable when the history reaches back to the
+            // day before est.start on exactly the same trading day as the calendar
+            long hFirst = col.h0 + panel.dayLo - 1;
+            long cFirst = col.c0 + panel.dayLo - 1;
+            bool full = hFirst >= 0 && cFirst >= 0 &&
+                        H.days[hFirst] == calendar[cFirst];
+            panel.hasEstimation[e] = full ? 1 : 0;
+
+            // The column's returns in one kernel call, then scattered into the day-major rows
+            int dFrom = full ? panel.dayLo : -N + 1;
+            size_t numRet = static_cast<size_t>(panel.dayHi - dFrom + 1);
+            colRet.resize(numRet);
+            logReturns(H.prices.data() + col.h0 + dFrom - 1, numRet + 1, colRet.data());
+            for (int d = dFrom; d <= panel.dayHi; ++d) {
+                size_t i = panel.index(d, e);
+                panel.stockRet[i]  = colRet[d - dFrom];
+                panel.marketRet[i] = benchRet[col.c0 + d];
+            }
+        }
+
+        return panel;
+    }
+
+    MarketModelFit fitAbnormalReturnModel(ReturnPanel& panel,
+                                          const EstimationWindow& est,
+                                          AbnormalReturnModel model)
+    {
+        const size_t E = panel.numEvents;
+        const double nan = numeric_limits<double>::quiet_NaN();
+        const double L = static_cast<double>(est.length());
+
+        MarketModelFit fit;
+        fit.window = est;
+        fit.alpha.assign(E, 0.0);
+        fit.beta.assign(E, 1.0);
+        fit.residVar.assign(E, nan);
+        fit.marketMean.assign(E, nan);
+        fit.marketSxx.assign(E, nan);
+        fit.obs.assign(E, 0);
+
+        if (E == 0 || est.length() < 3) return fit;
+
+        // --- Pass 1: moment sums over the estimation window, one row of events at a time ---
+        pmr::memory_resource* mr = panel.resource();
+        PanelVector sx(E, 0.0, mr), sy(E, 0.0, mr), sxx(E, 0.0, mr), sxy(E, 0.0, mr);
+        for (int d = est.start; d <= est.end; ++d) {
+            const double* x = &panel.marketRet[panel.index(d, 0)];
+            const double* y = &panel.stockRet[panel.index(d, 0)];
+            double* pSx  = sx.data();
+            double* pSy  = sy.data();
+            double* pSxx = sxx.data();
+            double* pSxy = sxy.data();
+            for (size_t e = 0; e < E; ++e) {
+                pSx[e]  += x[e];
+                pSy[e]  += y[e];
+                pSxx[e] += x[e] * x[e];
+                pSxy[e] += x[e] * y[e];
+            }
+        }
+
+        // --- Closed-form OLS per event ---
+        for (size_t e = 0; e < E; ++e) {
+            if (!panel.hasEstimation[e]) {
+                if (model == AbnormalReturnModel::MarketModel) {
+                    fit.alpha[e] = nan;
+                    fit.beta[e]  = nan;
+                }
+                continue;
+            }
+
+            double mx  = sx[e] / L;
+            double Sxx = sxx[e] - sx[e] * mx;
+            fit.marketMean[e] = mx;
+            fit.marketSxx[e]  = Sxx;
+
+            if (model == AbnormalReturnModel::MarketModel) {
+                if (Sxx <= 0.0) {
+                    fit.alpha[e] = nan;
+                    fit.beta[e]  = nan;
+                    continue;
+                }
+                double Sxy = sxy[e] - sx[e] * sy[e] / L;
+                fit.beta[e]  = Sxy / Sxx;
+                fit.alpha[e] = sy[e] / L - fit.beta[e] * mx;
+            }
+            fit.obs[e] = est.length();
+        }
+
+        // --- Pass 2: residual variance over the estimation window ---
+        PanelVector sr(E, 0.0, mr), srr(E, 0.0, mr);
+        const double* a = fit.alpha.data();
+        const double* b = fit.beta.data();
+        for (int d = est.start; d <= est.end; ++d) {
+            const double* x = &panel.marketRet[panel.index(d, 0)];
+            const double* y = &panel.stockRet[panel.index(d, 0)];
+            double* pSr  = sr.data();
+            double* pSrr = srr.data();
+            for (size_t e = 0; e < E; ++e) {
+                double r = y[e] - a[e] - b[e] * x[e];
+                pSr[e]  += r;
+                pSrr[e] += r * r;
+            }
+        }
+
+        for (size_t e = 0; e < E; ++e) {
+            if (fit.obs[e] == 0) continue;
+            if (model == AbnormalReturnModel::MarketModel) {
+                fit.residVar[e] = srr[e] / (L - 2.0);  // OLS residuals have zero mean
+            } else {
+                fit.residVar[e] = (srr[e] - sr[e] * sr[e] / L) / (L - 1.0);
+            }
+        }
+
+        // --- Abnormal returns on every day held by the panel ---
+        for (int d = panel.dayLo; d <= panel.dayHi; ++d) {
+            const double* x = &panel.marketRet[panel.index(d, 0)];
+            const double* y = &panel.stockRet[panel.index(d, 0)];
+            double* ar = &panel.abnormalRet[panel.index(d, 0)];
+            for (size_t e = 0; e < E; ++e) {
+                ar[e] = y[e] - a[e] - b[e] * x[e];
+            }
+        }
+
+        return fit;
+    }
+
+    int applyAbnormalReturns(const ReturnPanel& panel,
+                             const MarketModelFit& fit,
+                             int N,
+                             StockRegistry& stocks)
+    {
+        int updated = 0;
+        for (size_t e = 0; e < panel.numEvents; ++e) {
+            EventId id = stocks.find(panel.keys[e]);
+            if (id == kNoEvent) continue;
+
+            if (!isfinite(fit.alpha[e]) || !isfinite(fit.beta[e])) {
+                stocks.update(id, [](Stock& s) { s.setAbnormReturns(Vector()); });
+                continue;
+            }
+
+            Vector ab(2 * N);
+            for (int d = -N + 1; d <= N; ++d) {
+                ab[d + N - 1] = panel.abnormalRet[panel.index(d, e)];
+            }
+            stocks.update(id, [&](Stock& s) { s.setAbnormReturns(ab); });
+            ++updated;
+        }
+        return updated;
+    }
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "MatrixOperator.h"
+#include "StockRegistry.h"
+#include "StockStructure.h"
+
+namespace fre {
+
+    // Abnormal return model used by Option 1
+    enum class AbnormalReturnModel {
+        MarketAdjusted,  // AR = R - Rm (beta fixed at 1)
+        MarketModel      // AR = R - (alpha + beta * Rm), fitted per event
+    };
+
+    // Estimation window in event days, inclusive, e.g. [-250, -30]
+    struct EstimationWindow {
+        int start = -250;
+        int end   = -30;
+        int length() const { return end - start + 1; }
+    };
+
+    // Event-aligned daily returns of many events in one contiguous block.
+    // Storage is day-major: value(day, e) = data[(day - dayLo) * numEvents + e],
+    // so a single event day across all events is contiguous and the batched
+    // kernels below vectorize over events.
+    // The three return arrays, and the scratch arrays of the code that reads them,
+    // come from the panel's memory resource (Option 1 passes its run arena).
+    typedef std::pmr::vector<double> PanelVector;
+
+    struct ReturnPanel {
+        explicit ReturnPanel(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+            : stockRet(mr), marketRet(mr), abnormalRet(mr) {}
+
+        std::pmr::memory_resource* resource() const { return stockRet.get_allocator().resource(); }
+
+        int dayLo = 0;             // first event day held (estimation window start)
+        int dayHi = 0;             // last event day held (N)
+        size_t numEvents = 0;
+
+        std::vector<EventKey> keys;               // column -> event
+        std::vector<size_t> groupBegin;           // Miss, Meet, Beat, rest: group g is [groupBegin[g], groupBegin[g + 1])
+        std::vector<unsigned char> hasEstimation; // 1 if the full estimation window is present
+        PanelVector stockRet;     // R_it
+        PanelVector marketRet;    // R_mt on the same trading days
+        PanelVector abnormalRet;  // AR_it under the model the panel was last fitted with
+
+        int numDays() const { return dayHi - dayLo + 1; }
+        size_t index(int day, size_t e) const {
+            return static_cast<size_t>(day - dayLo) * numEvents + e;
+        }
+    };
+
+    // Per-event fit of R_it = alpha_i + beta_i * R_mt + e_it over the estimation window
+    struct MarketModelFit {
+        EstimationWindow window;
+        Vector alpha;
+        Vector beta;
+        Vector residVar;    // s_i^2 = SSE / (L - 2); for market-adjusted runs, var(AR) / (L - 1)
+        Vector marketMean;  // mean R_mt over the estimation window
+        Vector marketSxx;   // sum of squared deviations of R_mt, for forecast-error corrections
+        std::vector<int> obs;  // L_i, 0 when the event could not be fitted
+    };
+
+    // Build the panel for every event that holds a valid event window.
+    // Columns are ordered Miss, Meet, Beat (then ungrouped events) so each group
+    // occupies one contiguous column range.
+    // Returns for days [est.start, N] are read from each event's shared price history;
+    // events whose history does not reach back over the estimation window keep
+    // hasEstimation = 0 and only their event-window rows are filled.
+    ReturnPanel buildReturnPanel(const StockRegistry& stocks,
+                                 const std::map<std::string, double>& benchmarkPrices,
+                                 int N,
+                                 const EstimationWindow& est,
+                                 std::pmr::memory_resource* mr = std::pmr::get_default_resource());
+
+    // Fit all events at once over the estimation window and fill panel.abnormalRet.
+    // MarketAdjusted keeps alpha = 0, beta = 1 and only estimates the residual variance.
+    MarketModelFit fitAbnormalReturnModel(ReturnPanel& panel,
+                                          const EstimationWindow& est,
+                                          AbnormalReturnModel model);
+
+    // Copy event-window abnormal returns (days -N+1 .. N) from the panel into the stocks.
+    // Events without a usable fit lose their abnormal returns so the bootstrap skips them.
+    // Returns the number of events updated.
+    int applyAbnormalReturns(const ReturnPanel& panel,
+                             const MarketModelFit& fit,
+                             int N,
+                             StockRegistry& stocks);
+
+}
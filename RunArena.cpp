@@ -0,0 +1,124 @@
+#include "RunArena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <new>
+
+using namespace std;
+
+namespace fre {
+
+    RunArena::RunArena(size_t firstBlockBytes)
+        : firstBlockBytes_(max<size_t>(firstBlockBytes, 4096)) {}
+
+    RunArena::~RunArena()
+    {
+        for (const Block& b : blocks_) ::operator delete(b.data, align_val_t(alignof(max_align_t)));
+    }
+
+    RunArena::Block RunArena::newBlock(size_t bytes)
+    {
+        Block b;
+        b.data = static_cast<byte*>(::operator new(bytes, align_val_t(alignof(max_align_t))));
+        b.size = bytes;
+        stats_.bytesReserved += bytes;
+        ++stats_.blocks;
+        return b;
+    }
+
+    void* RunArena::do_allocate(size_t bytes, size_t alignment)
+    {
+        lock_guard<mutex> lock(mutex_);
+        if (bytes == 0) bytes = 1;
+
+        // Try the current block, then any retained block after it, then grow
+        while (true) {
+            if (current_ < blocks_.size()) {
+                Block& b = blocks_[current_];
+                uintptr_t base = reinterpret_cast<uintptr_t>(b.data);
+                size_t start = ((base + offset_ + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+                if (start + bytes <= b.size) {
+                    stats_.bytesUsed += start + bytes - offset_;
+                    offset_ = start + bytes;
+                    ++stats_.allocations;
+                    stats_.peakBytesUsed = max(stats_.peakBytesUsed, stats_.bytesUsed);
+                    return b.data + start;
+                }
+                if (current_ + 1 < blocks_.size()) {
+                    stats_.bytesUsed += b.size - offset_;  // tail of the block is lost for this run
+                    ++current_;
+                    offset_ = 0;
+                    continue;
+                }
+            }
+
+            // Geometric growth, and never smaller than the request plus alignment slack
+            size_t last = blocks_.empty() ? firstBlockBytes_ / 2 : blocks_.back().size;
+            size_t size = max(last * 2, bytes + alignment);
+            if (!blocks_.empty()) stats_.bytesUsed += blocks_[current_].size - offset_;
+            blocks_.push_back(newBlock(size));
+            current_ = blocks_.size() - 1;
+            offset_ = 0;
+        }
+    }
+
+    void RunArena::do_deallocate(void*, size_t, size_t)
+    {
+        lock_guard<mutex> lock(mutex_);
+        ++stats_.deallocations;
+    }
+
+    bool RunArena::do_is_equal(const pmr::memory_resource& other) const noexcept
+    {
+        return this == &other;
+    }
+
+    void RunArena::reset()
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        // A run that spilled into several blocks gets one block of their combined size
+        if (blocks_.size() > 1) {
+            size_t total = 0;
+            for (const Block& b : blocks_) {
+                total += b.size;
+                ::operator delete(b.data, align_val_t(alignof(max_align_t)));
+            }
+            blocks_.clear();
+            stats_.bytesReserved = 0;
+            stats_.blocks = 0;
+            blocks_.push_back(newBlock(total));
+        }
+
+        current_ = 0;
+        offset_ = 0;
+        stats_.allocations = 0;
+        stats_.deallocations = 0;
+        stats_.bytesUsed = 0;
+        ++stats_.resets;
+    }
+
+    ArenaStats RunArena::stats() const
+    {
+        lock_guard<mutex> lock(mutex_);
+        return stats_;
+    }
+
+    void RunArena::report(ostream& os) const
+    {
+        ArenaStats s = stats();
+        const double MB = 1024.0 * 1024.0;
+        os << fixed << setprecision(1)
+           << s.bytesUsed / MB << " MB in " << s.allocations << " allocations ("
+           << s.blocks << " block(s), " << s.bytesReserved / MB << " MB reserved, peak "
+           << s.peakBytesUsed / MB << " MB, " << s.resets << " reset(s))";
+    }
+
+    RunArena& runArena()
+    {
+        static RunArena arena;
+        return arena;
+    }
+
+}
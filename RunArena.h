@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace fre {
+
+    // Counters of one arena, cumulative except where noted
+    struct ArenaStats {
+        std::size_t allocations = 0;     // this run
+        std::size_t deallocations = 0;   // this run; no-ops, memory returns on reset()
+        std::size_t bytesUsed = 0;       // this run, including alignment padding
+        std::size_t peakBytesUsed = 0;   // largest bytesUsed of any run so far
+        std::size_t bytesReserved = 0;   // total size of the retained blocks
+        std::size_t blocks = 0;
+        std::size_t resets = 0;
+    };
+
+    // Monotonic arena for the numerical data of one Option 1 run.
+    // Allocation bumps a pointer inside a retained block; deallocation does nothing.
+    // reset() rewinds to the first block without returning memory to the system, and
+    // folds the blocks of a run that overflowed into one block sized for that run,
+    // so repeated runs of similar size allocate nothing new and leave no fragments.
+    // Allocations take a mutex: callers allocate whole arrays, not elements.
+    class RunArena : public std::pmr::memory_resource {
+    public:
+        explicit RunArena(std::size_t firstBlockBytes = std::size_t(1) << 20);
+        ~RunArena() override;
+        RunArena(const RunArena&) = delete;
+        RunArena& operator=(const RunArena&) = delete;
+
+        // Every object allocated from the arena must be gone before this is called
+        void reset();
+
+        ArenaStats stats() const;
+        void report(std::ostream& os) const;
+
+    private:
+        struct Block {
+            std::byte* data;
+            std::size_t size;
+        };
+
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+        Block newBlock(std::size_t bytes);
+
+        mutable std::mutex mutex_;
+        std::vector<Block> blocks_;
+        std::size_t current_ = 0;  // block being filled
+        std::size_t offset_ = 0;   // first free byte in that block
+        std::size_t firstBlockBytes_;
+        ArenaStats stats_;
+    };
+
+    // Process-wide arena owned by the Option 1 run that is currently held in memory
+    RunArena& runArena();
+
+}
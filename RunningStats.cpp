@@ -0,0 +1,166 @@
+#include "RunningStats.h"
+
+#include <cmath>
+#include <utility>
+
+using namespace std;
+
+namespace fre {
+
+    namespace {
+        GroupAccumulator::Fixed toFixed(double x) {
+            return static_cast<GroupAccumulator::Fixed>(llroundl(static_cast<long double>(x) * GroupAccumulator::kScale));
+        }
+
+        // Mean and sample variance of n values from their fixed-point sum and sum of squares
+        void moments(GroupAccumulator::Fixed sum, GroupAccumulator::Fixed sum2, int64_t n,
+                     double& mean, double& variance) {
+            long double s = static_cast<long double>(sum) / GroupAccumulator::kScale;
+            long double s2 = static_cast<long double>(sum2) / GroupAccumulator::kScale;
+            long double m = s / n;
+            mean = static_cast<double>(m);
+            variance = n > 1 ? static_cast<double>(max<long double>(0.0L, (s2 - s * m) / (n - 1))) : 0.0;
+        }
+    }
+
+    GroupAccumulator::GroupAccumulator(int days)
+        : days_(days), n_(0), ar_(days, 0), ar2_(days, 0), car_(days, 0), car2_(days, 0) {}
+
+    void GroupAccumulator::apply(const Vector& abnormReturns, int sign)
+    {
+        if (static_cast<int>(abnormReturns.size()) != days_ || days_ == 0) return;
+        double car = 0.0;
+        for (int t = 0; t < days_; ++t) {
+            double ar = abnormReturns[t];
+            car += ar;
+            ar_[t] += sign * toFixed(ar);
+            ar2_[t] += sign * toFixed(ar * ar);
+            car_[t] += sign * toFixed(car);
+            car2_[t] += sign * toFixed(car * car);
+        }
+        n_ += sign;
+    }
+
+    void GroupAccumulator::add(const Vector& abnormReturns)
+    {
+        apply(abnormReturns, 1);
+    }
+
+    void GroupAccumulator::remove(const Vector& abnormReturns)
+    {
+        apply(abnormReturns, -1);
+    }
+
+    void GroupAccumulator::merge(const GroupAccumulator& other)
+    {
+        if (other.days_ != days_) return;
+        for (int t = 0; t < days_; ++t) {
+            ar_[t] += other.ar_[t];
+            ar2_[t] += other.ar2_[t];
+            car_[t] += other.car_[t];
+            car2_[t] += other.car2_[t];
+        }
+        n_ += other.n_;
+    }
+
+    void GroupAccumulator::assign(int64_t n, vector<Fixed> ar, vector<Fixed> ar2,
+                                  vector<Fixed> car, vector<Fixed> car2)
+    {
+        days_ = static_cast<int>(ar.size());
+        n_ = n;
+        ar_ = std::move(ar);
+        ar2_ = std::move(ar2);
+        car_ = std::move(car);
+        car2_ = std::move(car2);
+    }
+
+    GroupStats GroupAccumulator::estimate(int sampleSize) const
+    {
+        // A group with no events yet reads as flat zero series of the full length
+        GroupStats stats;
+        stats.AAR_mean.assign(days_, 0.0);
+        stats.AAR_std.assign(days_, 0.0);
+        stats.CAAR_mean.assign(days_, 0.0);
+        stats.CAAR_std.assign(days_, 0.0);
+        if (n_ == 0) return stats;
+
+        const double scale = 1.0 / sqrt(static_cast<double>(max(sampleSize, 1)));
+        for (int t = 0; t < days_; ++t) {
+            double var = 0.0;
+            moments(ar_[t], ar2_[t], n_, stats.AAR_mean[t], var);
+            stats.AAR_std[t] = sqrt(var) * scale;
+            moments(car_[t], car2_[t], n_, stats.CAAR_mean[t], var);
+            stats.CAAR_std[t] = sqrt(var) * scale;
+        }
+        return stats;
+    }
+
+    double GroupAccumulator::finalCAARStdErr() const
+    {
+        if (n_ < 2 || days_ == 0) return 0.0;
+        double mean = 0.0, var = 0.0;
+        moments(car_[days_ - 1], car2_[days_ - 1], n_, mean, var);
+        return sqrt(var / static_cast<double>(n_));
+    }
+
+    void LiveGroupStats::reset(int N, size_t totalEvents)
+    {
+        lock_guard<mutex> lock(mutex_);
+        state_ = LiveGroupSnapshot();
+        state_.N = N;
+        state_.total = totalEvents;
+        state_.miss = state_.meet = state_.beat = GroupAccumulator(2 * N);
+    }
+
+    GroupAccumulator* LiveGroupStats::groupOf(EventGroup group)
+    {
+        if (group == EventGroup::Miss) return &state_.miss;
+        if (group == EventGroup::Meet) return &state_.meet;
+        if (group == EventGroup::Beat) return &state_.beat;
+        return nullptr;
+    }
+
+    void LiveGroupStats::commit(EventGroup group, const Vector& abnormReturns)
+    {
+        lock_guard<mutex> lock(mutex_);
+        ++state_.completed;
+        if (GroupAccumulator* acc = groupOf(group)) acc->add(abnormReturns);
+    }
+
+    void LiveGroupStats::rebuild(const StockRegistry& registry, int N)
+    {
+        // Summed outside the lock, so a reader never sees a half-built state
+        LiveGroupSnapshot state;
+        state.N = N;
+        state.completed = state.total = registry.size();
+        state.miss = state.meet = state.beat = GroupAccumulator(2 * N);
+        for (EventId id = 0; id < registry.size(); ++id) {
+            registry.read(id, [&](const Stock& s) {
+                EventGroup g = s.getGroup();
+                if (g == EventGroup::Miss) state.miss.add(s.getAbnormReturns());
+                else if (g == EventGroup::Meet) state.meet.add(s.getAbnormReturns());
+                else if (g == EventGroup::Beat) state.beat.add(s.getAbnormReturns());
+            });
+        }
+
+        lock_guard<mutex> lock(mutex_);
+        state_ = std::move(state);
+    }
+
+    void LiveGroupStats::update(const vector<GroupChange>& changes, size_t totalEvents)
+    {
+        lock_guard<mutex> lock(mutex_);
+        for (const GroupChange& c : changes) {
+            if (GroupAccumulator* from = groupOf(c.fromGroup)) from->remove(c.fromReturns);
+            if (GroupAccumulator* to = groupOf(c.toGroup)) to->add(c.toReturns);
+        }
+        state_.completed = state_.total = totalEvents;
+    }
+
+    LiveGroupSnapshot LiveGroupStats::snapshot() const
+    {
+        lock_guard<mutex> lock(mutex_);
+        return state_;
+    }
+
+}
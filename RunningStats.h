@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "MatrixOperator.h"
+#include "StatCalculator.h"
+#include "StockRegistry.h"
+#include "StockStructure.h"
+
+namespace fre {
+
+    // Exact running sums over the event-window abnormal returns of one group: per day, the
+    // sums of AR and AR^2 and of the cumulative CAR and CAR^2, plus the event count.
+    //
+    // Every value is rounded once onto a fixed-point grid (2^-40) and summed in 128-bit
+    // integers, so adding, merging and removing events in any order, on any thread or in
+    // any process, gives bit-identical totals.
+    class GroupAccumulator {
+    public:
+        typedef __int128 Fixed;
+        static constexpr double kScale = 1099511627776.0;  // 2^40
+
+        explicit GroupAccumulator(int days = 0);
+
+        int days() const { return days_; }
+        std::int64_t count() const { return n_; }
+
+        // One event's abnormal returns (days() values); other lengths are ignored
+        void add(const Vector& abnormReturns);
+        // Exact inverse of add() for the same vector
+        void remove(const Vector& abnormReturns);
+        // Add other's sums; both must have the same days()
+        void merge(const GroupAccumulator& other);
+
+        // Estimate in the shape of a bootstrap result: AAR / CAAR means over the events so
+        // far and the dispersion a resample of sampleSize events would show (sd / sqrt(M))
+        GroupStats estimate(int sampleSize) const;
+
+        // sd(CAR on the last day) / sqrt(n): how far the final CAAR may still move
+        double finalCAARStdErr() const;
+
+        // Raw sums, for shipping an accumulator between processes
+        const std::vector<Fixed>& sumAR() const { return ar_; }
+        const std::vector<Fixed>& sumAR2() const { return ar2_; }
+        const std::vector<Fixed>& sumCAR() const { return car_; }
+        const std::vector<Fixed>& sumCAR2() const { return car2_; }
+        void assign(std::int64_t n, std::vector<Fixed> ar, std::vector<Fixed> ar2,
+                    std::vector<Fixed> car, std::vector<Fixed> car2);
+
+    private:
+        void apply(const Vector& abnormReturns, int sign);
+
+        int days_;
+        std::int64_t n_;
+        std::vector<Fixed> ar_, ar2_, car_, car2_;
+    };
+
+    // Beat / Meet / Miss accumulators at one moment, with the run's progress
+    struct LiveGroupSnapshot {
+        int N = 0;
+        std::size_t completed = 0;  // events committed so far, with or without returns
+        std::size_t total = 0;
+        GroupAccumulator miss, meet, beat;
+
+        const GroupAccumulator& group(EventGroup g) const {
+            return g == EventGroup::Miss ? miss : g == EventGroup::Meet ? meet : beat;
+        }
+    };
+
+    // One event's move between groups: its old contribution is taken out, the new one
+    // added. None (or returns of the wrong length) on either side means no contribution
+    struct GroupChange {
+        EventGroup fromGroup = EventGroup::None;
+        Vector fromReturns;
+        EventGroup toGroup = EventGroup::None;
+        Vector toReturns;
+    };
+
+    // Thread-safe group accumulators filled by a running Option 1 as events commit. Once
+    // the run is done they are rebuilt from its final abnormal returns and then kept as the
+    // universe's sufficient statistics, updated by event when the universe changes
+    class LiveGroupStats {
+    public:
+        void reset(int N, std::size_t totalEvents);
+        // An event finished; its abnormal returns count toward its group if it has both
+        void commit(EventGroup group, const Vector& abnormReturns);
+        // Sums over every event of the registry, all counted as completed
+        void rebuild(const StockRegistry& registry, int N);
+        // Apply changes in one step; the universe now has totalEvents events, all completed
+        void update(const std::vector<GroupChange>& changes, std::size_t totalEvents);
+        LiveGroupSnapshot snapshot() const;
+
+    private:
+        GroupAccumulator* groupOf(EventGroup group);
+
+        mutable std::mutex mutex_;
+        LiveGroupSnapshot state_;
+    };
+
+}
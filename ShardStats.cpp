@@ -0,0 +1,411 @@
+#include "ShardStats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+#include "Snapshot.h"
+#include "StockGrouper.h"
+
+using namespace std;
+
+namespace fre {
+
+    namespace {
+        const char kMagic[8] = { 'F', 'R', 'E', 'S', 'H', 'A', 'R', 'D' };
+        const uint32_t kShardVersion = 2;
+        const uint32_t kEndianTag = 0x01020304;
+
+        struct ShardHeader {         // 80 bytes
+            char magic[8];
+            uint32_t version;
+            uint32_t endianTag;
+            uint64_t inputs;
+            int32_t N;
+            uint32_t model;
+            uint32_t shard;
+            uint32_t shards;
+            uint64_t events;
+            uint64_t usable;
+            uint64_t seed;
+            uint32_t days;           // length of every sum vector, 2N
+            uint32_t resamples;
+            uint32_t sampleSize;
+            uint32_t reserved;
+        };
+        static_assert(sizeof(ShardHeader) == 80, "shard header must stay 80 bytes");
+
+        const char kValidityMagic[8] = { 'F', 'R', 'E', 'V', 'A', 'L', 'I', 'D' };
+        const uint32_t kValidityVersion = 1;
+
+        struct ValidityHeader {      // 56 bytes
+            char magic[8];
+            uint32_t version;
+            uint32_t endianTag;
+            uint64_t inputs;
+            int32_t N;
+            uint32_t model;
+            uint32_t shard;
+            uint32_t shards;
+            uint64_t seed;
+            uint64_t count;          // event ids that follow, uint32 each
+        };
+        static_assert(sizeof(ValidityHeader) == 56, "validity header must stay 56 bytes");
+
+        template <class T>
+        void put(string& buf, T v) {
+            buf.append(reinterpret_cast<const char*>(&v), sizeof(v));
+        }
+
+        template <class T>
+        bool get(const char*& p, const char* end, T& v) {
+            if (static_cast<size_t>(end - p) < sizeof(v)) return false;
+            memcpy(&v, p, sizeof(v));
+            p += sizeof(v);
+            return true;
+        }
+
+        // Per group (Miss, Meet, Beat): members, usable, the number of resamples drawn
+        // (0 for an empty group), then per resample the used draws and the AR sums
+        void putGroup(string& buf, const ShardGroup& g) {
+            put<uint64_t>(buf, g.members);
+            put<uint64_t>(buf, g.usable);
+            put<uint64_t>(buf, g.draws.size());
+            for (const ResampleSum& r : g.draws) {
+                put<int64_t>(buf, r.used);
+                buf.append(reinterpret_cast<const char*>(r.sumAR.data()), r.sumAR.size() * sizeof(ResampleSum::Fixed));
+            }
+        }
+
+        // buf plus its checksum, written to path + ".tmp" and renamed over path
+        bool writeChecksummed(const string& path, string buf, string& error) {
+            uint64_t checksum = snapshotChecksum(buf.data(), buf.size());
+            buf.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+
+            const string tmp = path + ".tmp";
+            {
+                ofstream out(tmp, ios::binary | ios::trunc);
+                if (!out) {
+                    error = "cannot write " + tmp;
+                    return false;
+                }
+                out.write(buf.data(), buf.size());
+                out.flush();
+                if (!out) {
+                    error = "write failed for " + tmp;
+                    remove(tmp.c_str());
+                    return false;
+                }
+            }
+            if (rename(tmp.c_str(), path.c_str()) != 0) {
+                error = "cannot replace " + path;
+                remove(tmp.c_str());
+                return false;
+            }
+            return true;
+        }
+
+        // Contents of path without its checksum, once the checksum matches
+        bool readChecksummed(const string& path, size_t headerSize, string& buf, string& error) {
+            ifstream in(path, ios::binary);
+            if (!in) {
+                error = "cannot open " + path;
+                return false;
+            }
+            buf.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+            if (buf.size() < headerSize + sizeof(uint64_t)) {
+                error = path + " is truncated";
+                return false;
+            }
+            uint64_t checksum;
+            size_t body = buf.size() - sizeof(checksum);
+            memcpy(&checksum, buf.data() + body, sizeof(checksum));
+            if (snapshotChecksum(buf.data(), body) != checksum) {
+                error = path + " is corrupt (checksum mismatch)";
+                return false;
+            }
+            buf.resize(body);
+            return true;
+        }
+
+        bool getGroup(const char*& p, const char* end, uint32_t days, uint32_t resamples, ShardGroup& g) {
+            uint64_t drawn = 0;
+            if (!get(p, end, g.members) || !get(p, end, g.usable) || !get(p, end, drawn)) return false;
+            if (drawn != 0 && drawn != resamples) return false;
+            g.draws.assign(drawn, ResampleSum());
+            for (ResampleSum& r : g.draws) {
+                if (!get(p, end, r.used)) return false;
+                size_t bytes = days * sizeof(ResampleSum::Fixed);
+                if (static_cast<size_t>(end - p) < bytes) return false;
+                r.sumAR.resize(days);
+                memcpy(r.sumAR.data(), p, bytes);
+                p += bytes;
+            }
+            return true;
+        }
+    }
+
+    vector<EventId> shardEvents(const StockRegistry& registry, uint32_t shard, uint32_t shards)
+    {
+        const size_t total = registry.size();
+        auto boundary = [&](uint32_t k) {
+            size_t b = total * k / shards;
+            while (b > 0 && b < total && registry.key(static_cast<EventId>(b)).first == registry.key(static_cast<EventId>(b - 1)).first) ++b;
+            return b;
+        };
+
+        vector<EventId> ids;
+        if (shards == 0 || shard >= shards) return ids;
+        size_t begin = boundary(shard), end = boundary(shard + 1);
+        for (size_t e = begin; e < end; ++e) ids.push_back(static_cast<EventId>(e));
+        return ids;
+    }
+
+    vector<EventId> shardValidEvents(const StockRegistry& registry, const vector<EventId>& ids)
+    {
+        vector<EventId> valid;
+        for (EventId id : ids) {
+            registry.read(id, [&](const Stock& s) {
+                if (s.getGroup() != EventGroup::None && StockGrouper::hasReturns(s)) valid.push_back(id);
+            });
+        }
+        sort(valid.begin(), valid.end());
+        return valid;
+    }
+
+    void bootstrapShard(const StockRegistry& registry, const vector<EventId>& ids,
+                        const vector<EventId>& valid, ShardPartial& partial)
+    {
+        vector<char> own(registry.size(), 0), drawn(registry.size(), 0);
+        for (EventId id : ids) if (id < own.size()) own[id] = 1;
+        for (EventId id : valid) if (id < drawn.size()) drawn[id] = 1;
+
+        // The groups as extractValidGroups gives them to Option 1, in registry order;
+        // abnormal returns only for the shard's own events, every other draw is summed by its owner
+        ShardGroup* groups[3] = { &partial.miss, &partial.meet, &partial.beat };
+        vector<Vector> returns[3];
+        partial.events = ids.size();
+        partial.usable = 0;
+        for (ShardGroup* g : groups) *g = ShardGroup();
+        for (EventId id = 0; id < registry.size(); ++id) {
+            if (!drawn[id]) continue;
+            registry.read(id, [&](const Stock& s) {
+                EventGroup group = s.getGroup();
+                if (group == EventGroup::None) return;
+                int k = group == EventGroup::Miss ? 0 : group == EventGroup::Meet ? 1 : 2;
+                ++groups[k]->members;
+                returns[k].emplace_back();
+                if (!own[id]) return;
+                returns[k].back() = s.getAbnormReturns();
+                ++groups[k]->usable;
+                ++partial.usable;
+            });
+        }
+
+        Bootstrapper bootstrap(partial.N, partial.resamples, partial.sampleSize);
+        bootstrap.setSeed(partial.seed);
+        for (int k = 0; k < 3; ++k) {
+            const vector<Vector>& ar = returns[k];
+            groups[k]->draws = bootstrap.resampleSums(ar.size(), [&](int i) { return ar[i].empty() ? nullptr : &ar[i]; });
+        }
+    }
+
+    string shardFileName(uint32_t shard, uint32_t shards)
+    {
+        return "shard_" + to_string(shard) + "_of_" + to_string(shards) + ".bin";
+    }
+
+    string shardValidityFileName(uint32_t shard, uint32_t shards)
+    {
+        return "shard_" + to_string(shard) + "_of_" + to_string(shards) + ".valid";
+    }
+
+    bool writeShardValidity(const string& path, const ShardValidity& validity, string& error)
+    {
+        ValidityHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kValidityMagic, sizeof(kValidityMagic));
+        header.version = kValidityVersion;
+        header.endianTag = kEndianTag;
+        header.inputs = validity.inputs;
+        header.N = validity.N;
+        header.model = static_cast<uint32_t>(validity.model);
+        header.shard = validity.shard;
+        header.shards = validity.shards;
+        header.seed = validity.seed;
+        header.count = validity.events.size();
+
+        string buf(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (EventId id : validity.events) put<uint32_t>(buf, id);
+        return writeChecksummed(path, std::move(buf), error);
+    }
+
+    bool readShardValidity(const string& path, ShardValidity& validity, string& error)
+    {
+        string buf;
+        ValidityHeader header;
+        if (!readChecksummed(path, sizeof(header), buf, error)) return false;
+        memcpy(&header, buf.data(), sizeof(header));
+        if (memcmp(header.magic, kValidityMagic, sizeof(kValidityMagic)) != 0 || header.endianTag != kEndianTag
+            || header.version != kValidityVersion) {
+            error = path + " is not a shard validity file of this version";
+            return false;
+        }
+        if (buf.size() != sizeof(header) + header.count * sizeof(uint32_t)) {
+            error = path + " has an inconsistent layout";
+            return false;
+        }
+
+        validity.inputs = header.inputs;
+        validity.N = header.N;
+        validity.model = static_cast<AbnormalReturnModel>(header.model);
+        validity.shard = header.shard;
+        validity.shards = header.shards;
+        validity.seed = header.seed;
+        validity.events.resize(header.count);
+        const char* p = buf.data() + sizeof(header);
+        const char* end = buf.data() + buf.size();
+        for (EventId& id : validity.events) get(p, end, id);
+        return true;
+    }
+
+    bool writeShardPartial(const string& path, const ShardPartial& partial, string& error)
+    {
+        ShardHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kShardVersion;
+        header.endianTag = kEndianTag;
+        header.inputs = partial.inputs;
+        header.N = partial.N;
+        header.model = static_cast<uint32_t>(partial.model);
+        header.shard = partial.shard;
+        header.shards = partial.shards;
+        header.events = partial.events;
+        header.usable = partial.usable;
+        header.seed = partial.seed;
+        header.days = static_cast<uint32_t>(2 * partial.N);
+        header.resamples = static_cast<uint32_t>(partial.resamples);
+        header.sampleSize = static_cast<uint32_t>(partial.sampleSize);
+
+        string buf(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const ShardGroup* g : { &partial.miss, &partial.meet, &partial.beat }) {
+            for (const ResampleSum& r : g->draws) {
+                if (r.sumAR.size() != header.days) {
+                    error = "resample sums do not match N = " + to_string(partial.N);
+                    return false;
+                }
+            }
+            putGroup(buf, *g);
+        }
+        return writeChecksummed(path, std::move(buf), error);
+    }
+
+    bool readShardPartial(const string& path, ShardPartial& partial, string& error)
+    {
+        string buf;
+        ShardHeader header;
+        if (!readChecksummed(path, sizeof(header), buf, error)) return false;
+        memcpy(&header, buf.data(), sizeof(header));
+        if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.endianTag != kEndianTag) {
+            error = path + " is not a shard file";
+            return false;
+        }
+        if (header.version != kShardVersion) {
+            error = path + " has format version " + to_string(header.version) + ", expected " + to_string(kShardVersion);
+            return false;
+        }
+
+        if (header.N <= 0 || header.days != static_cast<uint32_t>(2 * header.N) || header.resamples == 0) {
+            error = path + " has an inconsistent layout";
+            return false;
+        }
+
+        partial.inputs = header.inputs;
+        partial.N = header.N;
+        partial.model = static_cast<AbnormalReturnModel>(header.model);
+        partial.shard = header.shard;
+        partial.shards = header.shards;
+        partial.events = header.events;
+        partial.usable = header.usable;
+        partial.seed = header.seed;
+        partial.resamples = static_cast<int>(header.resamples);
+        partial.sampleSize = static_cast<int>(header.sampleSize);
+
+        const char* p = buf.data() + sizeof(header);
+        const char* end = buf.data() + buf.size();
+        for (ShardGroup* g : { &partial.miss, &partial.meet, &partial.beat }) {
+            if (!getGroup(p, end, header.days, header.resamples, *g)) {
+                error = path + " is truncated or has an inconsistent layout";
+                return false;
+            }
+        }
+        if (p != end) {
+            error = path + " has an inconsistent layout";
+            return false;
+        }
+        return true;
+    }
+
+    bool mergeShardPartials(const vector<ShardPartial>& partials, ShardPartial& merged, string& error)
+    {
+        if (partials.empty()) {
+            error = "no shard results";
+            return false;
+        }
+        const ShardPartial& first = partials.front();
+        merged = ShardPartial();
+        merged.inputs = first.inputs;
+        merged.N = first.N;
+        merged.model = first.model;
+        merged.shard = 0;
+        merged.shards = first.shards;
+        merged.seed = first.seed;
+        merged.resamples = first.resamples;
+        merged.sampleSize = first.sampleSize;
+        ShardGroup* groups[3] = { &merged.miss, &merged.meet, &merged.beat };
+        const ShardGroup* firstGroups[3] = { &first.miss, &first.meet, &first.beat };
+        for (int k = 0; k < 3; ++k) {
+            groups[k]->members = firstGroups[k]->members;
+            groups[k]->draws.assign(firstGroups[k]->draws.size(), ResampleSum());
+            for (ResampleSum& r : groups[k]->draws) r.sumAR.assign(2 * first.N, 0);
+        }
+
+        vector<bool> seen(first.shards, false);
+        for (const ShardPartial& p : partials) {
+            string which = "shard " + to_string(p.shard) + " of " + to_string(p.shards);
+            if (p.inputs != first.inputs) { error = which + " was run on other input CSVs"; return false; }
+            if (p.N != first.N || p.model != first.model) { error = which + " has another N or model"; return false; }
+            if (p.seed != first.seed || p.resamples != first.resamples || p.sampleSize != first.sampleSize) {
+                error = which + " has another bootstrap seed, resample count or sample size";
+                return false;
+            }
+            if (p.shards != first.shards || p.shard >= p.shards) { error = which + " and a split into " + to_string(first.shards) + " are mixed"; return false; }
+            if (seen[p.shard]) { error = which + " appears twice"; return false; }
+            seen[p.shard] = true;
+
+            const ShardGroup* parts[3] = { &p.miss, &p.meet, &p.beat };
+            for (int k = 0; k < 3; ++k) {
+                if (parts[k]->members != groups[k]->members || parts[k]->draws.size() != groups[k]->draws.size()) {
+                    error = which + " grouped the universe differently";
+                    return false;
+                }
+                groups[k]->usable += parts[k]->usable;
+                for (size_t r = 0; r < parts[k]->draws.size(); ++r) groups[k]->draws[r].merge(parts[k]->draws[r]);
+            }
+            merged.events += p.events;
+            merged.usable += p.usable;
+        }
+        for (uint32_t k = 0; k < first.shards; ++k) {
+            if (!seen[k]) {
+                error = "shard " + to_string(k) + " of " + to_string(first.shards) + " is missing";
+                return false;
+            }
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Bootstrapper.h"
+#include "ReturnPanel.h"
+#include "StockRegistry.h"
+#include "StockStructure.h"
+
+namespace fre {
+
+    // The events of one shard a bootstrap draws from: grouped and with abnormal returns
+    // (StockGrouper::hasReturns). Every shard publishes its list before drawing, so all of
+    // them draw over the group members Option 1 would, in registry order.
+    struct ShardValidity {
+        std::uint64_t inputs = 0;
+        int N = 0;
+        AbnormalReturnModel model = AbnormalReturnModel::MarketAdjusted;
+        std::uint32_t shard = 0;
+        std::uint32_t shards = 1;
+        std::uint64_t seed = 0;
+        std::vector<EventId> events;  // ascending
+    };
+
+    // One group of a shard: the group's size over the whole universe, and per resample of
+    // the run's bootstrap the shard's part of the draws (the drawn events it owns)
+    struct ShardGroup {
+        std::uint64_t members = 0;  // members with abnormal returns over all shards, in every shard alike
+        std::uint64_t usable = 0;   // of those, the shard's own
+        std::vector<ResampleSum> draws;
+    };
+
+    // Partial result of one shard of a sharded run. Every shard makes all draws of Option 1's
+    // bootstrap under the same seed, over the events with returns of all shards, and sums the
+    // drawn events it owns. The sums are exact (ResampleSum), so adding the shards' parts of
+    // each resample gives Option 1's resamples bit for bit, whatever the split.
+    struct ShardPartial {
+        std::uint64_t inputs = 0;  // fingerprintInputs of the CSVs, so every shard grouped the same universe
+        int N = 0;
+        AbnormalReturnModel model = AbnormalReturnModel::MarketAdjusted;
+        std::uint32_t shard = 0;
+        std::uint32_t shards = 1;
+        std::uint64_t seed = 0;
+        int resamples = 0;
+        int sampleSize = 0;
+        std::uint64_t events = 0;  // events of the shard
+        std::uint64_t usable = 0;  // of those, in a group and with abnormal returns
+        ShardGroup miss, meet, beat;
+
+        ShardGroup& group(EventGroup g) {
+            return g == EventGroup::Miss ? miss : g == EventGroup::Meet ? meet : beat;
+        }
+    };
+
+    // Events of shard k of n: a contiguous run of the registry's (ticker, date) order, with
+    // the boundaries moved to ticker changes so a ticker is downloaded by one shard only
+    std::vector<EventId> shardEvents(const StockRegistry& registry, std::uint32_t shard, std::uint32_t shards);
+
+    // Of the shard's events ids, those the bootstrap draws from
+    std::vector<EventId> shardValidEvents(const StockRegistry& registry, const std::vector<EventId>& ids);
+
+    // The shard's part of every resample of the bootstrap set by partial's N, seed, resamples
+    // and sampleSize, drawn over Miss, Meet and Beat in that order as Option 1 does. valid
+    // holds the ShardValidity events of every shard of the run.
+    void bootstrapShard(const StockRegistry& registry, const std::vector<EventId>& ids,
+                        const std::vector<EventId>& valid, ShardPartial& partial);
+
+    // shard_<k>_of_<n>.bin, and shard_<k>_of_<n>.valid for its ShardValidity
+    std::string shardFileName(std::uint32_t shard, std::uint32_t shards);
+    std::string shardValidityFileName(std::uint32_t shard, std::uint32_t shards);
+
+    // Checksummed binary file of the shard's usable events, written as the partial below
+    bool writeShardValidity(const std::string& path, const ShardValidity& validity, std::string& error);
+    bool readShardValidity(const std::string& path, ShardValidity& validity, std::string& error);
+
+    // Versioned, checksummed binary file, written to path + ".tmp" and renamed over path.
+    // False with error set on failure.
+    bool writeShardPartial(const std::string& path, const ShardPartial& partial, std::string& error);
+    bool readShardPartial(const std::string& path, ShardPartial& partial, std::string& error);
+
+    // Sum of the partials of one run. False with error set unless they agree on inputs, N,
+    // model, bootstrap, group sizes and shard count, and hold each shard exactly once.
+    bool mergeShardPartials(const std::vector<ShardPartial>& partials, ShardPartial& merged, std::string& error);
+
+}
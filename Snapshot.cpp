@@ -0,0 +1,701 @@
+#include "Snapshot.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace fre {
+
+    // --- 1. Checksum ---
+    uint64_t snapshotChecksum(const void* data, size_t size, uint64_t seed)
+    {
+        // FNV-1a over 64-bit words with a final avalanche; the tail is zero-padded
+        const uint64_t prime = 0x100000001b3ULL;
+        uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        size_t words = size / 8;
+        for (size_t i = 0; i < words; ++i) {
+            uint64_t w;
+            memcpy(&w, p + i * 8, 8);
+            h = (h ^ w) * prime;
+        }
+        uint64_t tail = 0;
+        if (size > words * 8) memcpy(&tail, p + words * 8, size - words * 8);
+        h = (h ^ tail ^ size) * prime;
+
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    namespace {
+        // Path, size and modification time of one file of the price source
+        uint64_t fingerprintFile(const string& path, uint64_t h) {
+            struct stat st;
+            int64_t meta[2] = { -1, -1 };
+            if (stat(path.c_str(), &st) == 0) {
+                meta[0] = static_cast<int64_t>(st.st_size);
+                meta[1] = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+            }
+            h = snapshotChecksum(path.data(), path.size(), h);
+            return snapshotChecksum(meta, sizeof(meta), h);
+        }
+    }
+
+    uint64_t fingerprintInputs(const vector<string>& paths, const string& priceSource)
+    {
+        uint64_t h = 0;
+        for (const string& path : paths) {
+            MappedFile file;
+            if (file.open(path)) h = snapshotChecksum(file.data(), file.size(), h);
+            else h = snapshotChecksum(nullptr, 0, h);
+        }
+        if (priceSource.empty()) return h;
+
+        // A directory archive counts every file in it, in name order
+        error_code ec;
+        string root = filesystem::absolute(priceSource, ec).lexically_normal().string();
+        h = fingerprintFile(root, h);
+        if (filesystem::is_directory(root, ec)) {
+            vector<string> files;
+            for (const auto& entry : filesystem::recursive_directory_iterator(root, ec))
+                if (entry.is_regular_file(ec)) files.push_back(entry.path().string());
+            sort(files.begin(), files.end());
+            for (const string& f : files) h = fingerprintFile(f, h);
+        }
+        return h;
+    }
+
+    bool syncFile(const string& path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        bool ok = fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+    }
+
+    bool syncParentDirectory(const string& path)
+    {
+        string dir = filesystem::path(path).parent_path().string();
+        return syncFile(dir.empty() ? "." : dir);
+    }
+
+    // --- 2. File layout ---
+    namespace {
+        const char kMagic[8] = { 'F', 'R', 'E', 'S', 'N', 'A', 'P', '\0' };
+        const uint32_t kEndianTag = 0x01020304;
+        const uint32_t kNone = 0xffffffffu;
+
+        enum SectionId : uint32_t {
+            kStrings = 1, kEvents, kHistories, kBenchmark, kGrouping, kRun, kStats
+        };
+
+        struct FileHeader {          // 64 bytes
+            char magic[8];
+            uint32_t version;
+            uint32_t endianTag;
+            uint64_t inputs;         // fingerprintInputs of the CSVs the state came from
+            uint32_t sectionCount;
+            uint32_t flags;          // bit 0: the run sections are present
+            uint64_t tableChecksum;
+            int64_t createdAt;       // seconds since the epoch
+            uint64_t reserved[2];
+        };
+        static_assert(sizeof(FileHeader) == 64, "snapshot header must stay 64 bytes");
+
+        struct SectionEntry {        // 32 bytes
+            uint32_t id;
+            uint32_t reserved;
+            uint64_t offset;
+            uint64_t size;
+            uint64_t checksum;
+        };
+
+        // Append-only buffer of one section
+        class ByteWriter {
+        public:
+            template <class T>
+            void put(const T& v) {
+                static_assert(is_trivially_copyable<T>::value, "put() takes plain values");
+                const char* p = reinterpret_cast<const char*>(&v);
+                buf_.insert(buf_.end(), p, p + sizeof(T));
+            }
+
+            // Count, then the elements 8-byte aligned so they can be read in place
+            template <class T>
+            void putArray(const T* data, size_t n) {
+                static_assert(is_trivially_copyable<T>::value, "putArray() takes plain values");
+                put<uint64_t>(n);
+                align();
+                const char* p = reinterpret_cast<const char*>(data);
+                buf_.insert(buf_.end(), p, p + n * sizeof(T));
+                align();
+            }
+
+            template <class V>
+            void putVector(const V& v) { putArray(v.data(), v.size()); }
+
+            void putString(const string& s) {
+                put<uint32_t>(static_cast<uint32_t>(s.size()));
+                buf_.insert(buf_.end(), s.begin(), s.end());
+            }
+
+            void align() { buf_.resize((buf_.size() + 7) & ~size_t(7), 0); }
+            const vector<char>& bytes() const { return buf_; }
+
+        private:
+            vector<char> buf_;
+        };
+
+        // Bounds-checked cursor over one mapped section
+        class ByteReader {
+        public:
+            ByteReader(const char* data, size_t size) : begin_(data), p_(data), end_(data + size) {}
+
+            template <class T>
+            T get() {
+                need(sizeof(T));
+                T v;
+                memcpy(&v, p_, sizeof(T));
+                p_ += sizeof(T);
+                return v;
+            }
+
+            template <class T>
+            const T* getArray(size_t& n) {
+                n = static_cast<size_t>(get<uint64_t>());
+                align();
+                if (n > static_cast<size_t>(end_ - p_) / sizeof(T)) throw runtime_error("array past end of section");
+                const T* data = reinterpret_cast<const T*>(p_);
+                p_ += n * sizeof(T);
+                align();
+                return data;
+            }
+
+            template <class V>
+            void getVector(V& out) {
+                size_t n = 0;
+                const auto* data = getArray<typename V::value_type>(n);
+                out.assign(data, data + n);
+            }
+
+            string getString() {
+                uint32_t n = get<uint32_t>();
+                need(n);
+                string s(p_, n);
+                p_ += n;
+                return s;
+            }
+
+        private:
+            void need(size_t n) {
+                if (n > static_cast<size_t>(end_ - p_)) throw runtime_error("section truncated");
+            }
+            void align() {
+                size_t off = static_cast<size_t>(p_ - begin_);
+                size_t pad = ((off + 7) & ~size_t(7)) - off;
+                p_ += min(pad, static_cast<size_t>(end_ - p_));
+            }
+
+            const char* begin_;
+            const char* p_;
+            const char* end_;
+        };
+
+        // Snapshot-local string ids, deduplicated on save
+        class StringIds {
+        public:
+            uint32_t id(const string& s) {
+                auto r = index_.emplace(s, static_cast<uint32_t>(strings_.size()));
+                if (r.second) strings_.push_back(s);
+                return r.first->second;
+            }
+            const vector<string>& strings() const { return strings_; }
+
+        private:
+            unordered_map<string, uint32_t> index_;
+            vector<string> strings_;
+        };
+
+        void putHistory(ByteWriter& w, const PriceHistory& h) {
+            w.putVector(h.days);
+            w.putVector(h.prices);
+        }
+
+        void getHistory(ByteReader& r, PriceHistory& h) {
+            r.getVector(h.days);
+            r.getVector(h.prices);
+            if (h.days.size() != h.prices.size()) throw runtime_error("history arrays differ in length");
+        }
+
+        void putTestRows(ByteWriter& w, const vector<EventTestRow>& rows) {
+            w.put<uint64_t>(rows.size());
+            for (const EventTestRow& row : rows) {
+                w.put<int32_t>(row.n);
+                w.put<int32_t>(row.nStd);
+                w.put(row.meanAR);
+                w.put(row.tCS);
+                w.put(row.patellZ);
+                w.put(row.bmpT);
+                w.put(row.corradoT);
+            }
+        }
+
+        void getTestRows(ByteReader& r, vector<EventTestRow>& rows) {
+            rows.resize(static_cast<size_t>(r.get<uint64_t>()));
+            for (EventTestRow& row : rows) {
+                row.n = r.get<int32_t>();
+                row.nStd = r.get<int32_t>();
+                row.meanAR = r.get<double>();
+                row.tCS = r.get<double>();
+                row.patellZ = r.get<double>();
+                row.bmpT = r.get<double>();
+                row.corradoT = r.get<double>();
+            }
+        }
+
+        void putTests(ByteWriter& w, const EventTestResult& t) {
+            w.putVector(t.days);
+            putTestRows(w, t.daily);
+            w.put<uint64_t>(t.carWindows.size());
+            for (const auto& win : t.carWindows) {
+                w.put<int32_t>(win.first);
+                w.put<int32_t>(win.second);
+            }
+            putTestRows(w, t.car);
+        }
+
+        EventTestResult getTests(ByteReader& r) {
+            EventTestResult t;
+            r.getVector(t.days);
+            getTestRows(r, t.daily);
+            t.carWindows.resize(static_cast<size_t>(r.get<uint64_t>()));
+            for (auto& win : t.carWindows) {
+                win.first = r.get<int32_t>();
+                win.second = r.get<int32_t>();
+            }
+            getTestRows(r, t.car);
+            return t;
+        }
+
+        void putGroupStats(ByteWriter& w, const GroupStats& g) {
+            w.putVector(g.AAR_mean);
+            w.putVector(g.AAR_std);
+            w.putVector(g.CAAR_mean);
+            w.putVector(g.CAAR_std);
+        }
+
+        GroupStats getGroupStats(ByteReader& r) {
+            GroupStats g;
+            r.getVector(g.AAR_mean);
+            r.getVector(g.AAR_std);
+            r.getVector(g.CAAR_mean);
+            r.getVector(g.CAAR_std);
+            return g;
+        }
+    }
+
+    // --- 3. Save ---
+    bool saveSnapshot(const string& path, uint64_t inputs, const SnapshotSource& src, string& error)
+    {
+        if (!src.registry || !src.groupingKeys || !src.quantileGroups) {
+            error = "incomplete state";
+            return false;
+        }
+        const StockRegistry& registry = *src.registry;
+        const bool hasRun = src.panel && src.fit && src.stats;
+
+        StringIds strings;
+
+        // Events in id order, each history written once however many events share it
+        ByteWriter events;
+        unordered_map<const PriceHistory*, uint32_t> historyIds;
+        vector<const PriceHistory*> historyList;
+        events.put<uint64_t>(registry.size());
+        for (EventId id = 0; id < registry.size(); ++id) {
+            registry.read(id, [&](const Stock& s) {
+                uint32_t historyId = kNone;
+                uint32_t first = 0;
+                PriceView px = s.getPrices();
+                if (s.getHistory()) {
+                    auto r = historyIds.emplace(s.getHistory().get(), static_cast<uint32_t>(historyIds.size()));
+                    if (r.second) historyList.push_back(s.getHistory().get());
+                    historyId = r.first->second;
+                    first = px.empty() ? 0 : static_cast<uint32_t>(px.days() - s.getHistory()->days.data());
+                }
+
+                events.put(strings.id(s.getTicker()));
+                events.put<int32_t>(s.getAnnouncementDay());
+                events.put<int32_t>(s.getPeriodEndDay());
+                events.put(s.getEstimateEarning());
+                events.put(s.getReportedEarning());
+                events.put(s.getSurprise());
+                events.put(s.getSurprisePercent());
+                events.put(static_cast<uint32_t>(s.getGroup()));
+                events.put<int32_t>(s.getWindowStartDay());
+                events.put<int32_t>(s.getWindowEndDay());
+                events.put(strings.id(s.getCompanyName()));
+                events.put(strings.id(s.getSector()));
+                events.put(historyId);
+                events.put(first);
+                events.put(static_cast<uint32_t>(px.size()));
+                events.putVector(s.getReturns());
+                events.putVector(s.getCumReturns());
+                events.putVector(s.getAbnormReturns());
+            });
+        }
+        ByteWriter histories;
+        histories.put<uint64_t>(historyList.size());
+        for (const PriceHistory* h : historyList) putHistory(histories, *h);
+
+        ByteWriter benchmark;
+        putHistory(benchmark, src.benchmark ? *src.benchmark : PriceHistory());
+
+        // Quantile labels are aligned with the grouping keys, which are stored once
+        ByteWriter grouping;
+        grouping.put<uint64_t>(src.groupingKeys->size());
+        for (const GroupingKey& k : *src.groupingKeys) {
+            grouping.put(strings.id(k.ticker));
+            grouping.put(strings.id(k.date));
+            grouping.put(strings.id(k.sector));
+            grouping.put(k.surprisePct);
+        }
+        const QuantileGrouping& q = *src.quantileGroups;
+        grouping.put<uint64_t>(q.schemes.size());
+        for (size_t i = 0; i < q.schemes.size(); ++i) {
+            grouping.put(strings.id(q.schemes[i].name));
+            grouping.put<int32_t>(q.schemes[i].numGroups);
+            grouping.put(q.schemes[i].trimFraction);
+            grouping.putVector(i < q.labels.size() ? q.labels[i] : vector<int>());
+        }
+
+        ByteWriter run, stats;
+        if (hasRun) {
+            const MarketModelFit& fit = *src.fit;
+            run.put(static_cast<uint32_t>(src.model));
+            run.put<int32_t>(fit.window.start);
+            run.put<int32_t>(fit.window.end);
+            run.putVector(fit.alpha);
+            run.putVector(fit.beta);
+            run.putVector(fit.residVar);
+            run.putVector(fit.marketMean);
+            run.putVector(fit.marketSxx);
+            run.putVector(fit.obs);
+
+            const ReturnPanel& panel = *src.panel;
+            vector<uint32_t> columns(panel.keys.size());
+            for (size_t e = 0; e < panel.keys.size(); ++e) columns[e] = registry.find(panel.keys[e]);
+            vector<uint64_t> groupBegin(panel.groupBegin.begin(), panel.groupBegin.end());
+            run.put<int32_t>(panel.dayLo);
+            run.put<int32_t>(panel.dayHi);
+            run.put<uint64_t>(panel.numEvents);
+            run.putVector(columns);
+            run.putVector(groupBegin);
+            run.putVector(panel.hasEstimation);
+            run.putVector(panel.stockRet);
+            run.putVector(panel.marketRet);
+            run.putVector(panel.abnormalRet);
+
+            const StatCalculator& calc = *src.stats;
+            stats.put<int32_t>(calc.getN());
+            stats.put<uint32_t>(static_cast<uint32_t>(calc.getStdEstimate()));
+            putGroupStats(stats, calc.getMissStats());
+            putGroupStats(stats, calc.getMeetStats());
+            putGroupStats(stats, calc.getBeatStats());
+            putTests(stats, calc.getMissTests());
+            putTests(stats, calc.getMeetTests());
+            putTests(stats, calc.getBeatTests());
+        }
+
+        // Strings last, once every section has registered its strings
+        ByteWriter stringTable;
+        stringTable.put<uint64_t>(strings.strings().size());
+        for (const string& s : strings.strings()) stringTable.putString(s);
+
+        vector<pair<SectionId, const ByteWriter*>> layout = {
+            { kStrings, &stringTable }, { kEvents, &events }, { kHistories, &histories },
+            { kBenchmark, &benchmark }, { kGrouping, &grouping }
+        };
+        if (hasRun) {
+            layout.push_back({ kRun, &run });
+            layout.push_back({ kStats, &stats });
+        }
+
+        FileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kSnapshotVersion;
+        header.endianTag = kEndianTag;
+        header.inputs = inputs;
+        header.sectionCount = static_cast<uint32_t>(layout.size());
+        header.flags = hasRun ? 1u : 0u;
+        header.createdAt = static_cast<int64_t>(time(nullptr));
+
+        vector<SectionEntry> table(layout.size());
+        uint64_t offset = sizeof(FileHeader) + table.size() * sizeof(SectionEntry);
+        for (size_t i = 0; i < layout.size(); ++i) {
+            const vector<char>& b = layout[i].second->bytes();
+            table[i].id = layout[i].first;
+            table[i].reserved = 0;
+            table[i].offset = offset;
+            table[i].size = b.size();
+            table[i].checksum = snapshotChecksum(b.data(), b.size());
+            offset += (b.size() + 7) & ~uint64_t(7);
+        }
+        header.tableChecksum = snapshotChecksum(table.data(), table.size() * sizeof(SectionEntry));
+
+        const string tmp = path + ".tmp";
+        {
+            ofstream out(tmp, ios::binary | ios::trunc);
+            if (!out) {
+                error = "cannot write " + tmp;
+                return false;
+            }
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(SectionEntry));
+            const char zeros[8] = {};
+            for (const auto& sec : layout) {
+                const vector<char>& b = sec.second->bytes();
+                out.write(b.data(), b.size());
+                out.write(zeros, ((b.size() + 7) & ~size_t(7)) - b.size());
+            }
+            out.flush();
+            if (!out) {
+                error = "write failed for " + tmp;
+                remove(tmp.c_str());
+                return false;
+            }
+        }
+        if (!syncFile(tmp)) {
+            error = "cannot sync " + tmp;
+            remove(tmp.c_str());
+            return false;
+        }
+        if (rename(tmp.c_str(), path.c_str()) != 0) {
+            error = "cannot replace " + path;
+            remove(tmp.c_str());
+            return false;
+        }
+        if (!syncParentDirectory(path)) {
+            error = "cannot sync the directory of " + path;
+            return false;
+        }
+        return true;
+    }
+
+    // --- 4. Load ---
+    bool loadSnapshot(const string& path, uint64_t inputs, SnapshotContents& out,
+                      pmr::memory_resource* panelResource, string& error)
+    {
+        MappedFile file;
+        if (!file.open(path)) {
+            error = file.error();
+            return false;
+        }
+
+        try {
+            if (file.size() < sizeof(FileHeader)) throw runtime_error("file too short");
+            FileHeader header;
+            memcpy(&header, file.data(), sizeof(header));
+            if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) throw runtime_error("not a snapshot");
+            if (header.endianTag != kEndianTag) throw runtime_error("written on a machine of other byte order");
+            if (header.version != kSnapshotVersion) {
+                throw runtime_error("format version " + to_string(header.version) +
+                                    ", expected " + to_string(kSnapshotVersion));
+            }
+            if (header.inputs != inputs) throw runtime_error("input CSVs or price source changed since it was written");
+
+            size_t tableBytes = static_cast<size_t>(header.sectionCount) * sizeof(SectionEntry);
+            if (file.size() - sizeof(FileHeader) < tableBytes) throw runtime_error("section table truncated");
+            const char* tableData = file.data() + sizeof(FileHeader);
+            if (snapshotChecksum(tableData, tableBytes) != header.tableChecksum) {
+                throw runtime_error("section table checksum mismatch");
+            }
+
+            vector<SectionEntry> table(header.sectionCount);
+            memcpy(table.data(), tableData, tableBytes);
+            auto section = [&](SectionId id) -> ByteReader {
+                for (const SectionEntry& e : table) {
+                    if (e.id != id) continue;
+                    if (e.offset > file.size() || e.size > file.size() - e.offset || e.offset % 8 != 0) {
+                        throw runtime_error("section " + to_string(id) + " out of bounds");
+                    }
+                    const char* data = file.data() + e.offset;
+                    if (snapshotChecksum(data, static_cast<size_t>(e.size)) != e.checksum) {
+                        throw runtime_error("section " + to_string(id) + " checksum mismatch");
+                    }
+                    return ByteReader(data, static_cast<size_t>(e.size));
+                }
+                throw runtime_error("section " + to_string(id) + " missing");
+            };
+
+            // Strings: intern once, then events refer to them by snapshot id
+            ByteReader strs = section(kStrings);
+            vector<string> strings(static_cast<size_t>(strs.get<uint64_t>()));
+            vector<Symbol> syms(strings.size());
+            for (size_t i = 0; i < strings.size(); ++i) {
+                strings[i] = strs.getString();
+                syms[i] = symbols().intern(strings[i]);
+            }
+            auto str = [&](uint32_t i) -> const string& {
+                if (i >= strings.size()) throw runtime_error("string id out of range");
+                return strings[i];
+            };
+
+            ByteReader hist = section(kHistories);
+            vector<shared_ptr<const PriceHistory>> histories(static_cast<size_t>(hist.get<uint64_t>()));
+            for (auto& h : histories) {
+                auto ph = make_shared<PriceHistory>();
+                getHistory(hist, *ph);
+                h = std::move(ph);
+            }
+
+            ByteReader ev = section(kEvents);
+            size_t numEvents = static_cast<size_t>(ev.get<uint64_t>());
+            vector<EventKey> keys;
+            keys.reserve(numEvents);
+            out.stocks.clear();
+            for (size_t i = 0; i < numEvents; ++i) {
+                uint32_t ticker = ev.get<uint32_t>();
+                DayNumber ann = ev.get<int32_t>();
+                DayNumber pend = ev.get<int32_t>();
+                double est = ev.get<double>();
+                double rpt = ev.get<double>();
+                double spr = ev.get<double>();
+                double sprPct = ev.get<double>();
+                uint32_t group = ev.get<uint32_t>();
+                DayNumber winStart = ev.get<int32_t>();
+                DayNumber winEnd = ev.get<int32_t>();
+                uint32_t company = ev.get<uint32_t>();
+                uint32_t sector = ev.get<uint32_t>();
+                uint32_t historyId = ev.get<uint32_t>();
+                uint32_t first = ev.get<uint32_t>();
+                uint32_t count = ev.get<uint32_t>();
+
+                Stock s;
+                str(ticker);
+                str(company);
+                str(sector);
+                s.setEarningData(syms[ticker], ann, pend, est, rpt, spr, sprPct);
+                s.setNameSymbols(syms[company], syms[sector]);
+                s.setGroup(static_cast<EventGroup>(group));
+                s.setStartEndDate(winStart, winEnd);
+                if (historyId != kNone) {
+                    if (historyId >= histories.size() || size_t(first) + count > histories[historyId]->size()) {
+                        throw runtime_error("event window outside its history");
+                    }
+                    s.setPriceWindow(histories[historyId], first, count);
+                }
+
+                Vector ret, cum, ab;
+                ev.getVector(ret);
+                ev.getVector(cum);
+                ev.getVector(ab);
+                s.setReturnSeries(std::move(ret), std::move(cum), std::move(ab));
+
+                EventKey key = s.getKey();
+                keys.push_back(key);
+                out.stocks.emplace(std::move(key), std::move(s));
+            }
+            if (out.stocks.size() != numEvents) throw runtime_error("duplicate events");
+
+            ByteReader bench = section(kBenchmark);
+            getHistory(bench, out.benchmark);
+
+            ByteReader grp = section(kGrouping);
+            out.groupingKeys.resize(static_cast<size_t>(grp.get<uint64_t>()));
+            for (GroupingKey& k : out.groupingKeys) {
+                k.ticker = str(grp.get<uint32_t>());
+                k.date = str(grp.get<uint32_t>());
+                k.sector = str(grp.get<uint32_t>());
+                k.surprisePct = grp.get<double>();
+            }
+            QuantileGrouping& q = out.quantileGroups;
+            q.keys = out.groupingKeys;
+            q.schemes.resize(static_cast<size_t>(grp.get<uint64_t>()));
+            q.labels.resize(q.schemes.size());
+            for (size_t i = 0; i < q.schemes.size(); ++i) {
+                q.schemes[i].name = str(grp.get<uint32_t>());
+                q.schemes[i].numGroups = grp.get<int32_t>();
+                q.schemes[i].trimFraction = grp.get<double>();
+                grp.getVector(q.labels[i]);
+            }
+
+            out.hasRun = (header.flags & 1u) != 0;
+            if (out.hasRun) {
+                ByteReader run = section(kRun);
+                out.model = static_cast<AbnormalReturnModel>(run.get<uint32_t>());
+                MarketModelFit& fit = out.fit;
+                fit.window.start = run.get<int32_t>();
+                fit.window.end = run.get<int32_t>();
+                run.getVector(fit.alpha);
+                run.getVector(fit.beta);
+                run.getVector(fit.residVar);
+                run.getVector(fit.marketMean);
+                run.getVector(fit.marketSxx);
+                run.getVector(fit.obs);
+
+                out.panel.reset(new ReturnPanel(panelResource));
+                ReturnPanel& panel = *out.panel;
+                panel.dayLo = run.get<int32_t>();
+                panel.dayHi = run.get<int32_t>();
+                panel.numEvents = static_cast<size_t>(run.get<uint64_t>());
+                vector<uint32_t> columns;
+                vector<uint64_t> groupBegin;
+                run.getVector(columns);
+                run.getVector(groupBegin);
+                run.getVector(panel.hasEstimation);
+                run.getVector(panel.stockRet);
+                run.getVector(panel.marketRet);
+                run.getVector(panel.abnormalRet);
+
+                size_t cells = static_cast<size_t>(panel.numDays()) * panel.numEvents;
+                if (columns.size() != panel.numEvents || panel.stockRet.size() != cells ||
+                    panel.marketRet.size() != cells || panel.abnormalRet.size() != cells) {
+                    throw runtime_error("return panel dimensions inconsistent");
+                }
+                panel.keys.resize(columns.size());
+                for (size_t e = 0; e < columns.size(); ++e) {
+                    if (columns[e] >= keys.size()) throw runtime_error("panel column of unknown event");
+                    panel.keys[e] = keys[columns[e]];
+                }
+                panel.groupBegin.assign(groupBegin.begin(), groupBegin.end());
+
+                ByteReader st = section(kStats);
+                int N = st.get<int32_t>();
+                uint32_t stdEstimate = st.get<uint32_t>();
+                if (stdEstimate > static_cast<uint32_t>(StdEstimate::Analytic)) throw runtime_error("unknown STD estimate");
+                GroupStats miss = getGroupStats(st);
+                GroupStats meet = getGroupStats(st);
+                GroupStats beat = getGroupStats(st);
+                EventTestResult missTests = getTests(st);
+                EventTestResult meetTests = getTests(st);
+                EventTestResult beatTests = getTests(st);
+                out.stats.reset(new StatCalculator(N));
+                out.stats->restore(std::move(miss), std::move(meet), std::move(beat),
+                                   std::move(missTests), std::move(meetTests), std::move(beatTests),
+                                   static_cast<StdEstimate>(stdEstimate));
+            }
+        } catch (const exception& ex) {
+            error = ex.what();
+            return false;
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "ReturnPanel.h"
+#include "StatCalculator.h"
+#include "StockGrouper.h"
+#include "StockRegistry.h"
+#include "StockStructure.h"
+
+namespace fre {
+
+    // Binary snapshot of the program state, so a restart skips Phase 1 and, when a run was
+    // saved, Option 1 as well.
+    //
+    // Layout: a 64-byte header, a table of sections, then the sections, each 8-byte aligned
+    // so the file can be memory-mapped and its arrays read in place. Every section carries
+    // its own checksum. The header records the format version and a fingerprint of the
+    // input CSVs; a snapshot of other inputs or another version is rejected, never patched.
+    //
+    // Sections: string table, events (earnings data, group, window, return series),
+    // shared price histories, benchmark history, grouping keys and quantile labels, and,
+    // after an Option 1 run, the model fit with the return panel and the group statistics.
+    const std::uint32_t kSnapshotVersion = 3;  // 2: the group statistics record their STD estimate
+                                               // 3: event prices only as a window of the shared history
+
+    // 64-bit checksum of a byte range, word at a time
+    std::uint64_t snapshotChecksum(const void* data, std::size_t size, std::uint64_t seed = 0);
+
+    // Checksum over the contents of the input files, in order; a missing file counts as empty.
+    // priceSource is the --import archive (empty for the network): its path and the size and
+    // modification time of its files are folded in, so state priced from one source is never
+    // restored for another.
+    std::uint64_t fingerprintInputs(const std::vector<std::string>& paths, const std::string& priceSource = "");
+
+    // fsync the file at path; then fsync the directory holding it, which makes a rename into
+    // that directory durable. False if either cannot be synced.
+    bool syncFile(const std::string& path);
+    bool syncParentDirectory(const std::string& path);
+
+    // State to save. The run fields are either all set or all null.
+    struct SnapshotSource {
+        const StockRegistry* registry = nullptr;
+        const PriceHistory* benchmark = nullptr;  // may be null before the first run
+        const std::vector<GroupingKey>* groupingKeys = nullptr;
+        const QuantileGrouping* quantileGroups = nullptr;
+
+        const ReturnPanel* panel = nullptr;
+        const MarketModelFit* fit = nullptr;
+        const StatCalculator* stats = nullptr;
+        AbnormalReturnModel model = AbnormalReturnModel::MarketAdjusted;
+    };
+
+    // State read back from a snapshot
+    struct SnapshotContents {
+        StockMap stocks;
+        PriceHistory benchmark;
+        std::vector<GroupingKey> groupingKeys;
+        QuantileGrouping quantileGroups;
+
+        bool hasRun = false;
+        AbnormalReturnModel model = AbnormalReturnModel::MarketAdjusted;
+        MarketModelFit fit;
+        std::unique_ptr<ReturnPanel> panel;
+        std::unique_ptr<StatCalculator> stats;
+    };
+
+    // Written to path + ".tmp", synced and renamed over path, then the directory is synced,
+    // so a crash never leaves a torn snapshot.
+    // False with error set on failure.
+    bool saveSnapshot(const std::string& path, std::uint64_t inputs,
+                      const SnapshotSource& source, std::string& error);
+
+    // False with error set if the file is missing, corrupt, of another version or of other
+    // inputs; out is then unspecified. The panel's arrays are allocated from panelResource.
+    bool loadSnapshot(const std::string& path, std::uint64_t inputs, SnapshotContents& out,
+                      std::pmr::memory_resource* panelResource, std::string& error);
+
+}
@@ -1,4 +1,5 @@
 #include "StatCalculator.h"
+#include "ThreadUtils.h"
 #include <cmath>
 #include <iostream>
 
@@ -37,26 +38,38 @@ namespace fre{
         stats.CAAR_mean.assign(T, 0.0);
         stats.CAAR_std.assign(T, 0.0);
 
+        // Per-sample sums, reduced over samples in a fixed order (parallel_reduce)
+        struct SampleSums {
+            Vector aar;
+            Vector caar;
+            int count;
+        };
+        const SampleSums zero{ Vector(T, 0.0), Vector(T, 0.0), 0 };
+        auto add = [](SampleSums a, const SampleSums& b) {
+            a.aar = a.aar + b.aar;
+            a.caar = a.caar + b.caar;
+            a.count += b.count;
+            return a;
+        };
+        auto valid = [&](int k) {
+            return static_cast<int>(AAR_samples[k].size()) == T &&
+                   static_cast<int>(CAAR_samples[k].size()) == T;
+        };
+
         // -----------------------------
         // Compute mean
         // -----------------------------
         // sum
-        int validSamples = 0;
-        for (int k = 0; k < K; ++k){ // K is the sample size 
-            const Vector& aar = AAR_samples[k]; // Extract inner time series
-            const Vector& caar = CAAR_samples[k];
-
-            if ((static_cast<int>(aar.size()) != T) ||
-                (static_cast<int>(caar.size()) != T)){
-                std::cerr << "[StatCalculator] Warning: sample length mismatch, skip one\n";
-                continue;
-            }
-        
-            stats.AAR_mean = stats.AAR_mean + aar;
-            stats.CAAR_mean = stats.CAAR_mean +caar;
-
-            ++validSamples; 
-        }
+        SampleSums sum = parallel_reduce(computePool(), IndexRange{0, static_cast<size_t>(K)}, zero,
+            [&](size_t k) { // K is the sample size 
+                if (!valid(k)) {
+                    std::cerr << "[StatCalculator] Warning: sample length mismatch, skip one\n";
+                    return zero;
+                }
+                return SampleSums{ AAR_samples[k], CAAR_samples[k], 1 }; // Extract inner time series
+            },
+            add);
+        int validSamples = sum.count;
 
         // Normalize to obtain mean
         if (validSamples == 0) { // defensive programming
@@ -64,33 +77,30 @@ namespace fre{
             return stats;  
         }
 
-        stats.AAR_mean = stats.AAR_mean / static_cast<double>(validSamples);
-        stats.CAAR_mean = stats.CAAR_mean / static_cast<double>(validSamples);
+        stats.AAR_mean = sum.aar / static_cast<double>(validSamples);
+        stats.CAAR_mean = sum.caar / static_cast<double>(validSamples);
 
         // -----------------------------
         // Compute standard deviation
         // -----------------------------
         if (validSamples > 1) { // defensive programming 
-            for (int k = 0; k < K; ++k) {
-                const Vector& aar  = AAR_samples[k];
-                const Vector& caar = CAAR_samples[k];
-
-                if (static_cast<int>(aar.size()) != T ||
-                    static_cast<int>(caar.size()) != T) {
-                    // This sample was also skipped during mean calculation
-                    continue;
-                }
-
-                // MatrixOperator.cpp
-                Vector diffA = aar  - stats.AAR_mean;
-                Vector diffC = caar - stats.CAAR_mean;
-                stats.AAR_std  = stats.AAR_std  + (diffA * diffA);
-                stats.CAAR_std = stats.CAAR_std + (diffC * diffC);
-            }
+            SampleSums sq = parallel_reduce(computePool(), IndexRange{0, static_cast<size_t>(K)}, zero,
+                [&](size_t k) {
+                    if (!valid(k)) {
+                        // This sample was also skipped during mean calculation
+                        return zero;
+                    }
+
+                    // MatrixOperator.cpp
+                    Vector diffA = AAR_samples[k]  - stats.AAR_mean;
+                    Vector diffC = CAAR_samples[k] - stats.CAAR_mean;
+                    return SampleSums{ diffA * diffA, diffC * diffC, 1 };
+                },
+                add);
 
             for (int t = 0; t < T; ++t) {
-                stats.AAR_std[t]  = std::sqrt(stats.AAR_std[t]  / (validSamples - 1)); // Sample standard deviation: divide by (validSamples - 1)
-                stats.CAAR_std[t] = std::sqrt(stats.CAAR_std[t] / (validSamples - 1)); // Dependency on MatrixOperator.cpp
+                stats.AAR_std[t]  = std::sqrt(sq.aar[t]  / (validSamples - 1)); // Sample standard deviation: divide by (validSamples - 1)
+                stats.CAAR_std[t] = std::sqrt(sq.caar[t] / (validSamples - 1)); // Dependency on MatrixOperator.cpp
             }
         }
         else {
@@ -107,9 +117,13 @@ namespace fre{
                                             const GroupBootstrapResult& meetResult,
                                             const GroupBootstrapResult& beatResult)
     {
-        missStats_ = computeForOneGroup(missResult);
-        meetStats_ = computeForOneGroup(meetResult);
-        beatStats_ = computeForOneGroup(beatResult);
+        // The three groups are independent; each one also reduces its samples in parallel
+        const GroupBootstrapResult* inputs[3] = { &missResult, &meetResult, &beatResult };
+        GroupStats* outputs[3] = { &missStats_, &meetStats_, &beatStats_ };
+        parallel_for(computePool(), IndexRange{0, 3}, 1, [&](size_t g) {
+            *outputs[g] = computeForOneGroup(*inputs[g]);
+        });
+        stdEstimate_ = StdEstimate::Bootstrap;
 
         // Prepare data for gnuplot (using CAAR_mean only)
         // Order: [0] = Beat, [1] = Meet, [2] = Miss
@@ -121,6 +135,33 @@ namespace fre{
         buildResultMatrix();
     }
 
+    void StatCalculator::restore(GroupStats missStats, GroupStats meetStats, GroupStats beatStats,
+                                 EventTestResult missTests, EventTestResult meetTests, EventTestResult beatTests,
+                                 StdEstimate stdEstimate)
+    {
+        stdEstimate_ = stdEstimate;
+        missStats_ = std::move(missStats);
+        meetStats_ = std::move(meetStats);
+        beatStats_ = std::move(beatStats);
+        missTests_ = std::move(missTests);
+        meetTests_ = std::move(meetTests);
+        beatTests_ = std::move(beatTests);
+
+        caarMeanForGnuplot_.assign({ beatStats_.CAAR_mean, meetStats_.CAAR_mean, missStats_.CAAR_mean });
+        buildResultMatrix();
+    }
+
+    // Panel columns are ordered Miss, Meet, Beat, so each group is one contiguous range
+    void StatCalculator::computeEventStudyTests(const ReturnPanel& panel,
+                                                const MarketModelFit& fit,
+                                                AbnormalReturnModel model)
+    {
+        if (panel.groupBegin.size() < 4) return;
+        missTests_ = runEventStudyTests(panel, fit, model, N_, panel.groupBegin[0], panel.groupBegin[1]);
+        meetTests_ = runEventStudyTests(panel, fit, model, N_, panel.groupBegin[1], panel.groupBegin[2]);
+        beatTests_ = runEventStudyTests(panel, fit, model, N_, panel.groupBegin[2], panel.groupBegin[3]);
+    }
+
     // Reduce a full GroupStats object into a single summary row:
     // (avg AAR mean, avg AAR std, final CAAR mean, final CAAR std)
     void StatCalculator::reduceStats(const GroupStats& stats, Vector& row){
@@ -152,4 +193,48 @@ namespace fre{
         reduceStats(beatStats_, resultMatrix[2]);
     }
 
-}
+    // Reduce each sample size of a sweep to summary dispersion figures.
+    // Rows with no usable resamples are dropped.
+    std::vector<SampleSizeDispersion> StatCalculator::computeSampleSizeDispersion(const SampleSizeSweepResult& sweep)
+    {
+        std::vector<SampleSizeDispersion> rows;
+        size_t K = std::min(sweep.sampleSizes.size(), sweep.results.size());
+
+        for (size_t k = 0; k < K; ++k) {
+            GroupStats stats = computeForOneGroup(sweep.results[k]);
+            if (stats.AAR_std.empty()) continue;
+
+            Vector row(4, 0.0);
+            reduceStats(stats, row);
+
+            SampleSizeDispersion d;
+            d.sampleSize    = sweep.sampleSizes[k];
+            d.numResamples  = static_cast<int>(sweep.results[k].AAR_samples.size());
+            d.avgAARStd     = row[1];
+            d.finalCAARStd  = row[3];
+            d.scaledCAARStd = row[3] * std::sqrt(static_cast<double>(d.sampleSize));
+            rows.push_back(d);
+        }
+        return rows;
+    }
+
+    // Fit log(finalCAARStd) = c + b * log(M) and return b.
+    // Returns NaN when fewer than two sizes have a positive dispersion.
+    double StatCalculator::dispersionScalingExponent(const std::vector<SampleSizeDispersion>& rows)
+    {
+        double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+        int n = 0;
+        for (const auto& r : rows) {
+            if (r.sampleSize <= 0 || r.finalCAARStd <= 0.0) continue;
+            double x = std::log(static_cast<double>(r.sampleSize));
+            double y = std::log(r.finalCAARStd);
+            sx += x; sy += y; sxx += x * x; sxy += x * y;
+            ++n;
+        }
+
+        double denom = n * sxx - sx * sx;
+        if (n < 2 || denom == 0.0) return std::nan("");
+        return (n * sxy - sx * sy) / denom;
+    }
+
+}
\ No newline at end of file
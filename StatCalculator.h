@@ -1,8 +1,10 @@
 #pragma once 
 
+#include <cstdint>
 #include <vector>
 #include "MatrixOperator.h"
 #include "Bootstrapper.h"
+#include "EventStudyTests.h"
 
 namespace fre{
     struct GroupStats{
@@ -13,6 +15,21 @@ namespace fre{
         Vector CAAR_std;
     };
 
+    // Where the AAR_std / CAAR_std of a StatCalculator come from
+    enum class StdEstimate : std::uint32_t {
+        Bootstrap = 0,  // spread of the bootstrap resamples (Option 1)
+        Analytic = 1    // sd / sqrt(M) of the exact group sums (a refresh or a running Option 1)
+    };
+
+    // Dispersion of one group's bootstrap paths at a single sample size M
+    struct SampleSizeDispersion{
+        int sampleSize;
+        int numResamples;
+        double avgAARStd;     // AAR_std averaged over the event window
+        double finalCAARStd;  // CAAR_std on the last event day
+        double scaledCAARStd; // finalCAARStd * sqrt(M), flat if dispersion ~ 1/sqrt(M)
+    };
+
     class StatCalculator{
         private:  
             int N_;
@@ -20,6 +37,12 @@ namespace fre{
             GroupStats meetStats_;
             GroupStats beatStats_;
             Matrix resultMatrix; // Aggregated summary matrix for output
+            StdEstimate stdEstimate_ = StdEstimate::Bootstrap;
+
+            // Parametric and rank tests over the return panel, per group
+            EventTestResult missTests_;
+            EventTestResult meetTests_;
+            EventTestResult beatTests_;
 
             // Data structure prepared specifically for gnuplot visualization
             // Stores CAAR_mean for three groups in the order:
@@ -44,13 +67,34 @@ namespace fre{
                          const GroupBootstrapResult& beatResult);
             
             void buildResultMatrix();
+
+            // Reinstate per-group results computed elsewhere (snapshot restore, group sums) and
+            // how their STD was estimated; the summary matrix and the plot series are rebuilt
+            void restore(GroupStats missStats, GroupStats meetStats, GroupStats beatStats,
+                         EventTestResult missTests, EventTestResult meetTests, EventTestResult beatTests,
+                         StdEstimate stdEstimate);
+
+            // Run the event-study test suite for each group's columns of the return panel
+            void computeEventStudyTests(const ReturnPanel& panel,
+                                        const MarketModelFit& fit,
+                                        AbnormalReturnModel model);
+
+            // Reduce a sample-size sweep into one dispersion row per sample size
+            std::vector<SampleSizeDispersion> computeSampleSizeDispersion(const SampleSizeSweepResult& sweep);
+
+            // Least-squares slope of log(final CAAR_std) on log(M); about -0.5 under iid sampling
+            static double dispersionScalingExponent(const std::vector<SampleSizeDispersion>& rows);
             
             // accessor
             int getN() const {return N_;}
+            StdEstimate getStdEstimate() const {return stdEstimate_;}
             const GroupStats& getMissStats() const {return missStats_;}
             const GroupStats& getMeetStats() const {return meetStats_;}
             const GroupStats& getBeatStats() const {return beatStats_;}
             const Matrix& getResultMatrix() const { return resultMatrix;}
+            const EventTestResult& getMissTests() const {return missTests_;}
+            const EventTestResult& getMeetTests() const {return meetTests_;}
+            const EventTestResult& getBeatTests() const {return beatTests_;}
             
             // Accessor for gnuplot-ready CAAR mean time series
             const std::vector<Vector>& getCAARMeanForGnuplot() const { return caarMeanForGnuplot_; }
@@ -4,12 +4,35 @@
 #include <map>
 #include <unordered_map>
 #include <cmath>
+#include <numeric>
+
+#include "ThreadUtils.h"
 
 using namespace std;
 using namespace fre;
 
 
-unordered_map<string, vector<Stock>> StockGrouper::splitStocksBySector(const map<string, Stock>& stockMap) 
+// Split `count` surprise-sorted stocks under one scheme.
+// Returns numGroups+1 boundaries into the sorted order: group g is [b[g], b[g+1]);
+// everything before b[0] and from b[numGroups] on is trimmed.
+// The last group absorbs the remainder, as the original tercile split did.
+static vector<size_t> quantileBounds(size_t count, const GroupingScheme& scheme)
+{
+    int k = max(scheme.numGroups, 1);
+    size_t removeCountPerSide = static_cast<size_t>(ceil(count * scheme.trimFraction));
+    if (2 * removeCountPerSide > count) removeCountPerSide = count / 2;
+
+    size_t remainingCount = count - 2 * removeCountPerSide;
+    size_t groupSize = remainingCount / k;
+
+    vector<size_t> bounds(k + 1);
+    for (int g = 0; g < k; ++g) bounds[g] = removeCountPerSide + g * groupSize;
+    bounds[k] = count - removeCountPerSide;
+    return bounds;
+}
+
+
+unordered_map<string, vector<Stock>> StockGrouper::splitStocksBySector(const StockMap& stockMap) 
 {
     unordered_map<string, vector<Stock>> sectorStockMap;
     for (const auto& pair : stockMap) 
@@ -25,72 +48,70 @@ unordered_map<string, vector<Stock>> StockGrouper::splitStocksBySector(const map
 void StockGrouper::processSingleSector(vector<Stock>& sectorStocks) 
 {
     if (sectorStocks.empty()) return;
-    sort(sectorStocks.begin(), sectorStocks.end()); 
-    
-    size_t totalCount = sectorStocks.size();
-    size_t removeCountPerSide = ceil(totalCount * 0.02); 
-    size_t remainingCount = totalCount - 2 * removeCountPerSide;
-    
-    vector<Stock> validStocks;
-    if (removeCountPerSide > 0) 
-    {
-        auto startIt = sectorStocks.begin() + removeCountPerSide;
-        auto endIt = sectorStocks.end() - removeCountPerSide;
-        validStocks.assign(startIt, endIt);
-    }
-    else {validStocks = sectorStocks;}
 
-    if (validStocks.empty()) return;
+    // Sort indices by surprise instead of moving whole Stock objects around
+    vector<size_t> order(sectorStocks.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(),
+                [&](size_t a, size_t b) { return sectorStocks[a] < sectorStocks[b]; });
 
-    size_t groupSize = remainingCount / 3;
-    
-    auto beginIt = validStocks.begin();
-    vector<Stock> sectorMiss(beginIt, beginIt + groupSize);
-    vector<Stock> sectorMeet(beginIt + groupSize, beginIt + 2 * groupSize);
-    vector<Stock> sectorBeat(beginIt + 2 * groupSize, validStocks.end());
+    GroupingScheme terciles{"Terciles", 3, 0.02};
+    vector<size_t> b = quantileBounds(order.size(), terciles);
+    if (b[0] == b[3]) return;
 
-    for (auto& stock : sectorMiss) {stock.setGroup("Miss");}
-    for (auto& stock : sectorMeet) {stock.setGroup("Meet");}
-    for (auto& stock : sectorBeat) {stock.setGroup("Beat");}
+    vector<Stock>* targets[3] = { &missGroup, &meetGroup, &beatGroup };
+    const EventGroup tags[3] = { EventGroup::Miss, EventGroup::Meet, EventGroup::Beat };
 
-    missGroup.insert(missGroup.end(), sectorMiss.begin(), sectorMiss.end());
-    meetGroup.insert(meetGroup.end(), sectorMeet.begin(), sectorMeet.end());
-    beatGroup.insert(beatGroup.end(), sectorBeat.begin(), sectorBeat.end());
+    for (int g = 0; g < 3; ++g)
+    {
+        for (size_t i = b[g]; i < b[g + 1]; ++i)
+        {
+            Stock& stock = sectorStocks[order[i]];
+            stock.setGroup(tags[g]);
+            targets[g]->push_back(stock);
+        }
+    }
 }
 
 
-void StockGrouper::updateMapWithGroups(map<string, Stock>& stockMap) const
+void StockGrouper::updateMapWithGroups(StockMap& stockMap) const
 {
     for (const auto& s : beatGroup) 
     {
-        auto it = stockMap.find(s.getTicker());
-        if (it != stockMap.end()) {it->second.setGroup("Beat");}
+        auto it = stockMap.find(s.getKey());
+        if (it != stockMap.end()) {it->second.setGroup(EventGroup::Beat);}
     }
 
     for (const auto& s : meetGroup) 
     {
-        auto it = stockMap.find(s.getTicker());
-        if (it != stockMap.end()) {it->second.setGroup("Meet");}
+        auto it = stockMap.find(s.getKey());
+        if (it != stockMap.end()) {it->second.setGroup(EventGroup::Meet);}
     }
 
     for (const auto& s : missGroup) 
     {
-        auto it = stockMap.find(s.getTicker());
-        if (it != stockMap.end()) {it->second.setGroup("Miss");}
+        auto it = stockMap.find(s.getKey());
+        if (it != stockMap.end()) {it->second.setGroup(EventGroup::Miss);}
     }
 
+    // Trimmed outliers of a sector stay in the map ungrouped (EventGroup::None): they are
+    // still fetched, so the quantile ladder can bucket them under schemes with a lighter
+    // trim. Events no scheme can label ("Other", no sector) are removed, as before.
+    int ungroupedCount = 0;
     int removedCount = 0;
-    for (auto it = stockMap.begin(); it != stockMap.end(); ) 
+    for (auto it = stockMap.begin(); it != stockMap.end(); )
     {
-        if (it->second.getGroup().empty()) 
-        {
-            it = stockMap.erase(it); 
-            removedCount++;
-        } else {
+        if (it->second.getGroup() != EventGroup::None) {++it; continue;}
+        if (isGroupedSector(it->second.getSector())) {
+            ++ungroupedCount;
             ++it;
+        } else {
+            it = stockMap.erase(it);
+            removedCount++;
         }
     }
-    cout << "[StockGrouper] Map updated. Removed " << removedCount << " outliers." << endl;
+    cout << "[StockGrouper] Map updated. Kept " << ungroupedCount << " outliers ungrouped, removed "
+         << removedCount << " events without a sector." << endl;
 }
 
 
@@ -98,13 +119,13 @@ void StockGrouper::processAllSectors(unordered_map<string, vector<Stock>>& secto
 {
     for (auto& pair : sectorMap) 
     {
-        if (pair.first == "Other" || pair.first.empty()) {continue;}
+        if (!isGroupedSector(pair.first)) {continue;}
         processSingleSector(pair.second);
     }
 }
 
 
-int StockGrouper::extractValidGroups(const map<string, Stock>& sourceMap, vector<Stock>& outBeat, vector<Stock>& outMeet, vector<Stock>& outMiss)
+int StockGrouper::extractValidGroups(const StockRegistry& registry, vector<Stock>& outBeat, vector<Stock>& outMeet, vector<Stock>& outMiss)
 {
     outBeat.clear();
     outMeet.clear();
@@ -112,21 +133,104 @@ int StockGrouper::extractValidGroups(const map<string, Stock>& sourceMap, vector
 
     int validCount = 0;
 
-    for (const auto& pair : sourceMap) 
+    // Each event is copied under its registry lock, so a concurrent update is seen whole or not at all
+    for (EventId id = 0; id < registry.size(); ++id) 
     {
-        const Stock& s = pair.second;
-        if (s.getPrices().empty()) {continue;}
-        string g = s.getGroup(); 
-        if (g == "Beat")      outBeat.push_back(s);
-        else if (g == "Meet") outMeet.push_back(s);
-        else if (g == "Miss") outMiss.push_back(s);
-        validCount++;
+        registry.read(id, [&](const Stock& s) {
+            if (!hasReturns(s)) {return;}
+            EventGroup g = s.getGroup(); 
+            if (g == EventGroup::Beat)      outBeat.push_back(s);
+            else if (g == EventGroup::Meet) outMeet.push_back(s);
+            else if (g == EventGroup::Miss) outMiss.push_back(s);
+            else return;  // ungrouped outlier
+            validCount++;
+        });
     }
 
     return validCount;
 }
 
 
+vector<GroupingScheme> StockGrouper::defaultSchemes()
+{
+    return {
+        {"Terciles",  3,  0.02},
+        {"Quintiles", 5,  0.02},
+        {"Deciles",   10, 0.02},
+    };
+}
+
+
+vector<GroupingKey> StockGrouper::buildGroupingKeys(const StockMap& stockMap)
+{
+    vector<GroupingKey> keys;
+    keys.reserve(stockMap.size());
+    for (const auto& pair : stockMap)
+    {
+        const Stock& s = pair.second;
+        keys.push_back({s.getTicker(), s.getAnnouncementDate(), s.getSector(), s.getSurprisePercent()});
+    }
+    return keys;
+}
+
+
+// Label every key under every scheme in one call.
+// Each sector's keys are sorted once; all schemes are then pure index arithmetic on that order.
+// Sectors are independent and run in parallel; each writes only its own label slots.
+QuantileGrouping StockGrouper::assignQuantileGroups(const vector<GroupingKey>& keys, const vector<GroupingScheme>& schemes)
+{
+    QuantileGrouping result;
+    result.schemes = schemes;
+    result.keys = keys;
+    result.labels.assign(schemes.size(), vector<int>(keys.size(), -1));
+
+    unordered_map<string, vector<size_t>> sectorIdx;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        const string& sector = keys[i].sector;
+        if (!isGroupedSector(sector)) {continue;}
+        sectorIdx[sector].push_back(i);
+    }
+    if (sectorIdx.empty() || schemes.empty()) return result;
+
+    vector<vector<size_t>*> sectors;
+    sectors.reserve(sectorIdx.size());
+    for (auto& pair : sectorIdx) sectors.push_back(&pair.second);
+
+    // One sector per chunk: sectors are few and uneven, idle workers steal the rest
+    parallel_for(computePool(), IndexRange{0, sectors.size()}, 1, [&](size_t k)
+    {
+        vector<size_t>& order = *sectors[k];
+        stable_sort(order.begin(), order.end(),
+                    [&](size_t a, size_t b) { return keys[a].surprisePct < keys[b].surprisePct; });
+
+        for (size_t s = 0; s < schemes.size(); ++s)
+        {
+            vector<size_t> b = quantileBounds(order.size(), schemes[s]);
+            vector<int>& labels = result.labels[s];
+            for (int g = 0; g + 1 < static_cast<int>(b.size()); ++g)
+            {
+                for (size_t i = b[g]; i < b[g + 1]; ++i) labels[order[i]] = g;
+            }
+        }
+    });
+
+    return result;
+}
+
+
+string StockGrouper::labelName(const GroupingScheme& scheme, int label)
+{
+    if (label < 0) return "";
+    if (scheme.numGroups == 3)
+    {
+        const char* tags[3] = { "Miss", "Meet", "Beat" };
+        return tags[label];
+    }
+    return "Q" + to_string(label + 1);
+}
+
+
 void StockGrouper::printGroupSummary() const 
 {
     cout << "=== Final Stock Group Summary ===" << endl;
@@ -4,10 +4,39 @@
 #include <map>
 #include <unordered_map>
 #include "StockStructure.h"
+#include "StockRegistry.h"
 
 using namespace std;
 using namespace fre;
 
+// One quantile grouping rule applied within each sector:
+// drop trimFraction of the stocks on each side, then split the rest into numGroups
+struct GroupingScheme
+{
+    string name;
+    int numGroups;
+    double trimFraction; // per side, e.g. 0.02
+};
+
+// Lightweight sort key for one event; grouping never touches the heavy Stock objects
+struct GroupingKey
+{
+    string ticker;
+    string date;
+    string sector;
+    double surprisePct;
+};
+
+// Group labels for every scheme, aligned with keys.
+// labels[s][i] is the quantile of keys[i] under schemes[s] (0 = lowest surprise),
+// or -1 when the stock is trimmed or has no usable sector.
+struct QuantileGrouping
+{
+    vector<GroupingScheme> schemes;
+    vector<GroupingKey> keys;
+    vector<vector<int>> labels;
+};
+
 class StockGrouper 
 {
     private:
@@ -18,11 +47,22 @@ class StockGrouper
     public:
     StockGrouper() {}
 
-    static unordered_map<string, vector<Stock>> splitStocksBySector(const map<string, Stock>& stockMap);
+    // "Other" and sector-less events are never grouped, under any scheme
+    static bool isGroupedSector(const string& sector) { return !sector.empty() && sector != "Other"; }
+    static unordered_map<string, vector<Stock>> splitStocksBySector(const StockMap& stockMap);
     void processSingleSector(vector<Stock>& sectorStocks);
-    void updateMapWithGroups(map<string, Stock>& stockMap) const;
+    void updateMapWithGroups(StockMap& stockMap) const;
     void processAllSectors(unordered_map<string, vector<Stock>>& sectorMap);
-    static int extractValidGroups(const map<string, Stock>& sourceMap, vector<Stock>& outBeat, vector<Stock>& outMeet, vector<Stock>& outMiss);
+    // The rule every bootstrap draws by (Option 1, shards, batch scenarios, the server):
+    // an event takes part iff it has prices and abnormal returns; groups keep registry order
+    static bool hasReturns(const Stock& s) { return !s.getPrices().empty() && !s.getAbnormReturns().empty(); }
+    static int extractValidGroups(const StockRegistry& registry, vector<Stock>& outBeat, vector<Stock>& outMeet, vector<Stock>& outMiss);
+
+    // --- Quantile grouping engine ---
+    static vector<GroupingScheme> defaultSchemes();  // terciles, quintiles, deciles with 2% trim
+    static vector<GroupingKey> buildGroupingKeys(const StockMap& stockMap);
+    static QuantileGrouping assignQuantileGroups(const vector<GroupingKey>& keys, const vector<GroupingScheme>& schemes);
+    static string labelName(const GroupingScheme& scheme, int label);  // Miss/Meet/Beat for terciles, Q1..Qk otherwise
     
     void printGroupSummary() const;
     void printSectorStockCount(const unordered_map<string, vector<Stock>>& sectorMap) const;
@@ -30,4 +70,4 @@ class StockGrouper
     const vector<Stock>& getMissGroup() const { return missGroup; }
     const vector<Stock>& getMeetGroup() const { return meetGroup; }
     const vector<Stock>& getBeatGroup() const { return beatGroup; }
-};
\ No newline at end of file
+};
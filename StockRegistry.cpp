@@ -0,0 +1,55 @@
+#include "StockRegistry.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace fre {
+
+    StockRegistry::StockRegistry() {}
+
+    void StockRegistry::assign(StockMap&& stocks)
+    {
+        keys_.clear();
+        stocks_.clear();
+        tickerIndex_.clear();
+        keys_.reserve(stocks.size());
+        stocks_.reserve(stocks.size());
+
+        // Map order is (ticker, date), so each ticker's ids come out contiguous
+        for (auto it = stocks.begin(); it != stocks.end(); it = stocks.erase(it)) {
+            EventId id = static_cast<EventId>(keys_.size());
+            auto r = tickerIndex_.emplace(it->first.first, EventIdRange{id, id});
+            ++r.first->second.end;
+
+            keys_.push_back(it->first);
+            stocks_.push_back(std::move(it->second));
+        }
+
+        versions_.reset(new atomic<uint64_t>[keys_.size()]);
+        for (size_t i = 0; i < keys_.size(); ++i) versions_[i].store(0, memory_order_relaxed);
+    }
+
+    EventId StockRegistry::find(const EventKey& key) const
+    {
+        EventIdRange r = findTicker(key.first);
+        auto first = keys_.begin() + r.begin;
+        auto last = keys_.begin() + r.end;
+        auto it = lower_bound(first, last, key);
+        if (it == last || *it != key) return kNoEvent;
+        return static_cast<EventId>(it - keys_.begin());
+    }
+
+    EventIdRange StockRegistry::findTicker(const string& ticker) const
+    {
+        auto it = tickerIndex_.find(ticker);
+        return it == tickerIndex_.end() ? EventIdRange() : it->second;
+    }
+
+    Stock StockRegistry::snapshot(EventId id) const
+    {
+        lock_guard<mutex> lock(stripe(id));
+        return stocks_[id];
+    }
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "StockStructure.h"
+
+namespace fre {
+
+    // Stable integer id of one event, assigned when the universe is frozen into the registry
+    typedef std::uint32_t EventId;
+    const EventId kNoEvent = static_cast<EventId>(-1);
+
+    // Contiguous ids [begin, end), e.g. all events of one ticker
+    struct EventIdRange {
+        EventId begin = 0;
+        EventId end = 0;
+        std::size_t size() const { return end - begin; }
+        bool empty() const { return begin == end; }
+    };
+
+    // Event universe for the run phase, replacing StockMap once loading and grouping are done.
+    // Ids follow (ticker, date) order, so a ticker's events are one contiguous range and
+    // id order equals the old map iteration order. Keys and ids never change after assign();
+    // each Stock is guarded by one of kStripes striped locks, so writers on different
+    // events rarely meet and a reader always sees a whole update of one event.
+    class StockRegistry {
+    public:
+        StockRegistry();
+        StockRegistry(const StockRegistry&) = delete;
+        StockRegistry& operator=(const StockRegistry&) = delete;
+
+        // Freeze a loaded universe. Not safe while any other thread uses the registry.
+        void assign(StockMap&& stocks);
+
+        std::size_t size() const { return keys_.size(); }
+        bool empty() const { return keys_.empty(); }
+
+        // Immutable after assign(), no lock needed
+        const EventKey& key(EventId id) const { return keys_[id]; }
+        EventId find(const EventKey& key) const;                // kNoEvent if absent
+        EventIdRange findTicker(const std::string& ticker) const;  // hash lookup, empty if absent
+
+        // Copy of one event, consistent with respect to concurrent updates
+        Stock snapshot(EventId id) const;
+
+        // Run fn on one event under its stripe lock; keep fn short
+        template <class F>
+        auto read(EventId id, F&& fn) const -> decltype(fn(std::declval<const Stock&>())) {
+            std::lock_guard<std::mutex> lock(stripe(id));
+            return fn(stocks_[id]);
+        }
+
+        template <class F>
+        void update(EventId id, F&& fn) {
+            {
+                std::lock_guard<std::mutex> lock(stripe(id));
+                fn(stocks_[id]);
+            }
+            versions_[id].fetch_add(1, std::memory_order_release);
+        }
+
+        // Number of completed updates of one event; lets a reader skip unchanged events
+        std::uint64_t version(EventId id) const { return versions_[id].load(std::memory_order_acquire); }
+
+    private:
+        static const std::size_t kStripes = 64;
+        struct alignas(64) Stripe {
+            std::mutex m;
+        };
+
+        std::mutex& stripe(EventId id) const { return stripes_[id % kStripes].m; }
+
+        std::vector<EventKey> keys_;
+        std::vector<Stock> stocks_;
+        std::unique_ptr<std::atomic<std::uint64_t>[]> versions_;
+        std::unordered_map<std::string, EventIdRange> tickerIndex_;
+        mutable std::array<Stripe, kStripes> stripes_;
+    };
+
+}
@@ -1,19 +1,169 @@
 #include "StockStructure.h"
 #include "MatrixOperator.h"
+#include "LogKernel.h"
+#include "ThreadUtils.h"
 #include <string>
 #include <vector>
 #include <cmath>
 #include <iomanip> 
+#include <cstdio>
+#include <stdexcept>
 
 namespace fre {
 
-    void Stock::setPrices(const vector<PriceData>& pdata) {
-        PriceSeries = pdata;
+    // --- Dates as day numbers (proleptic Gregorian, days since 1970-01-01) ---
+    static DayNumber daysFromCivil(int y, unsigned m, unsigned d) {
+        y -= m <= 2;
+        const int era = (y >= 0 ? y : y - 399) / 400;
+        const unsigned yoe = static_cast<unsigned>(y - era * 400);
+        const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<int>(doe) - 719468;
     }
 
-    void Stock::setStartEndDate(const string& s, const string& e) {
-        WindowStart = s;
-        WindowEnd = e;
+    DayNumber toDayNumber(const string& date) {
+        // Three numeric fields separated by '-' or '/', e.g. 2025-01-31 or 2025/1/31
+        int parts[3] = {0, 0, 0};
+        int field = 0, digits = 0;
+        for (char ch : date) {
+            if (ch >= '0' && ch <= '9') {
+                parts[field] = parts[field] * 10 + (ch - '0');
+                if (++digits > 4) return kNoDay;
+            } else if ((ch == '-' || ch == '/') && digits > 0 && field < 2) {
+                ++field;
+                digits = 0;
+            } else {
+                return kNoDay;
+            }
+        }
+        if (field != 2 || digits == 0) return kNoDay;
+        if (parts[1] < 1 || parts[1] > 12 || parts[2] < 1 || parts[2] > 31) return kNoDay;
+        return daysFromCivil(parts[0], static_cast<unsigned>(parts[1]), static_cast<unsigned>(parts[2]));
+    }
+
+    string formatDay(DayNumber day) {
+        if (day == kNoDay) return "";
+        const int z = day + 719468;
+        const int era = (z >= 0 ? z : z - 146096) / 146097;
+        const unsigned doe = static_cast<unsigned>(z - era * 146097);
+        const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const unsigned mp = (5 * doy + 2) / 153;
+        const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+        const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+        const int y = static_cast<int>(yoe) + era * 400 + (m <= 2);
+
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%04d-%02u-%02u", y, m, d);
+        return buf;
+    }
+
+    // --- Interned strings ---
+    StringTable::StringTable() : size_(0) {
+        intern("");
+    }
+
+    Symbol StringTable::intern(const string& s) {
+        lock_guard<mutex> lock(mutex_);
+        auto it = index_.find(s);
+        if (it != index_.end()) return it->second;
+
+        uint32_t id = size_.load(memory_order_relaxed);
+        size_t chunk = id >> kChunkBits;
+        if (chunk >= kMaxChunks) throw runtime_error("StringTable is full");
+        if (!chunks_[chunk]) chunks_[chunk].reset(new string[kChunkSize]);
+
+        chunks_[chunk][id & (kChunkSize - 1)] = s;
+        index_.emplace(s, id);
+        size_.store(id + 1, memory_order_release);
+        return id;
+    }
+
+    StringTable& symbols() {
+        static StringTable table;
+        return table;
+    }
+
+    const char* eventGroupName(EventGroup g) {
+        switch (g) {
+            case EventGroup::Miss: return "Miss";
+            case EventGroup::Meet: return "Meet";
+            case EventGroup::Beat: return "Beat";
+            default:               return "";
+        }
+    }
+
+    // --- Fused return computation ---
+    void computeReturnSeries(const PriceView& px, const double* benchReturns, ReturnSeries& out,
+                             const double* logReturns) {
+        const size_t n = px.size();
+        const double* p = px.prices();
+        const size_t m = n > 0 ? n - 1 : 0;
+
+        out.cumReturns.resize(m);
+        out.abnormReturns.resize(benchReturns ? m : 0);
+        if (logReturns) {
+            out.logReturns.assign(logReturns, logReturns + m);
+        } else {
+            out.logReturns.resize(m);
+            fre::logReturns(p, n, out.logReturns.data());
+        }
+
+        const double* lr = out.logReturns.data();
+        double* cr = out.cumReturns.data();
+        double accum = 0.0;
+        if (benchReturns) {
+            double* ab = out.abnormReturns.data();
+            for (size_t i = 0; i < m; ++i) {
+                accum += lr[i];
+                cr[i] = accum;
+                ab[i] = lr[i] - benchReturns[i];
+            }
+        } else {
+            for (size_t i = 0; i < m; ++i) {
+                accum += lr[i];
+                cr[i] = accum;
+            }
+        }
+    }
+
+    void computeReturnSeriesBatch(size_t n, const PriceView* px, const double* const* bench,
+                                  ReturnSeries* out, const double* const* logReturns) {
+        parallel_for(computePool(), IndexRange{0, n}, 32, [&](size_t i) {
+            computeReturnSeries(px[i], bench ? bench[i] : nullptr, out[i], logReturns ? logReturns[i] : nullptr);
+        });
+    }
+
+    // --- Stock ---
+    void Stock::setPrices(const PriceHistory& history) {
+        History = make_shared<const PriceHistory>(history);
+        WindowFirst = 0;
+        WindowCount = static_cast<uint32_t>(history.size());
+        ReturnsReady = false;
+    }
+
+    void Stock::setPriceWindow(const shared_ptr<const PriceHistory>& history, size_t first, size_t count) {
+        History = history;
+        WindowFirst = static_cast<uint32_t>(first);
+        WindowCount = history ? static_cast<uint32_t>(count) : 0;
+        ReturnsReady = false;
+    }
+
+    void Stock::clearPrices() {
+        History.reset();
+        WindowFirst = 0;
+        WindowCount = 0;
+        ReturnsReady = false;
+    }
+
+    PriceView Stock::getPrices() const {
+        if (!History || WindowCount == 0) return PriceView();
+        return History->view(WindowFirst, WindowCount);
+    }
+
+    void Stock::setStartEndDate(DayNumber s, DayNumber e) {
+        WindowStartDay = s;
+        WindowEndDay = e;
     }
 
     void Stock::setEarningData(const string& ticker_,
@@ -22,69 +172,57 @@ namespace fre {
                                double est_, double rpt_,
                                double spr_, double sprpct_) 
     {
-        ticker = ticker_;
-        AnnDate = ann_;
-        PeriodEndDate = pend_;
+        TickerSym = symbols().intern(ticker_);
+        AnnDay = toDayNumber(ann_);
+        PeriodEndDay = toDayNumber(pend_);
         EstEps = est_;
         RptEps = rpt_;
         EpsSurprise = spr_;
         EpsSurprisePct = sprpct_;
     }
 
-    Vector Stock::getAdjClosePrice() {
-        int n = PriceSeries.size();
-        Vector temp(n);
-
-        for (int i = 0; i < n; ++i) {
-            temp[i] = PriceSeries[i].price;
-        }
-
-        AdjPricesVec = temp;
-        return AdjPricesVec;
+    void Stock::setEarningData(Symbol ticker_, DayNumber ann_, DayNumber pend_,
+                               double est_, double rpt_, double spr_, double sprpct_)
+    {
+        TickerSym = ticker_;
+        AnnDay = ann_;
+        PeriodEndDay = pend_;
+        EstEps = est_;
+        RptEps = rpt_;
+        EpsSurprise = spr_;
+        EpsSurprisePct = sprpct_;
     }
 
     bool Stock::operator<(const Stock& rhs) const {
         return EpsSurprisePct < rhs.EpsSurprisePct;
     }
 
-    Vector Stock::CalcReturns() {
-        Vector px = AdjPricesVec;
-        int n = px.size();
-
-        Vector r;
-        for (int i = 1; i < n; ++i) {
-            double logr = log(px[i] / px[i - 1]);
-            r.push_back(logr);
-        }
+    void Stock::computeReturns(const double* benchmarkReturns) {
+        ReturnSeries rs;
+        computeReturnSeries(getPrices(), benchmarkReturns, rs);
+        LogReturnVec = std::move(rs.logReturns);
+        CumReturnVec = std::move(rs.cumReturns);
+        if (benchmarkReturns) AbReturnVec = std::move(rs.abnormReturns);
+        ReturnsReady = true;
+    }
 
-        LogReturnVec = r;
+    const Vector& Stock::CalcReturns() {
+        if (!ReturnsReady) computeReturns(nullptr);
         return LogReturnVec;
     }
 
-    Vector Stock::CalcCumReturns() {
-        Vector r = CalcReturns();
-
-        Vector cr(r.size());
-        double accum = 0.0;
-
-        for (size_t i = 0; i < r.size(); ++i) {
-            accum += r[i];
-            cr[i] = accum;
-        }
-
-        CumReturnVec = cr;
+    const Vector& Stock::CalcCumReturns() {
+        CalcReturns();
         return CumReturnVec;
     }
 
-    Vector Stock::CalcAbnormReturns(Vector& bmret) {
-        Vector r = CalcReturns();
-        Vector ab(r.size());
+    const Vector& Stock::CalcAbnormReturns(const Vector& bmret) {
+        const Vector& r = CalcReturns();
+        AbReturnVec.resize(r.size());
 
         for (size_t i = 0; i < r.size(); ++i) {
-            ab[i] = r[i] - bmret[i];
+            AbReturnVec[i] = r[i] - bmret[i];
         }
-
-        AbReturnVec = ab;
         return AbReturnVec;
     }
 
@@ -100,16 +238,19 @@ namespace fre {
         if (px.empty()) {
             os << "(no price records available)" << endl;
         } else {
-            os << left << setw(14) << "Date" << setw(10) << "Price" << endl;
-            for (const auto& p : px) {
-                os << left << setw(14) << p.date
-                << setw(10) << fixed << setprecision(4) << p.price << endl;
+            // Day labels come from position: the window is centred on day 0
+            long day0 = static_cast<long>(px.size() / 2);
+            os << left << setw(14) << "Date" << setw(8) << "Day" << setw(10) << "Price" << endl;
+            for (size_t i = 0; i < px.size(); ++i) {
+                os << left << setw(14) << formatDay(px.day(i))
+                << setw(8) << static_cast<long>(i) - day0
+                << setw(10) << fixed << setprecision(4) << px.price(i) << endl;
             }
         }
 
         // ------- 2. Cumulative Log Returns ------- //
         os << "\n[2] Cumulative Returns" << endl;
-        Vector cum = s.getCumReturns();
+        const Vector& cum = s.getCumReturns();
 
         if (cum.empty()) {
             os << "(no cumulative return data)" << endl;
@@ -122,7 +263,7 @@ namespace fre {
 
         // ------- 3. Group & Surprise ------- //
         os << "\n[3] Classification" << endl;
-        os << "Group:          " << s.getGroup() << endl;
+        os << "Group:          " << eventGroupName(s.getGroup()) << endl;
         os << "Surprise (%):   "
         << fixed << setprecision(2) << s.getSurprisePercent() << "%" << endl;
 
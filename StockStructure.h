@@ -2,105 +2,229 @@
 #include "MatrixOperator.h"
 #include <string>
 #include <vector>
+#include <map>
+#include <memory>
+#include <utility>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
 
 using namespace std;
 
 namespace fre {
 
-    struct PriceData {
-        string date;
-        string date_label;
-        double price;
+    // Calendar day as a count of days since 1970-01-01.
+    // Dates are parsed once on input and formatted back to text only for output.
+    typedef int32_t DayNumber;
+    const DayNumber kNoDay = INT32_MIN;
+
+    DayNumber toDayNumber(const string& date);  // "YYYY-MM-DD" or "YYYY/M/D"; kNoDay if malformed
+    string formatDay(DayNumber day);            // "YYYY-MM-DD"; "" for kNoDay
+
+    // Interned string id; 0 is the empty string
+    typedef uint32_t Symbol;
+
+    // Append-only table of distinct strings (tickers, sectors, company names).
+    // intern() takes a lock; str() does not, and its reference stays valid for the program's life.
+    class StringTable {
+    public:
+        StringTable();
+        Symbol intern(const string& s);
+        const string& str(Symbol id) const { return chunks_[id >> kChunkBits][id & (kChunkSize - 1)]; }
+        size_t size() const { return size_.load(memory_order_acquire); }
+
+    private:
+        static const size_t kChunkBits = 10;
+        static const size_t kChunkSize = size_t(1) << kChunkBits;
+        static const size_t kMaxChunks = 4096;
+
+        mutex mutex_;
+        unordered_map<string, Symbol> index_;
+        unique_ptr<string[]> chunks_[kMaxChunks];  // chunks never move, so str() needs no lock
+        atomic<uint32_t> size_;
+    };
+
+    StringTable& symbols();  // process-wide table used by Stock
+
+    enum class EventGroup : unsigned char { None, Miss, Meet, Beat };
+    const char* eventGroupName(EventGroup g);  // "" for None
+
+    // Read-only window into a PriceHistory (or any parallel day / price arrays)
+    class PriceView {
+    private:
+        const DayNumber* days_;
+        const double* prices_;
+        size_t count_;
+    public:
+        PriceView() : days_(nullptr), prices_(nullptr), count_(0) {}
+        PriceView(const DayNumber* days, const double* prices, size_t count)
+            : days_(days), prices_(prices), count_(count) {}
+
+        size_t size() const { return count_; }
+        bool empty() const { return count_ == 0; }
+        DayNumber day(size_t i) const { return days_[i]; }
+        double price(size_t i) const { return prices_[i]; }
+        const DayNumber* days() const { return days_; }
+        const double* prices() const { return prices_; }
+    };
+
+    // Full daily price history of one ticker, fetched once and shared by all of its events.
+    // Stored as two parallel arrays; an event's day offsets follow from positions.
+    struct PriceHistory {
+        vector<DayNumber> days;  // ascending trading days
+        Vector prices;           // adjusted close, prices[i] belongs to days[i]
+
+        size_t size() const { return prices.size(); }
+        bool empty() const { return prices.empty(); }
+        void reserve(size_t n) { days.reserve(n); prices.reserve(n); }
+        void push_back(DayNumber day, double price) { days.push_back(day); prices.push_back(price); }
+
+        PriceView view(size_t first, size_t count) const {
+            return PriceView(days.data() + first, prices.data() + first, count);
+        }
     };
 
+    // Returns of one event window, produced together; the n prices stay in the shared
+    // history and are read through the window's PriceView
+    struct ReturnSeries {
+        Vector logReturns;     // n - 1 log returns
+        Vector cumReturns;     // running sum of logReturns
+        Vector abnormReturns;  // logReturns - benchmark, empty without a benchmark
+    };
+
+    // The window's log returns come from one call of the batch log kernel (LogKernel.h),
+    // then one pass builds the cumulative and abnormal series from them. benchReturns,
+    // when given, holds px.size() - 1 benchmark returns aligned with the log returns.
+    // logReturns, when given, are those log returns already computed, e.g. a slice of
+    // the returns of the whole history the window was cut from.
+    void computeReturnSeries(const PriceView& px, const double* benchReturns, ReturnSeries& out,
+                             const double* logReturns = nullptr);
+
+    // Batch entry point over n windows, possibly of many stocks, run on computePool().
+    // bench and logReturns may be null, or hold one pointer (possibly null) per window.
+    void computeReturnSeriesBatch(size_t n, const PriceView* px, const double* const* bench,
+                                  ReturnSeries* out, const double* const* logReturns = nullptr);
+
+    // One earnings event is identified by (ticker, announcement date)
+    typedef pair<string, string> EventKey;
+
     class Stock {
     private:
-        string ticker;
-        string AnnDate;
-        string PeriodEndDate;
+        Symbol TickerSym;
+        DayNumber AnnDay;
+        DayNumber PeriodEndDay;
 
         double EstEps;
         double RptEps;
         double EpsSurprise;
         double EpsSurprisePct;
 
-        string GroupTag;
-        string WindowStart;
-        string WindowEnd;
+        EventGroup Group;
+        DayNumber WindowStartDay;
+        DayNumber WindowEndDay;
 
-        vector<PriceData> PriceSeries;
+        // Event window [WindowFirst, WindowFirst + WindowCount) of the ticker's shared history
+        shared_ptr<const PriceHistory> History;
+        uint32_t WindowFirst;
+        uint32_t WindowCount;
 
-        Vector AdjPricesVec;
+        // Memoized series of the current window; cleared whenever the window changes
         Vector LogReturnVec;
         Vector CumReturnVec;
         Vector AbReturnVec;
+        bool ReturnsReady;  // LogReturnVec and CumReturnVec match the window
 
-        string FullCompanyName;
-        string IndustryName;
+        Symbol CompanyNameSym;
+        Symbol SectorSym;
 
     public:
         Stock()
-            : ticker(""), AnnDate(""), PeriodEndDate(""),
+            : TickerSym(0), AnnDay(kNoDay), PeriodEndDay(kNoDay),
               EstEps(0.0), RptEps(0.0),
               EpsSurprise(0.0), EpsSurprisePct(0.0),
-              GroupTag(""), WindowStart(""), WindowEnd(""),
-              PriceSeries(), AdjPricesVec(),
-              LogReturnVec(), CumReturnVec(), AbReturnVec(),
-              FullCompanyName(""), IndustryName("") {}
+              Group(EventGroup::None), WindowStartDay(kNoDay), WindowEndDay(kNoDay),
+              History(), WindowFirst(0), WindowCount(0),
+              LogReturnVec(), CumReturnVec(), AbReturnVec(), ReturnsReady(false),
+              CompanyNameSym(0), SectorSym(0) {}
 
-        Stock(string tck, string adate, string pend,
+        Stock(const string& tck, const string& adate, const string& pend,
               double est, double rpt, double spr, double sprpct)
-            : ticker(tck), AnnDate(adate), PeriodEndDate(pend),
-              EstEps(est), RptEps(rpt),
-              EpsSurprise(spr), EpsSurprisePct(sprpct),
-              GroupTag(""), WindowStart(""), WindowEnd(""),
-              PriceSeries(), AdjPricesVec(),
-              LogReturnVec(), CumReturnVec(), AbReturnVec(),
-              FullCompanyName(""), IndustryName("") {}
+            : Stock() { setEarningData(tck, adate, pend, est, rpt, spr, sprpct); }
 
         // --- Accessors ---
-        string getTicker() const { return ticker; }
-        string getAnnouncementDate() const { return AnnDate; }
-        string getStartDate() const { return WindowStart; }
-        string getEndDate() const { return WindowEnd; }
-        string getPeriodEnding() const { return PeriodEndDate; }
+        const string& getTicker() const { return symbols().str(TickerSym); }
+        string getAnnouncementDate() const { return formatDay(AnnDay); }
+        string getStartDate() const { return formatDay(WindowStartDay); }
+        string getEndDate() const { return formatDay(WindowEndDay); }
+        string getPeriodEnding() const { return formatDay(PeriodEndDay); }
+        DayNumber getAnnouncementDay() const { return AnnDay; }
+        DayNumber getPeriodEndDay() const { return PeriodEndDay; }
+        DayNumber getWindowStartDay() const { return WindowStartDay; }
+        DayNumber getWindowEndDay() const { return WindowEndDay; }
+        EventKey getKey() const { return EventKey(getTicker(), getAnnouncementDate()); }
 
         double getEstimateEarning() const { return EstEps; }
         double getReportedEarning() const { return RptEps; }
         double getSurprise() const { return EpsSurprise; }
         double getSurprisePercent() const { return EpsSurprisePct; }
 
-        const vector<PriceData>& getPrices() const { return PriceSeries; }
-
-        Vector getReturns() const { return LogReturnVec; }
-        Vector getCumReturns() const { return CumReturnVec; }
-        Vector getAbnormReturns() const { return AbReturnVec; }
-        string getGroup() const { return GroupTag; }
+        PriceView getPrices() const;
+        const shared_ptr<const PriceHistory>& getHistory() const { return History; }
 
-        void setCompanyName(const string& n) { FullCompanyName = n; }
-        void setSector(const string& s) { IndustryName = s; }
+        // Views of the memoized series (empty until computed)
+        const Vector& getReturns() const { return LogReturnVec; }
+        const Vector& getCumReturns() const { return CumReturnVec; }
+        const Vector& getAbnormReturns() const { return AbReturnVec; }
+        EventGroup getGroup() const { return Group; }
 
-        const string& getCompanyName() const { return FullCompanyName; }
-        const string& getSector() const { return IndustryName; }
+        void setCompanyName(const string& n) { CompanyNameSym = symbols().intern(n); }
+        void setSector(const string& s) { SectorSym = symbols().intern(s); }
 
-        Vector getAdjClosePrice();
+        const string& getCompanyName() const { return symbols().str(CompanyNameSym); }
+        const string& getSector() const { return symbols().str(SectorSym); }
 
         // --- Mutators ---
-        void setPrices(const vector<PriceData>& pdata);
-        void setStartEndDate(const string& s, const string& e);
+        void setPrices(const PriceHistory& history);  // owns a private copy of the history
+        void setPriceWindow(const shared_ptr<const PriceHistory>& history, size_t first, size_t count);
+        void clearPrices();
+        void setStartEndDate(DayNumber s, DayNumber e);
 
         void setEarningData(const string& ticker_, const string& ann_, const string& pend_,
                             double est_, double rpt_, double spr_, double sprpct_);
-
-        void setGroup(const string& g) { GroupTag = g; }
+        // Same from already interned and parsed fields (snapshot restore)
+        void setEarningData(Symbol ticker_, DayNumber ann_, DayNumber pend_,
+                            double est_, double rpt_, double spr_, double sprpct_);
+        void setNameSymbols(Symbol company, Symbol sector) { CompanyNameSym = company; SectorSym = sector; }
+
+        void setGroup(EventGroup g) { Group = g; }
+        void setAbnormReturns(const Vector& ab) { AbReturnVec = ab; }
+
+        // Store series computed elsewhere (the price window must be set separately)
+        void setReturnSeries(Vector logReturns, Vector cumReturns, Vector abnormReturns) {
+            LogReturnVec = std::move(logReturns);
+            CumReturnVec = std::move(cumReturns);
+            AbReturnVec  = std::move(abnormReturns);
+            ReturnsReady = !LogReturnVec.empty();
+        }
+        void setReturnSeries(ReturnSeries&& rs) {
+            setReturnSeries(std::move(rs.logReturns), std::move(rs.cumReturns), std::move(rs.abnormReturns));
+        }
 
         bool operator<(const Stock& rhs) const;
 
-        Vector CalcReturns();
-        Vector CalcCumReturns();
-        Vector CalcAbnormReturns(Vector& benchmarkReturns);
+        // All series in one fused pass; benchmarkReturns as for computeReturnSeries (may be null)
+        void computeReturns(const double* benchmarkReturns);
+
+        // Memoized: the window is processed once, later calls return the stored series
+        const Vector& CalcReturns();
+        const Vector& CalcCumReturns();
+        const Vector& CalcAbnormReturns(const Vector& benchmarkReturns);
 
         friend ostream& operator<<(ostream& os, const Stock& s);
     };
+
+    // Event universe ordered by ticker, then announcement date
+    typedef map<EventKey, Stock> StockMap;
 }
 
@@ -1,6 +1,8 @@
 #include "StockUtils.h"
 #include "ThreadUtils.h"
 #include "CurlUtils.h"
+#include "LogKernel.h"
+#include "CsvReader.h"
 
 #include <fstream>
 #include <sstream>
@@ -30,8 +32,8 @@ namespace fre {
             return benchmarkPrices;
         }
 
-        vector<PriceData> series =
-            FetchPriceSeriesWithDates(curl, ticker, fromDate, toDate, fromDate);
+        PriceHistory series =
+            FetchPriceSeriesWithDates(curl, ticker, fromDate, toDate);
 
         curl_easy_cleanup(curl);
 
@@ -40,8 +42,8 @@ namespace fre {
             return benchmarkPrices;
         }
 
-        for (const auto& pd : series) {
-            benchmarkPrices[pd.date] = pd.price;
+        for (size_t i = 0; i < series.size(); ++i) {
+            benchmarkPrices[formatDay(series.days[i])] = series.prices[i];
         }
 
         cout << "[BenchmarkInit] Loaded " << benchmarkPrices.size()
@@ -51,100 +53,134 @@ namespace fre {
     }
 
     // Enrich existing Stock objects in stockMap with company name and sector from a CSV file.
-    void enrichStocksWithSectorInfo(map<string, Stock>& stockMap,
+    // Every event of a ticker receives the same sector and name. The fund file is parsed
+    // in parallel chunks; rows are applied in file order, so a repeated ticker keeps its last row.
+    void enrichStocksWithSectorInfo(StockMap& stockMap,
                                 const string& filename){
-        ifstream fin(filename);
-        if (!fin.is_open()) {
-            cerr << "Error opening file: " << filename << endl;
+        CsvFile csv;
+        if (!csv.open(filename)) {
+            cerr << "Error opening file: " << csv.error() << endl;
             return;
         }
+        vector<int> columns;
+        if (!csv.project({ "Ticker", "Name", "Sector" }, columns)) {
+            cerr << "[StockUtils] " << filename << ": " << csv.error() << endl;
+            return;
+        }
+        // Optional: only used to report how much of the fund the events cover
+        columns.push_back(csv.column("Market Value"));
+        columns.push_back(csv.column("Weight (%)"));
 
-        string line;
-        getline(fin, line);
-
-        while (getline(fin, line)) {
-            if (line.empty()) continue;
-
-            stringstream ss(line);
+        struct Holding {
             string ticker, companyName, sector;
+            double marketValue = 0.0;
+            double weight = 0.0;
+        };
+        vector<CsvChunk> chunks = csv.split(computePool().worker_count() * 4);
+        vector<vector<Holding>> parsed(chunks.size());
+        forEachChunk(computePool(), chunks.size(), [&](size_t c) {
+            csv.parse(chunks[c], columns, [&](const CsvRow& row) {
+                Holding h;
+                h.ticker.assign(row[0]);
+                h.companyName.assign(row[1]);
+                h.sector.assign(row[2]);
+                parseCsvNumber(row[3], h.marketValue);
+                parseCsvNumber(row[4], h.weight);
+                parsed[c].push_back(std::move(h));
+            });
+        });
 
-            getline(ss, ticker, ',');
-            getline(ss, companyName, ',');
-            getline(ss, sector, ',');
-
-            auto it = stockMap.find(ticker);
-            if (it != stockMap.end()) {
-                it->second.setCompanyName(companyName);
-                it->second.setSector(sector);
+        int matched = 0;
+        double matchedValue = 0.0, matchedWeight = 0.0;
+        for (const vector<Holding>& chunk : parsed) {
+            for (const Holding& h : chunk) {
+                auto it = stockMap.lower_bound(EventKey(h.ticker, ""));
+                if (it == stockMap.end() || it->first.first != h.ticker) continue;
+
+                Symbol company = symbols().intern(h.companyName);
+                Symbol sector = symbols().intern(h.sector);
+                for (; it != stockMap.end() && it->first.first == h.ticker; ++it) {
+                    it->second.setNameSymbols(company, sector);
+                }
+                ++matched;
+                matchedValue += h.marketValue;
+                matchedWeight += h.weight;
             }
         }
 
-        fin.close();
+        if (columns[3] >= 0 && columns[4] >= 0) {
+            ios::fmtflags flags = cout.flags();
+            streamsize precision = cout.precision();
+            cout << "[StockUtils] Sector info for " << matched << " fund holdings ("
+                 << fixed << setprecision(2) << matchedWeight << "% of fund weight, $"
+                 << setprecision(1) << matchedValue / 1e9 << "B market value)." << endl;
+            cout.flags(flags);
+            cout.precision(precision);
+        }
     }
 
-    // Load earnings data from CSV and populate stockMap with Stock objects keyed by ticker.
-    void enrichStocksWithGroupInfo(map<string, Stock>& stockMap, const string& filename)
+    // Load earnings data from CSV and populate stockMap with one Stock per (ticker, announcement date).
+    // A ticker may appear on several rows, one per quarterly announcement.
+    // Chunks of the file are parsed on the compute pool and inserted in file order, so a
+    // repeated (ticker, date) keeps its last row as before.
+    void enrichStocksWithGroupInfo(StockMap& stockMap, const string& filename)
     {
-        ifstream fin(filename);
-        if (!fin.is_open()) {
-            cerr << "[StockUtils] Error opening file: " << filename << endl;
+        CsvFile csv;
+        if (!csv.open(filename)) {
+            cerr << "[StockUtils] Error opening file: " << csv.error() << endl;
+            return;
+        }
+        vector<int> columns;
+        if (!csv.project({ "ticker", "date", "period_ending", "estimate",
+                           "reported", "surprise", "surprise%" }, columns)) {
+            cerr << "[StockUtils] " << filename << ": " << csv.error() << endl;
             return;
         }
 
-        string line;
-        getline(fin, line);
+        struct EarningsRow {
+            string ticker;
+            DayNumber announced, periodEnd;
+            double estimate, reported, surprise, surprisePct;
+        };
+        vector<CsvChunk> chunks = csv.split(computePool().worker_count() * 4);
+        vector<vector<EarningsRow>> parsed(chunks.size());
+        vector<int> errors(chunks.size(), 0);
+
+        forEachChunk(computePool(), chunks.size(), [&](size_t c) {
+            csv.parse(chunks[c], columns, [&](const CsvRow& row) {
+                // minimal validation: must have ticker + date at least
+                if (row[0].empty() || row[1].empty()) return;
+
+                EarningsRow r;
+                r.announced = toDayNumber(string(row[1]));
+                r.periodEnd = toDayNumber(string(row[2]));
+                if (!parseCsvNumber(row[3], r.estimate) || !parseCsvNumber(row[4], r.reported) ||
+                    !parseCsvNumber(row[5], r.surprise) || !parseCsvNumber(row[6], r.surprisePct) ||
+                    r.announced == kNoDay) {
+                    ++errors[c];
+                    return;
+                }
+                r.ticker.assign(row[0]);
+                parsed[c].push_back(std::move(r));
+            });
+        });
 
         int count = 0;
         int errorCount = 0;
-
-        while (getline(fin, line)) {
-            if (line.empty()) continue;
-
-            if (!line.empty() && line.back() == '\r') {
-                line.pop_back();
-            }
-
-            stringstream ss(line);
-            string ticker, date, period_ending;
-            string estimate_str, reported_str, surprise_str, surprise_pct_str;
-
-            getline(ss, ticker, ',');
-            getline(ss, date, ',');
-            getline(ss, period_ending, ',');
-            getline(ss, estimate_str, ',');
-            getline(ss, reported_str, ',');
-            getline(ss, surprise_str, ',');
-            getline(ss, surprise_pct_str); // last field
-
-            // minimal validation: must have ticker + date at least
-            if (ticker.empty() || date.empty()) continue;
-
-
-            try {
-                double estimate      = stod(estimate_str);
-                double reported      = stod(reported_str);
-                double surprise      = stod(surprise_str);
-                double surprise_pct  = stod(surprise_pct_str);
-
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            errorCount += errors[c];
+            for (const EarningsRow& r : parsed[c]) {
                 Stock s;
-                s.setEarningData(ticker,
-                                 date,
-                                 period_ending,
-                                 estimate,
-                                 reported,
-                                 surprise,
-                                 surprise_pct);
-
-                stockMap[ticker] = s;
-                count++;
+                s.setEarningData(symbols().intern(r.ticker), r.announced, r.periodEnd,
+                                 r.estimate, r.reported, r.surprise, r.surprisePct);
 
-            } catch (...) {
-                errorCount++;
+                // Key on the normalized date so it always matches Stock::getKey()
+                stockMap[s.getKey()] = s;
+                count++;
             }
         }
 
-        fin.close();
-        cout << "[StockUtils] Successfully loaded " << count << " stocks from CSV.";
+        cout << "[StockUtils] Successfully loaded " << count << " events from CSV.";
         if (errorCount > 0) {
             cout << " (Skipped " << errorCount << " invalid rows)";
         }
@@ -168,95 +204,148 @@ namespace fre {
         return tradingDays;
     }
 
-    // Given an event date and window size N, compute the valid trading window [fromDate, toDate].
-    // If eventDate is not a trading day, adjust to the previous trading day and record a warning.
-    // Return false if there are not enough trading days before/after the event to form the window.
-    bool getTradingWindow(
-    const vector<string>& tradingDays,
-    const string& eventDate,
-    int windowSizeN,
-    string& adjustedEventDate,
-    string& fromDate,
-    string& toDate,
-    map<string, string>& tradingDayWarnings)
+    // Sort the event dates once, then walk the calendar forward: each date needs only the
+    // calendar steps since the previous date, so the whole plan costs O(E log E + D).
+    vector<EventWindowPlan> planEventWindows(const vector<string>& tradingDays,
+                                             const vector<string>& eventDates,
+                                             int windowSizeN,
+                                             int preEventDays,
+                                             map<string, string>& tradingDayWarnings)
     {
-        auto it = find(tradingDays.begin(), tradingDays.end(), eventDate);
+        const size_t E = eventDates.size();
+        const int D = static_cast<int>(tradingDays.size());
+        vector<EventWindowPlan> plan(E);
+
+        vector<size_t> order(E);
+        for (size_t i = 0; i < E; ++i) order[i] = i;
+        stable_sort(order.begin(), order.end(),
+                    [&](size_t a, size_t b) { return eventDates[a] < eventDates[b]; });
+
+        int c = 0;  // first calendar index with tradingDays[c] > current date
+        for (size_t k = 0; k < E; ++k) {
+            const size_t i = order[k];
+            const string& date = eventDates[i];
+
+            // Same date as the previous event: copy its row
+            if (k > 0 && eventDates[order[k - 1]] == date) {
+                plan[i] = plan[order[k - 1]];
+                continue;
+            }
 
-        if (it == tradingDays.end()) {
+            while (c < D && tradingDays[c] <= date) ++c;
 
-            auto lb = lower_bound(tradingDays.begin(), tradingDays.end(), eventDate);
+            EventWindowPlan& row = plan[i];
+            if (c == 0) {
+                row.status = WindowStatus::NoTradingDayBefore;
+                tradingDayWarnings[date] = "Error: No trading day before " + date + ".";
+                continue;
+            }
+
+            row.eventIndex = c - 1;
+            row.adjusted = (tradingDays[row.eventIndex] != date);
 
-            if (lb == tradingDays.begin()) {
-                tradingDayWarnings[eventDate] =
-                    "Error: No trading day before " + eventDate + ".";
-                return false;
+            string warn;
+            if (row.adjusted) {
+                warn = string("Adjusted event day: ") + date +
+                       " → " + tradingDays[row.eventIndex] + " (previous trading day)\n";
             }
 
-            adjustedEventDate = *(lb - 1);
-            it = lb - 1;
+            int daysAfter = D - row.eventIndex - 1;
+            bool fewBefore = row.eventIndex < windowSizeN;
+            bool fewAfter = daysAfter < windowSizeN;
 
-            tradingDayWarnings[eventDate] =
-                string("Adjusted event day: ") + eventDate +
-                " → " + adjustedEventDate + " (previous trading day)\n";
-        }
-        else {
-            adjustedEventDate = eventDate;
-        }
+            if (fewBefore) {
+                warn += "Insufficient days BEFORE event. Needed "
+                    + to_string(windowSizeN) +
+                    ", only " + to_string(row.eventIndex) + ".\n";
+            }
+            if (fewAfter) {
+                warn += "Insufficient days AFTER event. Needed "
+                    + to_string(windowSizeN) +
+                    ", only " + to_string(daysAfter) + ".\n";
+            }
+            if (!warn.empty()) tradingDayWarnings[date] = warn;
 
-        int eventIndex = it - tradingDays.begin();
-        bool ok = true;
-        string warn = tradingDayWarnings[eventDate];
+            if (fewBefore || fewAfter) {
+                row.status = fewBefore && fewAfter ? WindowStatus::TooFewBoth
+                           : fewBefore ? WindowStatus::TooFewBefore : WindowStatus::TooFewAfter;
+                continue;
+            }
 
-        if (eventIndex < windowSizeN) {
-            ok = false;
-            warn += "Insufficient days BEFORE event. Needed "
-                + to_string(windowSizeN) +
-                ", only " + to_string(eventIndex) + ".\n";
+            row.status = WindowStatus::OK;
+            row.fromIndex = row.eventIndex - windowSizeN;
+            row.toIndex = row.eventIndex + windowSizeN;
+            row.historyFromIndex = preEventDays > windowSizeN
+                ? max(0, row.eventIndex - preEventDays)
+                : row.fromIndex;
         }
 
-        int daysAfter = tradingDays.end() - it - 1;
-        if (daysAfter < windowSizeN) {
-            ok = false;
-            warn += "Insufficient days AFTER event. Needed "
-                + to_string(windowSizeN) +
-                ", only " + to_string(daysAfter) + ".\n";
-        }
+        return plan;
+    }
 
-        if (!ok) {
-            tradingDayWarnings[eventDate] = warn;
-            return false;
-        }
+    // Locate [fromDay, toDay] in a history by binary search on its ascending day numbers.
+    bool findPriceWindow(const PriceHistory& history,
+                         DayNumber fromDay,
+                         DayNumber toDay,
+                         size_t& first,
+                         size_t& count)
+    {
+        const auto& days = history.days;
+
+        auto itFrom = lower_bound(days.begin(), days.end(), fromDay);
+        if (itFrom == days.end() || *itFrom != fromDay) return false;
 
-        fromDate = tradingDays[eventIndex - windowSizeN];
-        toDate   = tradingDays[eventIndex + windowSizeN];
+        auto itTo = lower_bound(itFrom, days.end(), toDay);
+        if (itTo == days.end() || *itTo != toDay) return false;
 
+        first = static_cast<size_t>(itFrom - days.begin());
+        count = static_cast<size_t>(itTo - itFrom) + 1;
         return true;
     }
 
-    // Process all stocks: build a trading calendar from benchmark, compute benchmark returns,
-    // fetch each stock’s event-window price series concurrently, then compute returns and abnormal returns.
-    void SETALLStocks(map<string, Stock>& stockMap,
+    // Process all events: build a trading calendar from benchmark, compute benchmark returns,
+    // resolve every event window against the calendar up front (planEventWindows),
+    // then run a staged pipeline connected by bounded queues:
+    //   plan    - emit one request per ticker, widest span first (1 thread)
+    //   fetch   - one rate-limited request per ticker (12 threads, 30 QPS)
+    //   parse   - CSV to a shared history, then one slice per event; forwards the ticker
+    //   compute - batches of every ticker already parsed: log returns of each history in
+    //             one SIMD kernel call, then computeReturnSeriesBatch over all their events
+    //             (cumulative and abnormal returns against a calendar-aligned benchmark array)
+    //   commit  - apply each slot to its event in the registry (striped per-event locks)
+    void SETALLStocks(StockRegistry& registry,
                        const map<string, double>& benchmarkPrices,
                        int N,
-                       vector<string>& warnings,
-                       map<string, string>& tradingDayWarnings)
+                       Diagnostics& diagnostics,
+                       map<string, string>& tradingDayWarnings,
+                       int preEventDays,
+                       DownloadJournal* journal,
+                       const PriceArchive* archive,
+                       const EventCommitHook& onCommit,
+                       ostream& out,
+                       const vector<EventId>* only)
     {
-        if (stockMap.empty()) {
-            cout << "No stocks to process." << endl;
+        if (registry.empty()) {
+            out << "No stocks to process." << endl;
             return;
         }
 
         if (benchmarkPrices.empty()) {
-            cout << "No benchmark prices (IWV) provided." << endl;
+            out << "No benchmark prices (IWV) provided." << endl;
             return;
         }
 
         vector<string> tradingDays = createTradingDaysList(benchmarkPrices);
         if (tradingDays.empty()) {
-            cout << "Trading days list is empty (from benchmarkPrices)." << endl;
+            out << "Trading days list is empty (from benchmarkPrices)." << endl;
             return;
         }
 
+        // Day numbers of the calendar, for locating windows in the histories
+        vector<DayNumber> tradingDayNums;
+        tradingDayNums.reserve(tradingDays.size());
+        for (const auto& d : tradingDays) tradingDayNums.push_back(toDayNumber(d));
+
         map<string, double> benchmarkReturns;
 
         double prevPrice = 0.0;
@@ -282,238 +371,401 @@ namespace fre {
         }
 
         if (benchmarkReturns.empty()) {
-            cout << "Benchmark returns series is empty. Check benchmarkPrices." << endl;
+            out << "Benchmark returns series is empty. Check benchmarkPrices." << endl;
             return;
         }
 
-        struct StockJob {
+        // Benchmark returns aligned with the calendar, so an event's 2N returns are one
+        // contiguous range starting at calendar index eventIndex - N + 1
+        const int numDays = static_cast<int>(tradingDays.size());
+        Vector benchByDay(numDays, 0.0);
+        vector<char> benchHas(numDays, 0);
+        for (int c = 0; c < numDays; ++c) {
+            auto itBR = benchmarkReturns.find(tradingDays[c]);
+            if (itBR == benchmarkReturns.end()) continue;
+            benchByDay[c] = itBR->second;
+            benchHas[c] = 1;
+        }
+
+        // Event e is registry id e; ids are ordered by ticker so each ticker's events are adjacent
+        struct TickerJob {
             string ticker;
-            string announcementDate;
+            size_t firstEvent;
+            size_t numEvents;
+            int span;  // trading days requested, 0 if nothing to fetch
         };
 
-        vector<StockJob> jobs;
-        jobs.reserve(stockMap.size());
+        const size_t numEvents = registry.size();
+        vector<char> selected(numEvents, only ? 0 : 1);
+        if (only) {
+            for (EventId id : *only) if (id < numEvents) selected[id] = 1;
+        }
 
-        for (map<string, Stock>::const_iterator it = stockMap.begin();
-            it != stockMap.end(); ++it)
+        // A ticker without a selected event gets no job; a job's range may still hold
+        // unselected events, which every stage below skips
+        vector<TickerJob> jobs;
+        for (size_t e = 0; e < numEvents; ++e)
         {
-            StockJob job;
-            job.ticker = it->first;
-            job.announcementDate = it->second.getAnnouncementDate();
-            jobs.push_back(job);
+            if (!selected[e]) continue;
+            const string& ticker = registry.key(e).first;
+            if (jobs.empty() || jobs.back().ticker != ticker) {
+                jobs.push_back(TickerJob{ ticker, e, 0, 0 });
+            }
+            jobs.back().numEvents = e - jobs.back().firstEvent + 1;
+        }
+
+        // --- Window plan: every event resolved against the calendar before any fetch ---
+        // Immutable from here on; the stages below only read it
+        vector<string> eventDates;
+        eventDates.reserve(numEvents);
+        for (size_t e = 0; e < numEvents; ++e) eventDates.push_back(registry.key(e).second);
+
+        const vector<EventWindowPlan> plan =
+            planEventWindows(tradingDays, eventDates, N, preEventDays, tradingDayWarnings);
+
+        // Preallocated per-event slots: filled by parse / compute, applied by commit
+        struct EventResult {
+            bool ok = false;
+            shared_ptr<const PriceHistory> history;
+            size_t first = 0;
+            size_t count = 0;
+            ReturnSeries series;
+        };
+        vector<EventResult> results(numEvents);
+
+        // Items passed between stages
+        struct FetchRequest {
+            size_t job = 0;
+            bool fetch = false;  // false when no event of the ticker has a window
+            string from;
+            string to;
+        };
+        struct FetchedCsv {
+            size_t job = 0;
+            bool ok = false;
+            bool curlFailed = false;
+            string csv;
+            shared_ptr<const PriceHistory> journaled;  // replayed instead of fetched
+            bool imported = false;                     // read from the archive, still unclipped
+        };
+
+        // One request per ticker covering the union of its planned windows.
+        // Tickers are emitted with the widest span first so long downloads do not trail
+        vector<size_t> requestOrder(jobs.size());
+        vector<FetchRequest> requests(jobs.size());
+        for (size_t j = 0; j < jobs.size(); ++j) {
+            const TickerJob& job = jobs[j];
+            FetchRequest& req = requests[j];
+            req.job = j;
+
+            int lo = 0, hi = -1;
+            for (size_t e = job.firstEvent; e < job.firstEvent + job.numEvents; ++e) {
+                if (!selected[e]) continue;
+                const EventWindowPlan& w = plan[e];
+                if (!w.ok()) {
+                    int daysBefore = w.eventIndex;
+                    int daysAfter = w.eventIndex < 0 ? 0 : static_cast<int>(tradingDays.size()) - w.eventIndex - 1;
+                    DiagCode code = w.status == WindowStatus::NoTradingDayBefore ? DiagCode::WindowNoTradingDay
+                                  : w.status == WindowStatus::TooFewBefore ? DiagCode::WindowTooFewBefore
+                                  : w.status == WindowStatus::TooFewAfter ? DiagCode::WindowTooFewAfter
+                                  : DiagCode::WindowTooFewBoth;
+                    diagnostics.report(code, e, N, daysBefore, daysAfter);
+                    continue;
+                }
+                if (!req.fetch) { lo = w.historyFromIndex; hi = w.toIndex; }
+                req.fetch = true;
+                lo = min(lo, w.historyFromIndex);
+                hi = max(hi, w.toIndex);
+            }
+
+            if (req.fetch) {
+                req.from = tradingDays[lo];
+                req.to   = tradingDays[hi];
+            }
+            requestOrder[j] = j;
+            jobs[j].span = req.fetch ? hi - lo + 1 : 0;
         }
+        stable_sort(requestOrder.begin(), requestOrder.end(),
+                    [&](size_t a, size_t b) { return jobs[a].span > jobs[b].span; });
+
+        BoundedQueue<FetchRequest> fetchQ(64);
+        BoundedQueue<FetchedCsv>   parseQ(32);
+        BoundedQueue<size_t>       computeQ(1024);
+        BoundedQueue<size_t>       commitQ(1024);
 
-        // ====== ThreadPool v2 ======
-        ThreadPool2 pool(12);
-        vector<future<void>> futures;
-        pool.set_qps_limit(30);
-        futures.reserve(jobs.size());
+        QpsLimiter& limiter = apiLimiter();  // shared with the background prefetcher
 
-        mutex warnMutex;
-        mutex stockMutex;
+        const size_t fetchThreads = 12;
+        const size_t cpuThreads = max<size_t>(1, thread::hardware_concurrency() / 2);
+        const int expectedPoints = 2 * N + 1;
 
         atomic<int> finishedCount(0);
         atomic<int> okCount(0);
-        const int totalJobs = static_cast<int>(jobs.size());
+        const int totalJobs = static_cast<int>(count(selected.begin(), selected.end(), 1));
 
+        // The progress line rewrites itself with '\r', so it is drawn only on the terminal
+        const bool liveProgress = &out == &cout;
         thread progressThread([&]() {
             while (finishedCount < totalJobs) {
                 int done = finishedCount.load();
                 int ok   = okCount.load();
                 int pct  = (totalJobs == 0) ? 0 : (done * 100 / totalJobs);
 
-                cout << "\rProcessing stocks: "
-                    << done << "/" << totalJobs
-                    << " (" << pct << "%) "
-                    << "Success: " << ok << flush;
+                if (liveProgress) {
+                    out << "\rProcessing events: "
+                        << done << "/" << totalJobs
+                        << " (" << pct << "%) "
+                        << "Success: " << ok << flush;
+                }
 
                 this_thread::sleep_for(chrono::milliseconds(100));
             }
-            cout << endl;
+            if (liveProgress) out << endl;
         });
 
-        for (size_t i = 0; i < jobs.size(); ++i) {
+        const auto pipelineStart = chrono::steady_clock::now();
+        Pipeline pipeline;
 
-            StockJob job = jobs[i];
+        // --- 1. Plan: hand the planned requests to the fetch stage ---
+        pipeline.source("plan", fetchQ, [&](auto& emit) {
+            // Copied, not moved: the parse stage reads the ranges back when journaling
+            for (size_t j : requestOrder) emit(FetchRequest(requests[j]));
+        });
 
-            futures.push_back(pool.submit([&, job]() {
+        // --- 2. Fetch: raw CSV per ticker under the QPS limit, one CURL handle per thread ---
+        // A range already in the journal is taken from there without a permit; with an
+        // archive the file is read instead and the network is never touched
+        shared_ptr<CURL> noHandle;
+        atomic<int> replayedTickers(0);
+        atomic<size_t> importedBytes(0);
+        pipeline.stage("fetch", fetchThreads, fetchQ, parseQ,
+            [&, curl = noHandle](FetchRequest& req, auto&& emit) mutable {
+                FetchedCsv out;
+                out.job = req.job;
+
+                if (req.fetch && archive) {
+                    out.imported = true;
+                    out.ok = archive->read(jobs[req.job].ticker, out.csv);
+                    importedBytes += out.csv.size();
+                    if (!out.ok) diagnostics.report(DiagCode::NotInArchive, jobs[req.job].firstEvent);
+                    emit(std::move(out));
+                    return;
+                }
 
-                CURL* curl = curl_easy_init();
-                if (!curl) {
-                    {
-                        lock_guard<mutex> lock(warnMutex);
-                        warnings.push_back("Failed to initialize CURL for " + job.ticker);
+                if (req.fetch && journal) {
+                    out.journaled = journal->find(jobs[req.job].ticker, toDayNumber(req.from), toDayNumber(req.to));
+                    if (out.journaled) {
+                        out.ok = true;
+                        ++replayedTickers;
+                        emit(std::move(out));
+                        return;
                     }
-                    ++finishedCount;
-                    return;
                 }
 
-                string adjustedEventDate;
-                string fromDate;
-                string toDate;
-
-                bool windowOK = getTradingWindow(
-                    tradingDays,
-                    job.announcementDate,
-                    N,
-                    adjustedEventDate,
-                    fromDate,
-                    toDate,
-                    tradingDayWarnings
-                );
-
-                if (!windowOK) {
-                    {
-                        lock_guard<mutex> lock(warnMutex);
-                        string msg = "Cannot build event window for " + job.ticker +
-                                    " (event date = " + job.announcementDate + ").";
-
-                        auto itWarn = tradingDayWarnings.find(job.announcementDate);
-                        if (itWarn != tradingDayWarnings.end()) {
-                            msg += " Details: " + itWarn->second;
+                if (req.fetch) {
+                    if (!curl) curl.reset(curl_easy_init(), curl_easy_cleanup);
+                    if (curl) {
+                        // ====== rate limit v2 ======
+                        limiter.acquire_permit();
+                        FetchStats fs;
+                        out.ok = FetchPriceCsv(curl.get(), jobs[req.job].ticker, req.from, req.to, out.csv, &fs);
+                        if (!out.ok) {
+                            diagnostics.report(DiagCode::FetchFailed, jobs[req.job].firstEvent, fs.attempts, fs.rateLimited);
+                        } else if (fs.rateLimited > 0) {
+                            diagnostics.report(DiagCode::RateLimited, jobs[req.job].firstEvent, fs.rateLimited);
                         }
-                        warnings.push_back(msg);
+                    } else {
+                        out.curlFailed = true;
                     }
-                    curl_easy_cleanup(curl);
-                    ++finishedCount;
-                    return;
                 }
-
-                // ====== rate limit v2 ======
-                pool.acquire_permit();
-
-                vector<PriceData> priceSeries =
-                    FetchPriceSeriesWithDates(curl,
-                                            job.ticker,
-                                            fromDate,
-                                            toDate,
-                                            adjustedEventDate);
-
-                curl_easy_cleanup(curl);
-
-                const int expectedPoints = 2 * N + 1;
-                if (static_cast<int>(priceSeries.size()) != expectedPoints) {
-                    lock_guard<mutex> lock(warnMutex);
-                    warnings.push_back(
-                        "Price series size mismatch for " + job.ticker +
-                        ". Expected " + to_string(expectedPoints) +
-                        " points, got " + to_string(priceSeries.size())
-                    );
-                    ++finishedCount;
-                    return;
+                emit(std::move(out));
+            });
+
+        // --- 3. Parse: one shared history per ticker, sliced for each event; passes the ticker on ---
+        pipeline.stage("parse", cpuThreads, parseQ, computeQ,
+            [&](FetchedCsv& in, auto&& emit) {
+                const TickerJob& job = jobs[in.job];
+
+                shared_ptr<const PriceHistory> history = in.journaled;
+                if (in.imported) {
+                    const FetchRequest& req = requests[in.job];
+                    history = make_shared<const PriceHistory>(in.ok
+                        ? clipHistory(ParsePriceCsv(in.csv), toDayNumber(req.from), toDayNumber(req.to))
+                        : PriceHistory());
+                } else if (!history) {
+                    history = make_shared<const PriceHistory>(in.ok ? ParsePriceCsv(in.csv) : PriceHistory());
+                    if (journal && in.ok && !history->empty()) {
+                        const FetchRequest& req = requests[in.job];
+                        journal->append(job.ticker, toDayNumber(req.from), toDayNumber(req.to), history);
+                    }
                 }
 
-                if (!priceSeries.empty()) {
-
-                    lock_guard<mutex> lock(stockMutex);
-
-                    map<string, Stock>::iterator itStock = stockMap.find(job.ticker);
-                    if (itStock == stockMap.end()) {
-                        {
-                            lock_guard<mutex> wlock(warnMutex);
-                            warnings.push_back("Ticker " + job.ticker +
-                                            " disappeared from stockMap unexpectedly.");
+                for (size_t e = job.firstEvent; e < job.firstEvent + job.numEvents; ++e) {
+                    const EventWindowPlan& w = plan[e];
+                    EventResult& slot = results[e];
+
+                    if (selected[e] && w.ok()) {
+                        if (in.curlFailed) {
+                            diagnostics.report(DiagCode::CurlInitFailed, e);
+                        } else {
+                            size_t sliceFirst = 0;
+                            size_t sliceCount = 0;
+                            bool found = findPriceWindow(*history, tradingDayNums[w.fromIndex], tradingDayNums[w.toIndex],
+                                                         sliceFirst, sliceCount);
+
+                            if (!found || static_cast<int>(sliceCount) != expectedPoints) {
+                                diagnostics.report(DiagCode::PriceCountMismatch, e, expectedPoints,
+                                                   found ? static_cast<int32_t>(sliceCount) : 0);
+                            } else {
+                                slot.history = history;
+                                slot.first = sliceFirst;
+                                slot.count = sliceCount;
+                            }
                         }
-                        ++finishedCount;
-                        return;
                     }
-
-                    Stock& stockRef = itStock->second;
-
-                    stockRef.setPrices(priceSeries);
-                    stockRef.getAdjClosePrice();
-
-                    Vector retSeries = stockRef.CalcReturns();
-                    if (static_cast<int>(retSeries.size()) != 2 * N) {
-                        {
-                            lock_guard<mutex> wlock(warnMutex);
-                            warnings.push_back(
-                                "Return series size mismatch for " + job.ticker +
-                                ". Expected " + to_string(2 * N) +
-                                " returns, got " + to_string(retSeries.size())
-                            );
+                }
+                emit(std::move(in.job));
+            });
+
+        // --- 4. Compute: every ticker already parsed is taken as one batch; its valid events
+        // go through one computeReturnSeriesBatch call spread over the compute pool ---
+        pipeline.batch_stage("compute", 1, 256, computeQ, commitQ,
+            [&](vector<size_t>& tickers, auto&& emit) {
+                vector<size_t> batch;
+                vector<const double*> bench;
+                vector<size_t> firstOfTicker;  // batch position where each ticker's events start
+
+                for (size_t j : tickers) {
+                    const TickerJob& job = jobs[j];
+                    firstOfTicker.push_back(batch.size());
+
+                    for (size_t e = job.firstEvent; e < job.firstEvent + job.numEvents; ++e) {
+                        const EventResult& slot = results[e];
+                        if (!slot.history) continue;
+
+                        if (static_cast<int>(slot.count) - 1 != 2 * N) {
+                            diagnostics.report(DiagCode::ReturnCountMismatch, e, 2 * N,
+                                               static_cast<int32_t>(slot.count) - 1);
+                            continue;
                         }
-                        stockRef.setPrices(vector<PriceData>());
-                        ++finishedCount;
-                        return;
-                    }
-
-                    stockRef.CalcCumReturns();
-
-                    stockRef.setStartEndDate(fromDate, toDate);
-
-                    Vector benchWindow;
-                    benchWindow.reserve(2 * N);
 
-                    auto itEvent = find(tradingDays.begin(), tradingDays.end(), adjustedEventDate);
-                    if (itEvent == tradingDays.end()) {
-                        {
-                            lock_guard<mutex> wlock(warnMutex);
-                            warnings.push_back("Adjusted event date " + adjustedEventDate +
-                                            " not found in tradingDays for " + job.ticker);
+                        int eventIdx = plan[e].eventIndex;
+                        int from = eventIdx - N + 1;
+                        int to = eventIdx + N;
+                        if (from < 0 || to >= numDays) {
+                            diagnostics.report(DiagCode::BenchmarkIndexOutOfRange, e,
+                                               from < 0 ? -N + 1 : numDays - eventIdx);
+                            continue;
                         }
-                        ++finishedCount;
-                        return;
-                    }
-
-                    int eventIdx = static_cast<int>(itEvent - tradingDays.begin());
 
-                    for (int offset = -N + 1; offset <= N; ++offset) {
-                        int idx = eventIdx + offset;
-                        if (idx < 0 || idx >= static_cast<int>(tradingDays.size())) {
-                            {
-                                lock_guard<mutex> wlock(warnMutex);
-                                warnings.push_back("Benchmark index out of range for " + job.ticker +
-                                                " at offset " + to_string(offset));
-                            }
-                            ++finishedCount;
-                            return;
+                        int missing = -1;
+                        for (int c = from; c <= to && missing < 0; ++c) {
+                            if (!benchHas[c]) missing = c;
                         }
-
-                        const string& date = tradingDays[idx];
-                        auto itBR = benchmarkReturns.find(date);
-                        if (itBR == benchmarkReturns.end()) {
-                            {
-                                lock_guard<mutex> wlock(warnMutex);
-                                warnings.push_back("No benchmark return for date " + date +
-                                                " when processing " + job.ticker);
-                            }
-                            ++finishedCount;
-                            return;
+                        if (missing >= 0) {
+                            diagnostics.report(DiagCode::BenchmarkReturnMissing, e, missing);
+                            continue;
                         }
 
-                        benchWindow.push_back(itBR->second);
+                        batch.push_back(e);
+                        bench.push_back(benchByDay.data() + from);
                     }
-
-                    if (static_cast<int>(benchWindow.size()) != 2 * N) {
-                        {
-                            lock_guard<mutex> wlock(warnMutex);
-                            warnings.push_back("Benchmark window size mismatch for " + job.ticker +
-                                            ". Expected " + to_string(2 * N) +
-                                            " got " + to_string(benchWindow.size()));
-                        }
-                        ++finishedCount;
-                        return;
+                }
+                firstOfTicker.push_back(batch.size());
+
+                // Log returns of each ticker's whole history in one kernel call; each window
+                // takes its slice, so days shared by overlapping windows are computed once
+                const size_t numTickers = tickers.size();
+                vector<Vector> historyReturns(numTickers);
+                parallel_for(computePool(), IndexRange{0, numTickers}, 1, [&](size_t t) {
+                    if (firstOfTicker[t] == firstOfTicker[t + 1]) return;
+                    const PriceHistory& history = *results[batch[firstOfTicker[t]]].history;
+                    historyReturns[t].resize(history.size() > 0 ? history.size() - 1 : 0);
+                    logReturns(history.prices.data(), history.size(), historyReturns[t].data());
+                });
+
+                vector<PriceView> px(batch.size());
+                vector<const double*> logRet(batch.size());
+                vector<ReturnSeries> series(batch.size());
+                for (size_t t = 0; t < numTickers; ++t) {
+                    for (size_t k = firstOfTicker[t]; k < firstOfTicker[t + 1]; ++k) {
+                        const EventResult& slot = results[batch[k]];
+                        px[k] = slot.history->view(slot.first, slot.count);
+                        logRet[k] = historyReturns[t].data() + slot.first;
                     }
-
-                    stockRef.CalcAbnormReturns(benchWindow);
-
-                    ++okCount;
                 }
+                computeReturnSeriesBatch(batch.size(), px.data(), bench.data(), series.data(), logRet.data());
 
-                ++finishedCount;
-            }));
-        }
+                for (size_t k = 0; k < batch.size(); ++k) {
+                    EventResult& slot = results[batch[k]];
+                    slot.series = std::move(series[k]);
+                    slot.ok = true;
+                }
 
-        // ====== wait v2 ======
-        pool.drain();
-        for (auto& f : futures) f.get();
+                for (size_t j : tickers) {
+                    const TickerJob& job = jobs[j];
+                    for (size_t e = job.firstEvent; e < job.firstEvent + job.numEvents; ++e) {
+                        if (selected[e]) emit(std::move(e));
+                    }
+                }
+            });
+
+        // --- 5. Commit: each event is applied under its own stripe lock, so commits run
+        // in parallel and readers of the registry see either the old or the new event ---
+        pipeline.sink("commit", 2, commitQ, [&](size_t& e) {
+            EventResult& slot = results[e];
+
+            registry.update(static_cast<EventId>(e), [&](Stock& stockRef) {
+                if (slot.ok) {
+                    stockRef.setPriceWindow(slot.history, slot.first, slot.count);
+                    stockRef.setStartEndDate(tradingDayNums[plan[e].fromIndex], tradingDayNums[plan[e].toIndex]);
+                    stockRef.setReturnSeries(std::move(slot.series));
+                } else {
+                    // Failed events keep no stale window or series from an earlier run
+                    stockRef.clearPrices();
+                    stockRef.setReturnSeries(Vector(), Vector(), Vector());
+                }
+                if (onCommit) onCommit(static_cast<EventId>(e), stockRef);
+            });
+            if (slot.ok) ++okCount;
+            slot.history.reset();
+            ++finishedCount;
+        });
 
+        pipeline.wait();
         progressThread.join();
-
-        cout << "\nProcessing complete. Successfully processed "
-            << okCount << " out of " << totalJobs << " stocks."
+        const double pipelineMs = chrono::duration<double, milli>(chrono::steady_clock::now() - pipelineStart).count();
+        if (journal) journal->flush();
+
+        // Every stage thread has exited: merge the per-thread diagnostics buffers.
+        // Records stay numeric until printed; the context maps ids back to names
+        diagnostics.merge();
+        vector<EventKey> eventKeys;
+        eventKeys.reserve(numEvents);
+        for (size_t e = 0; e < numEvents; ++e) eventKeys.push_back(registry.key(e));
+        diagnostics.setContext(std::move(eventKeys), tradingDays);
+
+        out << "\nProcessing complete. Successfully processed "
+            << okCount << " out of " << totalJobs << " events ("
+            << jobs.size() << " tickers fetched once each)."
             << endl;
+        if (archive) {
+            ios::fmtflags flags = out.flags();
+            streamsize precision = out.precision();
+            out << "Imported " << importedBytes / 1024 << " KB of CSV from " << archive->path()
+                 << " in " << fixed << setprecision(1) << pipelineMs << " ms ("
+                 << setprecision(0) << jobs.size() * 1000.0 / max(pipelineMs, 1e-3)
+                 << " tickers/s), no network requests." << endl;
+            out.flags(flags);
+            out.precision(precision);
+        }
+        if (journal) {
+            out << replayedTickers << " of " << jobs.size()
+                 << " tickers replayed from " << journal->path() << "." << endl;
+        }
+
+        out << "\n===== Pipeline Stages =====" << endl;
+        pipeline.report(out);
     }
 
 }
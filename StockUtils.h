@@ -5,9 +5,15 @@
 #include <vector>
 #include <iomanip>
 #include <map>
+#include <functional>
+#include <iostream>
 #include <curl/curl.h>
 
 #include "CurlUtils.h"
+#include "Diagnostics.h"
+#include "DownloadJournal.h"
+#include "PriceArchive.h"
+#include "StockRegistry.h"
 #include "StockStructure.h"        
 
 namespace fre {
@@ -16,24 +22,76 @@ namespace fre {
                                             const string& fromDate,
                                             const string& toDate);
 
-    void enrichStocksWithSectorInfo(std::map<std::string, Stock>& stockMap, const std::string& filename);
+    void enrichStocksWithSectorInfo(StockMap& stockMap, const std::string& filename);
 
-    void enrichStocksWithGroupInfo(std::map<std::string, Stock>& stockMap, const std::string& filename);
+    void enrichStocksWithGroupInfo(StockMap& stockMap, const std::string& filename);
 
     std::vector<std::string>createTradingDaysList(const std::map<std::string, double>& benchmarkPriceMap);
 
-    bool getTradingWindow(const std::vector<std::string>& tradingDays,
-                          const std::string& eventDate,
-                          int windowSizeN,
-                          std::string& adjustedEventDate,
-                          std::string& fromDate,
-                          std::string& toDate,
-                          std::map<std::string, std::string>& tradingDayWarnings);
+    // Outcome of resolving one announcement date against the trading calendar
+    enum class WindowStatus : unsigned char {
+        OK,
+        NoTradingDayBefore,  // announcement precedes the whole calendar
+        TooFewBefore,        // fewer than N trading days before day 0
+        TooFewAfter,         // fewer than N trading days after day 0
+        TooFewBoth
+    };
 
-    void SETALLStocks(map<string, Stock>& stockMap,
+    // One row of the event-window plan; all indices are into the trading calendar
+    struct EventWindowPlan {
+        WindowStatus status = WindowStatus::NoTradingDayBefore;
+        bool adjusted = false;     // announcement was not a trading day, day 0 is the previous one
+        int eventIndex = -1;       // day 0
+        int fromIndex = -1;        // day -N
+        int toIndex = -1;          // day +N
+        int historyFromIndex = -1; // first day to fetch, incl. preEventDays before day 0
+
+        bool ok() const { return status == WindowStatus::OK; }
+    };
+
+    // Resolve every event date in one merge of the sorted dates against the sorted calendar.
+    // The plan is parallel to eventDates. tradingDayWarnings gets, once per distinct date and
+    // before any worker reads the plan, a note when day 0 moved to the previous trading day
+    // and the shortfall when the window does not fit the calendar.
+    std::vector<EventWindowPlan> planEventWindows(const std::vector<std::string>& tradingDays,
+                                                  const std::vector<std::string>& eventDates,
+                                                  int windowSizeN,
+                                                  int preEventDays,
+                                                  std::map<std::string, std::string>& tradingDayWarnings);
+
+    // Locate the event window [fromDay, toDay] inside a history.
+    // Returns false unless both days are present; first/count then describe the slice.
+    bool findPriceWindow(const PriceHistory& history,
+                         DayNumber fromDay,
+                         DayNumber toDay,
+                         size_t& first,
+                         size_t& count);
+
+    // Called by the commit stage once per event, right after the event was updated (or
+    // cleared, if it failed); runs on a commit thread while the event's stripe lock is held
+    typedef function<void(EventId, const Stock&)> EventCommitHook;
+
+    // preEventDays > 0 extends each ticker's single fetch back that many trading days
+    // before day 0, so estimation windows are available from the same shared history.
+    // Failures are reported to diagnostics as numeric records, merged and given
+    // their name context once the pipeline has finished.
+    // With a journal, tickers whose requested range is already journaled skip the network,
+    // and every new download is journaled as soon as it is parsed.
+    // With an archive, every history is read from it instead of the network (offline import)
+    // and clipped to the requested range, so windows match those of a download.
+    // Progress and the end-of-run report go to out; the live progress line only to cout.
+    // With only (ascending ids), just those events are fetched and committed; the rest of
+    // the registry is left as it is.
+    void SETALLStocks(StockRegistry& registry,
                       const map<string, double>& benchmarkPrices, 
                       int N,
-                      vector<string>& warnings,
-                      map<string, string>& tradingDayWarnings);
+                      Diagnostics& diagnostics,
+                      map<string, string>& tradingDayWarnings,
+                      int preEventDays = 0,
+                      DownloadJournal* journal = nullptr,
+                      const PriceArchive* archive = nullptr,
+                      const EventCommitHook& onCommit = nullptr,
+                      ostream& out = cout,
+                      const vector<EventId>* only = nullptr);
 
 }
@@ -1,5 +1,8 @@
 #include "ThreadUtils.h"
 
+#include <iomanip>
+#include <sstream>
+
 namespace fre {
 
     using namespace std;
@@ -7,7 +10,6 @@ namespace fre {
     ThreadPool2::ThreadPool2(size_t worker_count)
     {
         if (worker_count == 0) worker_count = 1;
-        window_start_ = chrono::steady_clock::now();
 
         workers_.reserve(worker_count);
         for (size_t i = 0; i < worker_count; ++i) {
@@ -117,24 +119,38 @@ namespace fre {
 
     void ThreadPool2::set_qps_limit(int qps)
     {
-        lock_guard<mutex> lock(qps_mtx_);
+        limiter_.set_qps_limit(qps);
+    }
+
+    void ThreadPool2::acquire_permit()
+    {
+        limiter_.acquire_permit();
+    }
+
+    // ================================================================
+    // QpsLimiter
+    // ================================================================
+
+    QpsLimiter::QpsLimiter()
+        : window_start_(chrono::steady_clock::now())
+    {
+    }
+
+    void QpsLimiter::set_qps_limit(int qps)
+    {
+        lock_guard<mutex> lock(mtx_);
         qps_ = (qps < 0 ? 0 : qps);
         window_start_ = chrono::steady_clock::now();
         used_in_window_ = 0;
     }
 
-    void ThreadPool2::acquire_permit()
+    void QpsLimiter::acquire_permit()
     {
         while (true) {
-            int local_qps = 0;
-            chrono::steady_clock::time_point local_start;
-
             {
-                lock_guard<mutex> lock(qps_mtx_);
-                local_qps = qps_;
-                local_start = window_start_;
+                lock_guard<mutex> lock(mtx_);
 
-                if (local_qps == 0) {
+                if (qps_ == 0) {
                     return; // unlimited
                 }
 
@@ -148,7 +164,7 @@ namespace fre {
                     used_in_window_ = 0;
                 }
 
-                if (used_in_window_ < local_qps) {
+                if (used_in_window_ < qps_) {
                     ++used_in_window_;
                     return;
                 }
@@ -159,4 +175,432 @@ namespace fre {
         }
     }
 
+    void CancelFlag::cancel()
+    {
+        {
+            lock_guard<mutex> lock(m_);
+            flag_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    bool CancelFlag::sleep_for(chrono::milliseconds d) const
+    {
+        unique_lock<mutex> lock(m_);
+        return !cv_.wait_for(lock, d, [this] { return flag_.load(); });
+    }
+
+    // ================================================================
+    // WorkStealingPool
+    // ================================================================
+
+    // Which pool / worker the current thread belongs to, for local pushes
+    static thread_local const WorkStealingPool* tl_pool = nullptr;
+    static thread_local int tl_worker = -1;
+
+    void WorkStealingPool::WorkerQueue::push_back(SmallTask&& t)
+    {
+        if (count == ring.size()) {
+            // Grow by doubling and unwrap the ring; rare after warm-up
+            vector<SmallTask> bigger(ring.empty() ? 64 : ring.size() * 2);
+            for (size_t i = 0; i < count; ++i) {
+                bigger[i] = std::move(ring[(head + i) % ring.size()]);
+            }
+            ring.swap(bigger);
+            head = 0;
+        }
+        ring[(head + count) % ring.size()] = std::move(t);
+        ++count;
+    }
+
+    bool WorkStealingPool::WorkerQueue::pop_back(SmallTask& out)
+    {
+        if (count == 0) return false;
+        --count;
+        out = std::move(ring[(head + count) % ring.size()]);
+        return true;
+    }
+
+    bool WorkStealingPool::WorkerQueue::pop_front(SmallTask& out)
+    {
+        if (count == 0) return false;
+        out = std::move(ring[head]);
+        head = (head + 1) % ring.size();
+        --count;
+        return true;
+    }
+
+    WorkStealingPool::WorkStealingPool(size_t worker_count)
+    {
+        if (worker_count == 0) worker_count = 1;
+
+        queues_.reserve(worker_count);
+        for (size_t i = 0; i < worker_count; ++i) {
+            queues_.push_back(make_unique<WorkerQueue>());
+        }
+
+        workers_.reserve(worker_count);
+        for (size_t i = 0; i < worker_count; ++i) {
+            workers_.emplace_back([this, i]() { worker_loop(i); });
+        }
+    }
+
+    WorkStealingPool::~WorkStealingPool()
+    {
+        stop_gracefully();
+    }
+
+    int WorkStealingPool::current_worker() const
+    {
+        return tl_pool == this ? tl_worker : -1;
+    }
+
+    void WorkStealingPool::push(SmallTask&& t)
+    {
+        // Workers push onto their own deque; outside threads spread round-robin
+        int self = current_worker();
+        size_t q = self >= 0 ? static_cast<size_t>(self)
+                             : next_queue_.fetch_add(1, memory_order_relaxed) % queues_.size();
+        {
+            // Counted under the deque lock before the task is visible, so whoever takes it
+            // (a worker, a thief or a helping caller) never decrements queued_ below zero
+            lock_guard<mutex> lock(queues_[q]->m);
+            queued_.fetch_add(1);
+            queues_[q]->push_back(std::move(t));
+        }
+
+        // A sleeper registers itself before re-checking queued_ under sleep_mtx_,
+        // so either it sees this increment or we see it and take the lock to wake it
+        if (sleepers_.load() > 0) {
+            { lock_guard<mutex> lock(sleep_mtx_); }
+            sleep_cv_.notify_one();
+        }
+    }
+
+    bool WorkStealingPool::try_take(size_t self, SmallTask& out)
+    {
+        // Own deque first (LIFO keeps recently spawned work cache-hot)
+        {
+            WorkerQueue& own = *queues_[self];
+            lock_guard<mutex> lock(own.m);
+            if (own.pop_back(out)) return true;
+        }
+
+        // Then steal the oldest task of another worker
+        size_t n = queues_.size();
+        for (size_t k = 1; k < n; ++k) {
+            WorkerQueue& victim = *queues_[(self + k) % n];
+            unique_lock<mutex> lock(victim.m, try_to_lock);
+            if (lock.owns_lock() && victim.pop_front(out)) return true;
+        }
+        for (size_t k = 1; k < n; ++k) {
+            WorkerQueue& victim = *queues_[(self + k) % n];
+            lock_guard<mutex> lock(victim.m);
+            if (victim.pop_front(out)) return true;
+        }
+        return false;
+    }
+
+    void WorkStealingPool::run_task(SmallTask& task)
+    {
+        // In flight before leaving the queue count, so drain() never sees a gap; the task
+        // was counted in queued_ before it could be taken, so the decrement cannot wrap
+        inflight_.fetch_add(1);
+        queued_.fetch_sub(1);
+
+        task();
+        task.reset();
+
+        if (inflight_.fetch_sub(1) == 1 && queued_.load() == 0) {
+            lock_guard<mutex> lock(sleep_mtx_);
+            drained_cv_.notify_all();
+        }
+    }
+
+    bool WorkStealingPool::run_one_pending()
+    {
+        if (queues_.empty()) return false;
+        int self = current_worker();
+        size_t start = self >= 0 ? static_cast<size_t>(self)
+                                 : next_queue_.load(memory_order_relaxed) % queues_.size();
+
+        SmallTask task;
+        if (!try_take(start, task)) return false;
+        run_task(task);
+        return true;
+    }
+
+    void WorkStealingPool::worker_loop(size_t self)
+    {
+        tl_pool = this;
+        tl_worker = static_cast<int>(self);
+
+        SmallTask task;
+        while (true) {
+            if (try_take(self, task)) {
+                run_task(task);
+                continue;
+            }
+
+            unique_lock<mutex> lock(sleep_mtx_);
+            sleepers_.fetch_add(1);
+            sleep_cv_.wait(lock, [this]() {
+                return stopping_.load() || queued_.load() > 0;
+            });
+            sleepers_.fetch_sub(1);
+
+            if (stopping_.load() && queued_.load() == 0) {
+                return;
+            }
+        }
+    }
+
+    void WorkStealingPool::drain()
+    {
+        unique_lock<mutex> lock(sleep_mtx_);
+        drained_cv_.wait(lock, [this]() {
+            return queued_.load() == 0 && inflight_.load() == 0;
+        });
+    }
+
+    void WorkStealingPool::join_all()
+    {
+        for (auto& t : workers_) {
+            if (t.joinable()) t.join();
+        }
+        workers_.clear();
+    }
+
+    void WorkStealingPool::stop_gracefully()
+    {
+        if (stopping_.load()) return;
+        accepting_.store(false);
+
+        // Wait for completion of queued work
+        drain();
+
+        {
+            lock_guard<mutex> lock(sleep_mtx_);
+            stopping_.store(true);
+        }
+        sleep_cv_.notify_all();
+        join_all();
+    }
+
+    void WorkStealingPool::stop_now()
+    {
+        if (stopping_.exchange(true)) return;
+        accepting_.store(false);
+
+        // Clear queued tasks immediately
+        for (auto& q : queues_) {
+            lock_guard<mutex> lock(q->m);
+            SmallTask dropped;
+            while (q->pop_front(dropped)) {
+                dropped.reset();
+                queued_.fetch_sub(1);
+            }
+        }
+
+        {
+            lock_guard<mutex> lock(sleep_mtx_);
+            drained_cv_.notify_all();
+        }
+        sleep_cv_.notify_all();
+        join_all();
+    }
+
+    // ================================================================
+    // Fork-join helpers
+    // ================================================================
+
+    WorkStealingPool& computePool()
+    {
+        static WorkStealingPool pool(max(1u, thread::hardware_concurrency()));
+        return pool;
+    }
+
+    size_t autoGrain(size_t count, size_t workers)
+    {
+        size_t chunks = 4 * max<size_t>(1, workers);
+        return max<size_t>(1, (count + chunks - 1) / chunks);
+    }
+
+    void forEachChunk(WorkStealingPool& pool, size_t numChunks,
+                      const function<void(size_t)>& body)
+    {
+        if (numChunks == 0) return;
+
+        // Shared with the helper tasks: a helper still queued when the call returns (or
+        // never run at all, after stop_now) finds closed set and leaves without body
+        struct State {
+            atomic<size_t> next{0};
+            mutex m;
+            condition_variable cv;
+            size_t running = 0;   // helpers inside runChunks
+            bool closed = false;  // every chunk claimed; late helpers do nothing
+            exception_ptr error;
+        };
+        auto st = make_shared<State>();
+
+        auto runChunks = [&body, numChunks](State& state) {
+            size_t c;
+            while ((c = state.next.fetch_add(1)) < numChunks) {
+                try {
+                    body(c);
+                } catch (...) {
+                    lock_guard<mutex> lock(state.m);
+                    if (!state.error) state.error = current_exception();
+                }
+            }
+        };
+
+        size_t helpers = min(numChunks - 1, pool.worker_count());
+        for (size_t h = 0; h < helpers; ++h) {
+            try {
+                pool.execute([st, runChunks]() {
+                    {
+                        lock_guard<mutex> lock(st->m);
+                        if (st->closed) return;
+                        ++st->running;
+                    }
+                    runChunks(*st);
+                    lock_guard<mutex> lock(st->m);
+                    if (--st->running == 0) st->cv.notify_all();
+                });
+            } catch (...) {
+                break;  // pool no longer accepts work: the caller runs the chunks alone
+            }
+        }
+
+        // The caller claims chunks until none are left, so it never depends on a helper
+        // being scheduled; it then waits only for the helpers that actually started
+        runChunks(*st);
+        unique_lock<mutex> lock(st->m);
+        st->closed = true;
+        st->cv.wait(lock, [&]() { return st->running == 0; });
+
+        if (st->error) rethrow_exception(st->error);
+    }
+
+    // ================================================================
+    // Pipeline
+    // ================================================================
+
+    Pipeline::StageState& Pipeline::add_stage(const string& name, size_t threads)
+    {
+        stages_.emplace_back();
+        StageState& st = stages_.back();
+        st.name = name;
+        st.threads = max<size_t>(1, threads);
+        st.live = st.threads;
+        return st;
+    }
+
+    void Pipeline::wait()
+    {
+        for (auto& t : threads_) {
+            if (t.joinable()) t.join();
+        }
+        threads_.clear();
+    }
+
+    vector<StageStats> Pipeline::stats() const
+    {
+        vector<StageStats> out;
+        for (const auto& st : stages_) {
+            StageStats s;
+            s.name       = st.name;
+            s.threads    = st.threads;
+            s.items      = st.items.load();
+            s.wallSec    = st.endNs.load() * 1e-9;
+            s.busySec    = st.busyNs.load() * 1e-9;
+            s.blockedSec = st.blockedNs.load() * 1e-9;
+            out.push_back(s);
+        }
+        return out;
+    }
+
+    static string percent(double share)
+    {
+        ostringstream ss;
+        ss << fixed << setprecision(1) << 100.0 * share << "%";
+        return ss.str();
+    }
+
+    void Pipeline::report(ostream& os) const
+    {
+        const int W = 10;
+        ios::fmtflags flags = os.flags();
+        streamsize prec = os.precision();
+
+        os << left << setw(W) << "Stage" << setw(W) << "Threads" << setw(W) << "Items"
+           << setw(W) << "Wall(s)" << setw(W) << "Busy" << setw(W) << "Blocked" << "\n";
+        for (const StageStats& s : stats()) {
+            os << left << setw(W) << s.name << setw(W) << s.threads << setw(W) << s.items
+               << fixed << setprecision(2) << setw(W) << s.wallSec
+               << setw(W) << percent(s.utilization())
+               << setw(W) << percent(s.blockedShare()) << "\n";
+        }
+
+        os.flags(flags);
+        os.precision(prec);
+    }
+
+    // ================================================================
+    // Executor microbenchmark
+    // ================================================================
+
+    ExecutorBenchmark benchmarkExecutors(size_t tasks, size_t workers)
+    {
+        ExecutorBenchmark result{tasks, workers, 0.0, 0.0, 0.0, 0.0};
+        atomic<size_t> sink{0};
+        auto tiny = [&sink]() { sink.fetch_add(1, memory_order_relaxed); };
+
+        auto perSec = [tasks](chrono::steady_clock::time_point start) {
+            double sec = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            return sec > 0.0 ? tasks / sec : 0.0;
+        };
+
+        {
+            ThreadPool2 pool(workers);
+            auto start = chrono::steady_clock::now();
+            for (size_t i = 0; i < tasks; ++i) pool.submit(tiny);
+            pool.drain();
+            result.threadPool2PerSec = perSec(start);
+        }
+
+        {
+            WorkStealingPool pool(workers);
+            auto start = chrono::steady_clock::now();
+            for (size_t i = 0; i < tasks; ++i) pool.execute(tiny);
+            pool.drain();
+            result.workStealingPerSec = perSec(start);
+        }
+
+        {
+            // One seed task per worker fans out its share from inside the pool
+            WorkStealingPool pool(workers);
+            size_t seeds = pool.worker_count();
+            auto start = chrono::steady_clock::now();
+            for (size_t s = 0; s < seeds; ++s) {
+                size_t share = tasks / seeds + (s < tasks % seeds ? 1 : 0);
+                pool.execute([&pool, tiny, share]() {
+                    for (size_t i = 0; i < share; ++i) pool.execute(tiny);
+                });
+            }
+            pool.drain();
+            result.workStealingNestedPerSec = perSec(start);
+        }
+
+        {
+            WorkStealingPool pool(workers);
+            auto start = chrono::steady_clock::now();
+            parallel_for(pool, IndexRange{0, tasks}, 0, [&tiny](size_t) { tiny(); });
+            result.parallelForPerSec = perSec(start);
+        }
+
+        return result;
+    }
+
 } // namespace fre
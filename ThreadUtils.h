@@ -5,14 +5,60 @@
 #include <mutex>
 #include <queue>
 #include <functional>
+#include <algorithm>
 #include <condition_variable>
 #include <atomic>
 #include <chrono>
 #include <future>
 #include <type_traits>
+#include <new>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <exception>
+#include <deque>
+#include <string>
+#include <ostream>
+#include <cstdint>
 
 namespace fre {
 
+    // Fixed one-second window limiter for API calls
+    class QpsLimiter {
+    public:
+        QpsLimiter();
+
+        // 0 means unlimited
+        void set_qps_limit(int qps);
+
+        // Acquire one "API call permit" under QPS limit; blocks until allowed
+        void acquire_permit();
+
+    private:
+        std::mutex mtx_;
+        int qps_ = 0; // 0 => unlimited
+        std::chrono::steady_clock::time_point window_start_;
+        int used_in_window_ = 0;
+    };
+
+    // Cancellation flag that also wakes its sleepers, so a cancelled download does not
+    // sit out a retry backoff
+    class CancelFlag {
+    public:
+        void cancel();
+        void reset() { flag_ = false; }
+        bool cancelled() const { return flag_.load(); }
+
+        // Sleep for d, or less if cancelled meanwhile; false if cancelled
+        bool sleep_for(std::chrono::milliseconds d) const;
+
+    private:
+        std::atomic<bool> flag_{false};
+        mutable std::mutex m_;
+        mutable std::condition_variable cv_;
+    };
+
     class ThreadPool2 {
     public:
         // Start worker threads immediately
@@ -63,12 +109,603 @@ namespace fre {
         bool stopping_ = false;
 
         // QPS limiter state
-        mutable std::mutex qps_mtx_;
-        int qps_ = 0; // 0 => unlimited
-        std::chrono::steady_clock::time_point window_start_;
-        int used_in_window_ = 0;
+        QpsLimiter limiter_;
+    };
+
+    // Type-erased void() callable with inline storage.
+    // Callables up to kInlineSize bytes that are nothrow-movable live inside the task
+    // itself, so creating, queueing and running them never touches the heap.
+    class SmallTask {
+    public:
+        static constexpr size_t kInlineSize = 64;
+
+        SmallTask() = default;
+
+        template <class F, class D = std::decay_t<F>,
+                  class = std::enable_if_t<!std::is_same<D, SmallTask>::value>>
+        SmallTask(F&& f) { emplace<D>(std::forward<F>(f)); }
+
+        SmallTask(SmallTask&& other) noexcept { move_from(other); }
+        SmallTask& operator=(SmallTask&& other) noexcept
+        {
+            if (this != &other) { reset(); move_from(other); }
+            return *this;
+        }
+        SmallTask(const SmallTask&) = delete;
+        SmallTask& operator=(const SmallTask&) = delete;
+        ~SmallTask() { reset(); }
+
+        explicit operator bool() const { return ops_ != nullptr; }
+        void operator()() { ops_->invoke(storage()); }
+
+        void reset()
+        {
+            if (ops_) { ops_->destroy(storage()); ops_ = nullptr; }
+        }
+
+    private:
+        struct Ops {
+            void (*invoke)(void*);
+            void (*move)(void* dst, void* src);  // move-construct into dst, destroy src
+            void (*destroy)(void*);
+        };
+
+        template <class D>
+        static constexpr bool fits_inline()
+        {
+            return sizeof(D) <= kInlineSize &&
+                   alignof(D) <= alignof(std::max_align_t) &&
+                   std::is_nothrow_move_constructible<D>::value;
+        }
+
+        template <class D>
+        struct InlineOps {
+            static void invoke(void* p) { (*static_cast<D*>(p))(); }
+            static void move(void* dst, void* src)
+            {
+                ::new (dst) D(std::move(*static_cast<D*>(src)));
+                static_cast<D*>(src)->~D();
+            }
+            static void destroy(void* p) { static_cast<D*>(p)->~D(); }
+            static constexpr Ops table{ &invoke, &move, &destroy };
+        };
+
+        template <class D>
+        struct HeapOps {
+            static D*& ptr(void* p) { return *static_cast<D**>(p); }
+            static void invoke(void* p) { (*ptr(p))(); }
+            static void move(void* dst, void* src) { ::new (dst) D*(ptr(src)); }
+            static void destroy(void* p) { delete ptr(p); }
+            static constexpr Ops table{ &invoke, &move, &destroy };
+        };
+
+        template <class D, class F>
+        void emplace(F&& f)
+        {
+            if constexpr (fits_inline<D>()) {
+                ::new (storage()) D(std::forward<F>(f));
+                ops_ = &InlineOps<D>::table;
+            } else {
+                ::new (storage()) D*(new D(std::forward<F>(f)));
+                ops_ = &HeapOps<D>::table;
+            }
+        }
+
+        void move_from(SmallTask& other) noexcept
+        {
+            if (other.ops_) {
+                other.ops_->move(storage(), other.storage());
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+
+        void* storage() { return static_cast<void*>(buf_); }
+
+        alignas(std::max_align_t) unsigned char buf_[kInlineSize];
+        const Ops* ops_ = nullptr;
+    };
+
+    // Work-stealing executor for fine-grained compute tasks.
+    // Each worker owns a deque: it pushes and pops its own work LIFO, idle workers
+    // steal FIFO from the others, and external submissions are spread round-robin.
+    // Every deque has its own lock, so there is no global queue lock on the hot path.
+    class WorkStealingPool {
+    public:
+        // Start worker threads immediately
+        explicit WorkStealingPool(size_t worker_count = std::thread::hardware_concurrency());
+
+        // Stop workers and join (graceful)
+        ~WorkStealingPool();
+
+        // Fire-and-forget; no allocation for callables that fit SmallTask's inline storage
+        template <class F>
+        void execute(F&& f);
+
+        // Submit a task and get a future for its result (the future's shared state allocates)
+        template <class F, class... Args>
+        auto submit(F&& f, Args&&... args)
+            -> std::future<std::invoke_result_t<F, Args...>>;
+
+        // Block until all queued tasks are finished
+        void drain();
+
+        // Stop accepting new tasks; finish queued tasks then stop workers
+        void stop_gracefully();
+
+        // Stop immediately: clear queues and stop workers ASAP
+        void stop_now();
+
+        // Tasks queued but not yet started
+        size_t pending() const { return queued_.load(); }
+
+        // Number of tasks currently executing
+        int in_flight() const { return inflight_.load(); }
+
+        size_t worker_count() const { return queues_.size(); }
+
+        // Index of the calling worker in this pool, or -1 for outside threads
+        int current_worker() const;
+
+        // Run one queued task on the calling thread; false if every queue is empty.
+        // Lets a thread that waits on pool work help instead of blocking a worker.
+        bool run_one_pending();
+
+    private:
+        // Growable ring buffer guarded by its own mutex
+        struct WorkerQueue {
+            std::mutex m;
+            std::vector<SmallTask> ring;
+            size_t head = 0;   // oldest task (steal end)
+            size_t count = 0;
+
+            void push_back(SmallTask&& t);
+            bool pop_back(SmallTask& out);
+            bool pop_front(SmallTask& out);
+        };
+
+        void push(SmallTask&& t);
+        bool try_take(size_t self, SmallTask& out);
+        void run_task(SmallTask& t);
+        void worker_loop(size_t self);
+        void join_all();
+
+        std::vector<std::unique_ptr<WorkerQueue>> queues_;
+        std::vector<std::thread> workers_;
+
+        std::atomic<size_t> queued_{0};
+        std::atomic<int> inflight_{0};
+        std::atomic<int> sleepers_{0};
+        std::atomic<size_t> next_queue_{0};
+        std::atomic<bool> accepting_{true};
+        std::atomic<bool> stopping_{false};
+
+        mutable std::mutex sleep_mtx_;
+        std::condition_variable sleep_cv_;
+        std::condition_variable drained_cv_;
+    };
+
+    // Shared compute pool with one worker per hardware thread, started on first use
+    WorkStealingPool& computePool();
+
+    // Half-open index range [begin, end)
+    struct IndexRange {
+        size_t begin = 0;
+        size_t end = 0;
+        size_t size() const { return end > begin ? end - begin : 0; }
+    };
+
+    // Chunk size giving about four chunks per worker
+    size_t autoGrain(size_t count, size_t workers);
+
+    // Run body(c) for every chunk c in [0, numChunks) on the pool and the calling thread.
+    // Chunks are claimed from one atomic counter by at most worker_count() helper tasks,
+    // so the join costs one counter instead of a future per item. The caller claims chunks
+    // too until none are left and then waits only for helpers that started, so nested calls
+    // from workers and a pool stopped mid-call (stop_now) cannot leave it waiting.
+    // The first exception thrown by a chunk is rethrown after all chunks have finished.
+    void forEachChunk(WorkStealingPool& pool, size_t numChunks,
+                      const std::function<void(size_t)>& body);
+
+    // fn(i) for every i in range, or fn(begin, end) once per chunk if fn takes two indices.
+    // grain = 0 picks autoGrain().
+    template <class F>
+    void parallel_for(WorkStealingPool& pool, IndexRange range, size_t grain, F&& fn)
+    {
+        size_t n = range.size();
+        if (n == 0) return;
+        if (grain == 0) grain = autoGrain(n, pool.worker_count());
+        size_t chunks = (n + grain - 1) / grain;
+
+        forEachChunk(pool, chunks, [&](size_t c) {
+            size_t b = range.begin + c * grain;
+            size_t e = std::min(range.end, b + grain);
+            if constexpr (std::is_invocable_v<F&, size_t, size_t>) {
+                fn(b, e);
+            } else {
+                for (size_t i = b; i < e; ++i) fn(i);
+            }
+        });
+    }
+
+    // combine over map(i) for every i in range, starting from identity.
+    // Each chunk folds its items left to right and the chunk results are folded in
+    // chunk order. With grain = 0 the chunking depends only on the range size, so the
+    // result is bit-identical for any worker count.
+    template <class T, class Map, class Combine>
+    T parallel_reduce(WorkStealingPool& pool, IndexRange range, T identity,
+                      Map&& map, Combine&& combine, size_t grain = 0)
+    {
+        size_t n = range.size();
+        if (n == 0) return identity;
+        if (grain == 0) grain = (n + 63) / 64;
+        size_t chunks = (n + grain - 1) / grain;
+
+        std::vector<T> partial(chunks, identity);
+        forEachChunk(pool, chunks, [&](size_t c) {
+            size_t b = range.begin + c * grain;
+            size_t e = std::min(range.end, b + grain);
+            T acc = identity;
+            for (size_t i = b; i < e; ++i) acc = combine(std::move(acc), map(i));
+            partial[c] = std::move(acc);
+        });
+
+        T result = std::move(identity);
+        for (auto& p : partial) result = combine(std::move(result), std::move(p));
+        return result;
+    }
+
+    // Bounded lock-free multi-producer / multi-consumer queue (sequence-numbered ring).
+    // push() blocks while the queue is full, which is the backpressure between pipeline
+    // stages; pop() blocks while it is empty and returns false once closed and drained.
+    // The ring itself takes no lock; a thread that has to wait sleeps on not_full_ /
+    // not_empty_, and the other side takes the mutex to notify only when someone sleeps.
+    template <class T>
+    class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t capacity)
+        {
+            size_t cap = 2;
+            while (cap < capacity) cap <<= 1;
+            mask_ = cap - 1;
+            cells_.reset(new Cell[cap]);
+            for (size_t i = 0; i < cap; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        // Moves from v only on success
+        bool try_push(T& v)
+        {
+            size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+            Cell* cell;
+            while (true) {
+                cell = &cells_[pos & mask_];
+                size_t seq = cell->seq.load(std::memory_order_acquire);
+                std::intptr_t dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+                if (dif == 0) {
+                    if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                } else if (dif < 0) {
+                    return false;  // full
+                } else {
+                    pos = enqueue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+            cell->value = std::move(v);
+            cell->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_pop(T& out)
+        {
+            size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+            Cell* cell;
+            while (true) {
+                cell = &cells_[pos & mask_];
+                size_t seq = cell->seq.load(std::memory_order_acquire);
+                std::intptr_t dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+                if (dif == 0) {
+                    if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                } else if (dif < 0) {
+                    return false;  // empty
+                } else {
+                    pos = dequeue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+            out = std::move(cell->value);
+            cell->value = T();
+            cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+            return true;
+        }
+
+        void push(T v)
+        {
+            if (!try_push(v)) {
+                std::unique_lock<std::mutex> lock(m_);
+                pushWaiters_.fetch_add(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                not_full_.wait(lock, [&]() { return try_push(v); });
+                pushWaiters_.fetch_sub(1);
+            }
+            wake(popWaiters_, not_empty_);
+        }
+
+        bool pop(T& out)
+        {
+            if (!try_pop(out)) {
+                std::unique_lock<std::mutex> lock(m_);
+                popWaiters_.fetch_add(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                bool got = false;
+                not_empty_.wait(lock, [&]() {
+                    if (try_pop(out)) { got = true; return true; }
+                    // Items pushed before close() are visible once closed_ is seen
+                    if (closed_.load(std::memory_order_acquire)) { got = try_pop(out); return true; }
+                    return false;
+                });
+                popWaiters_.fetch_sub(1);
+                if (!got) return false;
+            }
+            wake(pushWaiters_, not_full_);
+            return true;
+        }
+
+        // Appends up to max already queued items to out without blocking; returns how many
+        size_t try_pop_some(std::vector<T>& out, size_t max)
+        {
+            size_t n = 0;
+            T v;
+            while (n < max && try_pop(v)) {
+                out.push_back(std::move(v));
+                ++n;
+            }
+            if (n > 0) wake(pushWaiters_, not_full_);
+            return n;
+        }
+
+        // No more pushes; consumers drain what is left and then stop
+        void close()
+        {
+            closed_.store(true, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(m_);
+            not_empty_.notify_all();
+        }
+
+        size_t capacity() const { return mask_ + 1; }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> seq;
+            T value;
+        };
+
+        std::unique_ptr<Cell[]> cells_;
+        size_t mask_ = 0;
+        alignas(64) std::atomic<size_t> enqueue_pos_{0};
+        alignas(64) std::atomic<size_t> dequeue_pos_{0};
+        std::atomic<bool> closed_{false};
+
+        // Sleepers register before re-checking the ring under m_; the fence pairs the
+        // ring update of one side with the waiter count read of the other
+        void wake(std::atomic<size_t>& waiters, std::condition_variable& cv)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiters.load() == 0) return;
+            std::lock_guard<std::mutex> lock(m_);
+            cv.notify_one();
+        }
+
+        std::mutex m_;
+        std::condition_variable not_full_;
+        std::condition_variable not_empty_;
+        std::atomic<size_t> pushWaiters_{0};
+        std::atomic<size_t> popWaiters_{0};
+    };
+
+    // Counters of one pipeline stage after the run
+    struct StageStats {
+        std::string name;
+        size_t threads = 0;
+        size_t items = 0;
+        double wallSec = 0.0;     // pipeline start until the stage's last thread exited
+        double busySec = 0.0;     // time inside the stage function, summed over threads
+        double blockedSec = 0.0;  // time waiting on a full output queue (backpressure)
+
+        double utilization() const { return threads && wallSec > 0.0 ? busySec / (threads * wallSec) : 0.0; }
+        double blockedShare() const { return threads && wallSec > 0.0 ? blockedSec / (threads * wallSec) : 0.0; }
     };
 
+    // Threads connected by BoundedQueues. Each stage runs its own number of threads,
+    // closes its output queue when its last thread finishes, and records busy and
+    // blocked time so the bottleneck stage shows up in report().
+    class Pipeline {
+    public:
+        Pipeline() : start_(std::chrono::steady_clock::now()) {}
+        ~Pipeline() { wait(); }
+
+        // One thread running fn(emit) to produce the input of the next stage
+        template <class Out, class F>
+        void source(const std::string& name, BoundedQueue<Out>& out, F fn)
+        {
+            StageState& st = add_stage(name, 1);
+            threads_.emplace_back([this, &st, &out, fn]() mutable {
+                auto emit = make_emit(st, out);
+                auto t0 = std::chrono::steady_clock::now();
+                fn(emit);
+                st.busyNs += elapsed_ns(t0) - st.blockedNs.load();
+                finish(st, &out);
+            });
+        }
+
+        // `threads` threads running fn(item, emit) for every input item
+        template <class In, class Out, class F>
+        void stage(const std::string& name, size_t threads, BoundedQueue<In>& in, BoundedQueue<Out>& out, F fn)
+        {
+            StageState& st = add_stage(name, threads);
+            for (size_t t = 0; t < st.threads; ++t) {
+                threads_.emplace_back([this, &st, &in, &out, fn]() mutable {
+                    In item;
+                    long long blocked = 0;
+                    while (in.pop(item)) {
+                        auto t0 = std::chrono::steady_clock::now();
+                        long long before = blocked;
+                        fn(item, [&](Out&& o) {
+                            auto b0 = std::chrono::steady_clock::now();
+                            out.push(std::move(o));
+                            blocked += elapsed_ns(b0);
+                        });
+                        st.busyNs += elapsed_ns(t0) - (blocked - before);
+                        ++st.items;
+                    }
+                    st.blockedNs += blocked;
+                    finish(st, &out);
+                });
+            }
+        }
+
+        // `threads` threads running fn(items, emit) on batches: a blocking pop, then every
+        // item already queued, up to maxBatch. Lets a stage hand work of many items to
+        // one pool call instead of one call per item.
+        template <class In, class Out, class F>
+        void batch_stage(const std::string& name, size_t threads, size_t maxBatch,
+                         BoundedQueue<In>& in, BoundedQueue<Out>& out, F fn)
+        {
+            StageState& st = add_stage(name, threads);
+            if (maxBatch == 0) maxBatch = 1;
+            for (size_t t = 0; t < st.threads; ++t) {
+                threads_.emplace_back([this, &st, &in, &out, maxBatch, fn]() mutable {
+                    std::vector<In> items;
+                    In item;
+                    long long blocked = 0;
+                    while (in.pop(item)) {
+                        items.clear();
+                        items.push_back(std::move(item));
+                        in.try_pop_some(items, maxBatch - 1);
+
+                        auto t0 = std::chrono::steady_clock::now();
+                        long long before = blocked;
+                        fn(items, [&](Out&& o) {
+                            auto b0 = std::chrono::steady_clock::now();
+                            out.push(std::move(o));
+                            blocked += elapsed_ns(b0);
+                        });
+                        st.busyNs += elapsed_ns(t0) - (blocked - before);
+                        st.items += items.size();
+                    }
+                    st.blockedNs += blocked;
+                    finish(st, &out);
+                });
+            }
+        }
+
+        // `threads` threads running fn(item) for every input item, with no output queue
+        template <class In, class F>
+        void sink(const std::string& name, size_t threads, BoundedQueue<In>& in, F fn)
+        {
+            StageState& st = add_stage(name, threads);
+            for (size_t t = 0; t < st.threads; ++t) {
+                threads_.emplace_back([this, &st, &in, fn]() mutable {
+                    In item;
+                    while (in.pop(item)) {
+                        auto t0 = std::chrono::steady_clock::now();
+                        fn(item);
+                        st.busyNs += elapsed_ns(t0);
+                        ++st.items;
+                    }
+                    finish<In>(st, nullptr);
+                });
+            }
+        }
+
+        // Join every stage
+        void wait();
+
+        std::vector<StageStats> stats() const;
+
+        // One line per stage: threads, items, utilization and backpressure
+        void report(std::ostream& os) const;
+
+    private:
+        struct StageState {
+            std::string name;
+            size_t threads = 0;
+            std::atomic<size_t> live{0};
+            std::atomic<size_t> items{0};
+            std::atomic<long long> busyNs{0};
+            std::atomic<long long> blockedNs{0};
+            std::atomic<long long> endNs{0};
+        };
+
+        StageState& add_stage(const std::string& name, size_t threads);
+
+        long long elapsed_ns(std::chrono::steady_clock::time_point t0) const
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - t0).count();
+        }
+
+        // Source emit: counts items and blocked time on the stage itself
+        template <class Out>
+        auto make_emit(StageState& st, BoundedQueue<Out>& out)
+        {
+            return [this, &st, &out](Out&& o) {
+                auto b0 = std::chrono::steady_clock::now();
+                out.push(std::move(o));
+                st.blockedNs += elapsed_ns(b0);
+                ++st.items;
+            };
+        }
+
+        template <class Out>
+        void finish(StageState& st, BoundedQueue<Out>* out)
+        {
+            if (st.live.fetch_sub(1) == 1) {
+                st.endNs = elapsed_ns(start_);
+                if (out) out->close();
+            }
+        }
+
+        std::chrono::steady_clock::time_point start_;
+        std::deque<StageState> stages_;
+        std::vector<std::thread> threads_;
+    };
+
+    // Tasks per second for ThreadPool2 and WorkStealingPool on the same tiny workload
+    struct ExecutorBenchmark {
+        size_t tasks;
+        size_t workers;
+        double threadPool2PerSec;      // submit() from one producer, then drain()
+        double workStealingPerSec;     // execute() from one producer, then drain()
+        double workStealingNestedPerSec; // tasks fanned out from inside the workers
+        double parallelForPerSec;      // parallel_for with automatic chunking
+    };
+
+    ExecutorBenchmark benchmarkExecutors(size_t tasks, size_t workers);
+
+    template <class F>
+    void WorkStealingPool::execute(F&& f)
+    {
+        if (!accepting_.load()) {
+            throw std::runtime_error("WorkStealingPool: not accepting new tasks");
+        }
+        push(SmallTask(std::forward<F>(f)));
+    }
+
+    template <class F, class... Args>
+    auto WorkStealingPool::submit(F&& f, Args&&... args)
+        -> std::future<std::invoke_result_t<F, Args...>>
+    {
+        using R = std::invoke_result_t<F, Args...>;
+
+        std::packaged_task<R()> task(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+        );
+        std::future<R> fut = task.get_future();
+        execute(std::move(task));
+        return fut;
+    }
+
     template <class F, class... Args>
     auto ThreadPool2::submit(F&& f, Args&&... args)
         -> std::future<std::invoke_result_t<F, Args...>>
@@ -0,0 +1,128 @@
+#include "UniverseUpdate.h"
+
+#include <cmath>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+using namespace std;
+
+namespace fre {
+
+    namespace {
+        bool sameSurprise(double a, double b) {
+            return a == b || (std::isnan(a) && std::isnan(b));
+        }
+    }
+
+    UniverseDiff diffUniverse(const vector<GroupingKey>& loaded, const vector<GroupingKey>& incoming)
+    {
+        UniverseDiff diff;
+        map<EventKey, const GroupingKey*> before;
+        for (const GroupingKey& k : loaded) before[EventKey(k.ticker, k.date)] = &k;
+
+        for (const GroupingKey& k : incoming) {
+            EventKey key(k.ticker, k.date);
+            auto it = before.find(key);
+            if (it == before.end()) {
+                diff.added.push_back(key);
+                diff.sectors.insert(k.sector);
+                continue;
+            }
+            const GroupingKey& old = *it->second;
+            if (old.sector != k.sector || !sameSurprise(old.surprisePct, k.surprisePct)) {
+                diff.changed.push_back(key);
+                diff.sectors.insert(old.sector);
+                diff.sectors.insert(k.sector);
+            }
+            before.erase(it);
+        }
+
+        for (const auto& p : before) {
+            diff.removed.push_back(p.first);
+            diff.sectors.insert(p.second->sector);
+        }
+        return diff;
+    }
+
+    UniverseRefresh planUniverseRefresh(const StockMap& incoming, const StockRegistry& registry,
+                                        const UniverseDiff& diff)
+    {
+        UniverseRefresh refresh;
+
+        // --- 1. Tercile split of the affected sectors, as in Phase 1 Step 4 ---
+        map<EventKey, EventGroup> labels;
+        {
+            unordered_map<string, vector<Stock>> sectorMap;
+            for (const auto& p : incoming) {
+                const string& sector = p.second.getSector();
+                if (StockGrouper::isGroupedSector(sector) && diff.sectors.count(sector)) sectorMap[sector].push_back(p.second);
+            }
+            StockGrouper grouper;
+            grouper.processAllSectors(sectorMap);
+            for (const Stock& s : grouper.getMissGroup()) labels[s.getKey()] = EventGroup::Miss;
+            for (const Stock& s : grouper.getMeetGroup()) labels[s.getKey()] = EventGroup::Meet;
+            for (const Stock& s : grouper.getBeatGroup()) labels[s.getKey()] = EventGroup::Beat;
+        }
+
+        // --- 2. New registry contents; unaffected sectors keep the registry's groups ---
+        // Only events the registry lacks are fetched. A changed event (new surprise or sector)
+        // keeps its price window and returns: only its earnings fields and group change.
+        for (const auto& p : incoming) {
+            const EventKey& key = p.first;
+            if (!StockGrouper::isGroupedSector(p.second.getSector())) continue;  // no scheme can label it
+            EventId id = registry.find(key);
+
+            EventGroup group = EventGroup::None;
+            if (diff.sectors.count(p.second.getSector())) {
+                auto it = labels.find(key);
+                if (it != labels.end()) group = it->second;
+            } else if (id != kNoEvent) {
+                group = registry.read(id, [](const Stock& s) { return s.getGroup(); });
+            }
+
+            if (id == kNoEvent) {
+                Stock stock = p.second;
+                stock.setGroup(group);
+                refresh.stocks.emplace(key, std::move(stock));
+
+                GroupChange change;
+                change.toGroup = group;
+                refresh.refetch.push_back(key);
+                refresh.pending.push_back(std::move(change));
+                continue;
+            }
+
+            Stock stock = registry.snapshot(id);
+            const Stock& in = p.second;
+            stock.setEarningData(in.getTicker(), in.getAnnouncementDate(), in.getPeriodEnding(), in.getEstimateEarning(),
+                                 in.getReportedEarning(), in.getSurprise(), in.getSurprisePercent());
+            stock.setCompanyName(in.getCompanyName());
+            stock.setSector(in.getSector());
+            if (stock.getGroup() != group) {
+                GroupChange change;
+                change.fromGroup = stock.getGroup();
+                change.fromReturns = stock.getAbnormReturns();
+                change.toGroup = group;
+                change.toReturns = stock.getAbnormReturns();
+                refresh.changes.push_back(std::move(change));
+                ++refresh.regrouped;
+                stock.setGroup(group);
+            }
+            refresh.stocks.emplace(key, std::move(stock));
+        }
+
+        // --- 3. Registry events that left the universe ---
+        for (EventId id = 0; id < registry.size(); ++id) {
+            if (refresh.stocks.count(registry.key(id))) continue;
+            registry.read(id, [&](const Stock& s) {
+                GroupChange change;
+                change.fromGroup = s.getGroup();
+                change.fromReturns = s.getAbnormReturns();
+                refresh.changes.push_back(std::move(change));
+            });
+        }
+        return refresh;
+    }
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "RunningStats.h"
+#include "StockGrouper.h"
+#include "StockRegistry.h"
+#include "StockStructure.h"
+
+namespace fre {
+
+    // Events of a re-read earnings file against the loaded universe, by (ticker, date).
+    // Changed means a new surprise or sector. sectors holds every sector whose members or
+    // order may differ, old and new, and so the only ones that need regrouping.
+    struct UniverseDiff {
+        std::vector<EventKey> added;
+        std::vector<EventKey> removed;
+        std::vector<EventKey> changed;
+        std::set<std::string> sectors;
+
+        bool empty() const { return added.empty() && removed.empty() && changed.empty(); }
+    };
+
+    // Both sides are full universes, before outlier removal (buildGroupingKeys)
+    UniverseDiff diffUniverse(const std::vector<GroupingKey>& loaded, const std::vector<GroupingKey>& incoming);
+
+    // The registry contents after a diff. Events of unaffected sectors are copied from the
+    // registry with their price data and group. The affected sectors are regrouped (Beat /
+    // Meet / Miss terciles) from incoming. Only added events need price data; every other
+    // event keeps the registry's, with the earnings fields of incoming. Outliers of the
+    // trim stay in stocks with EventGroup::None; events without a sector to group in are left out.
+    struct UniverseRefresh {
+        StockMap stocks;
+        // Added events, with no price data yet, in key order; pending[i] gets refetch[i]'s
+        // contribution once the event is fetched
+        std::vector<EventKey> refetch;
+        std::vector<GroupChange> pending;
+        // Events removed or moved to another group (or out of all groups) with unchanged returns
+        std::vector<GroupChange> changes;
+        std::size_t regrouped = 0;  // events kept with a new group
+    };
+
+    UniverseRefresh planUniverseRefresh(const StockMap& incoming, const StockRegistry& registry,
+                                        const UniverseDiff& diff);
+
+}
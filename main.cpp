@@ -1,8 +1,23 @@
 #include <iostream>
+#include <cstdio>
 #include <vector>
 #include <string>
 #include <map>
 #include <unordered_map>
+#include <sstream>
+#include <cmath>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <random>
+#include <filesystem>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <curl/curl.h>
 
 #include "StockStructure.h"
@@ -14,70 +29,906 @@
 #include "MatrixOperator.h"
 #include "StatCalculator.h"
 #include "ThreadUtils.h"
+#include "ReturnPanel.h"
+#include "Diagnostics.h"
+#include "StockRegistry.h"
+#include "RunArena.h"
+#include "LogKernel.h"
+#include "Snapshot.h"
+#include "DownloadJournal.h"
+#include "PriceArchive.h"
+#include "Prefetcher.h"
+#include "RunningStats.h"
+#include "UniverseUpdate.h"
+#include "BatchRunner.h"
+#include "AnalysisServer.h"
+#include "ShardStats.h"
 
 using namespace std;
 using namespace fre;
 
-map<string, Stock> g_stockMap;  // [From StockStructure.h]
+StockRegistry g_registry;  // [From StockRegistry.h] frozen event universe, one stable id per (ticker, announcement date)
 Stock g_iwvBenchmark;  // [From StockStructure.h]
 bool g_dataLoaded = false;
 bool g_calcReady = false;
 int default_N = 60; 
+const int g_numResamples = 40;  // [From Bootstrapper.h] Option 1's bootstrap: resamples,
+const int g_sampleSize = 30;    // and stocks drawn per resample (M); estimates from sums scale to the same M
+bool g_hasSeed = false;  // --seed: Option 1's bootstrap seed, otherwise a new one per run
+uint64_t g_seed = 0;
 StatCalculator* g_statCalc = nullptr; // [From StatCalculator.h]
+vector<GroupingKey> g_groupingKeys;  // [From StockGrouper.h] full universe, before outlier removal
+QuantileGrouping g_quantileGroups;  // [From StockGrouper.h] labels for the default schemes
+AbnormalReturnModel g_arModel = AbnormalReturnModel::MarketAdjusted;  // [From ReturnPanel.h]
+unique_ptr<ReturnPanel> g_returnPanel;  // [From ReturnPanel.h] estimation + event window returns of the last run, in runArena()
+MarketModelFit g_modelFit;  // [From ReturnPanel.h] per-event alpha, beta, residual variance
 const int W_T   = 6;
 const int W_COL = 12;
+const string g_snapshotFile = "fre_snapshot.bin";  // [From Snapshot.h] state of the last session
+const string g_journalFile = "fre_download.journal";
+DownloadJournal g_journal;  // [From DownloadJournal.h] completed downloads, replayed across runs and crashes
+PriceArchive g_archive;  // [From PriceArchive.h] local EOD CSV files, replaces the network when open (--import)
+Prefetcher g_prefetcher;  // [From Prefetcher.h] downloads into g_journal while the menu is idle
+const string g_benchFrom = "2023-12-01";  // IWV range, also the trading calendar
+const string g_benchTo   = "2025-12-30";
+LiveGroupStats g_live;  // [From RunningStats.h] group sums of the Option 1 run in progress, then of its results
+thread g_runThread;  // Option 1 in the background; the menu stays usable
+atomic<bool> g_runActive(false);  // cleared by g_runThread once the results above are set
+const string g_runLogFile = "fre_run.log";  // Option 1's report
 
 
-int main() 
+// Write the current state; the run sections only once Option 1 has completed
+void saveSession(uint64_t inputs)
 {
+    auto start = chrono::steady_clock::now();
+    SnapshotSource src;
+    src.registry = &g_registry;
+    src.benchmark = g_iwvBenchmark.getHistory().get();
+    src.groupingKeys = &g_groupingKeys;
+    src.quantileGroups = &g_quantileGroups;
+    if (g_calcReady && g_returnPanel && g_statCalc) {
+        src.panel = g_returnPanel.get();
+        src.fit = &g_modelFit;
+        src.stats = g_statCalc;
+        src.model = g_arModel;
+    }
+
+    string error;
+    if (!saveSnapshot(g_snapshotFile, inputs, src, error)) {
+        cerr << "[Snapshot] Warning: not saved (" << error << ")." << endl;
+        return;
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "[Snapshot] Saved " << (src.panel ? "universe and run results" : "universe")
+         << " to " << g_snapshotFile << " in " << fixed << setprecision(1) << ms << " ms." << endl;
+}
+
+// Replace Phase 1 (and a saved Option 1 run) with the last snapshot of the same inputs
+bool restoreSession(uint64_t inputs)
+{
+    auto start = chrono::steady_clock::now();
+    SnapshotContents snap;
+    string error;
+    if (!loadSnapshot(g_snapshotFile, inputs, snap, &runArena(), error)) {
+        cout << "[Snapshot] Not used: " << error << "." << endl;
+        return false;
+    }
+
+    g_registry.assign(std::move(snap.stocks));
+    g_groupingKeys = std::move(snap.groupingKeys);
+    g_quantileGroups = std::move(snap.quantileGroups);
+    if (!snap.benchmark.empty()) {
+        g_iwvBenchmark.setPrices(snap.benchmark);
+        g_iwvBenchmark.CalcReturns();
+    }
+    if (snap.hasRun) {
+        g_arModel = snap.model;
+        g_modelFit = std::move(snap.fit);
+        g_returnPanel = std::move(snap.panel);
+        g_statCalc = snap.stats.release();
+        g_dataLoaded = true;
+        g_calcReady = true;
+        g_live.rebuild(g_registry, g_statCalc->getN());
+    }
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "[Snapshot] Restored " << g_registry.size() << " events";
+    if (snap.hasRun) cout << " and the Option 1 run (N = " << g_statCalc->getN()
+                          << (g_statCalc->getStdEstimate() == StdEstimate::Analytic ? ", refreshed: analytic STD" : "") << ")";
+    cout << " from " << g_snapshotFile << " in " << fixed << setprecision(1) << ms << " ms." << endl;
+    return true;
+}
+
+
+// IWV over [g_benchFrom, g_benchTo], from the archive when importing
+PriceHistory fetchBenchmark(CURL* curl)
+{
+    return g_archive.isOpen()
+        ? g_archive.load("IWV", toDayNumber(g_benchFrom), toDayNumber(g_benchTo))  // [From PriceArchive.h]
+        : FetchPriceSeriesWithDates(curl, "IWV", g_benchFrom, g_benchTo);
+}
+
+// Option 1 after the prompts: benchmark, price pull, model fit and bootstrap. Runs on
+// g_runThread and sets the run globals; each committed event also feeds g_live
+bool pullAndCompute(int g_N, EstimationWindow estWindow, ostream& out)
+{
+    // No handle in offline import; curl_easy_cleanup(nullptr) does nothing
+    CURL* curl = nullptr;
+    if (!g_archive.isOpen()) {
+        curl = curl_easy_init();
+        if (!curl) { cerr << "CURL Init failed" << endl; return false; }
+    }
+
+    // --- B. Access Benchmark (IWV) ---
+    out << "Fetching Benchmark (IWV)..." << endl;
+    PriceHistory iwvPrices = fetchBenchmark(curl);
+    if (iwvPrices.empty()) {cerr << "[Error] Failed to download IWV." << endl; curl_easy_cleanup(curl); return false;}
+    
+    // Process IWV
+    g_iwvBenchmark.setPrices(iwvPrices); 
+    g_iwvBenchmark.CalcReturns();  
+
+    // Form Trading Calendar
+    map<string, double> iwvMap;
+    for (size_t i = 0; i < iwvPrices.size(); ++i) iwvMap[formatDay(iwvPrices.days[i])] = iwvPrices.prices[i];
+    vector<string> tradingDays = createTradingDaysList(iwvMap);
+    out << "    -> Trading Calendar built (" << tradingDays.size() << " days)." << endl;
+    
+    // --- C. Download all stock data in parallel ---
+    out << "Fetching prices for " << g_registry.size() << " events..." << endl;
+    Diagnostics diagnostics;
+    map<string, string> dateWarns;
+
+
+    // Multithreaded download, filling in the "prices" and "returns"
+    SETALLStocks(g_registry, iwvMap, g_N, diagnostics, dateWarns, 1 - estWindow.start,
+                 g_journal.isOpen() ? &g_journal : nullptr,
+                 g_archive.isOpen() ? &g_archive : nullptr,
+                 [](EventId, const Stock& s) { g_live.commit(s.getGroup(), s.getAbnormReturns()); },
+                 out);
+    if (g_journal.isOpen()) {
+        out << "    [Journal] ";
+        g_journal.report(out);
+        out << endl;
+    }
+    out << "\n===== Trading Day Warnings =====\n";
+    for (const auto& p : dateWarns) {
+        if (p.second.empty()) continue;
+        out << "EventDate: " << p.first << "\n"
+            << "Warning:   " << p.second << "\n"
+            << "----------------------------------------\n";
+    }
+    out << "\n===== Stock-Level Warnings =====\n";
+    diagnostics.printWarnings(out);
+    out << "\n===== Diagnostics by Code =====\n";
+    diagnostics.printSummary(out);
+
+    // --- C2. Return panel and batched model fit over the estimation window ---
+    auto fitStart = chrono::steady_clock::now();
+    g_returnPanel = make_unique<ReturnPanel>(buildReturnPanel(g_registry, iwvMap, g_N, estWindow, &runArena()));
+    g_modelFit = fitAbnormalReturnModel(*g_returnPanel, estWindow, g_arModel);
+    double fitMs = chrono::duration<double, milli>(chrono::steady_clock::now() - fitStart).count();
+
+    int fitted = 0;
+    for (int n : g_modelFit.obs) if (n > 0) ++fitted;
+    out << ">>> Return panel: " << g_returnPanel->numEvents << " events x " << g_returnPanel->numDays()
+         << " days, estimation window [" << estWindow.start << ", " << estWindow.end << "], "
+         << fitted << " fitted in " << fixed << setprecision(1) << fitMs << " ms." << endl;
+
+    if (g_arModel == AbnormalReturnModel::MarketModel) {
+        int updated = applyAbnormalReturns(*g_returnPanel, g_modelFit, g_N, g_registry);
+        out << "    -> Market-model abnormal returns set for " << updated << " events ("
+             << g_returnPanel->numEvents - updated << " without estimation data dropped)." << endl;
+    }
+
+    // --- D. Prepare Bootstrap Data ---
+    out << ">>> Preparing Data for Bootstrap..." << endl;
+    
+    vector<Stock> beatVec, meetVec, missVec;
+    int validCount = StockGrouper::extractValidGroups(g_registry, beatVec, meetVec, missVec);
+
+    out << "    [Data Summary] Beat: " << beatVec.size() 
+         << ", Meet: " << meetVec.size() 
+         << ", Miss: " << missVec.size() 
+         << " (Total Valid: " << validCount << ")" << endl;
+
+    // --- E. Run Bootstrap and Statistical Calculations ---
+    
+    // 40 iterations, with 30 samples taken each time
+    Bootstrapper bootstrap(g_N, g_numResamples, g_sampleSize);
+    if (g_hasSeed) bootstrap.setSeed(g_seed);
+    out << "    [Bootstrap] Seed " << bootstrap.getSeed() << " (--seed reproduces this run)." << endl;
+    GroupBootstrapResult beatResult, meetResult, missResult;
+
+    bootstrap.runBootstrap(missVec, meetVec, beatVec, missResult, meetResult, beatResult);
+    
+    // Create a new statistical calculator and save to global pointer.
+    g_statCalc = new StatCalculator(g_N);
+    g_statCalc->computeForAllGroup(missResult, meetResult, beatResult);
+    g_statCalc->computeEventStudyTests(*g_returnPanel, g_modelFit, g_arModel);
+
+    out << ">>> Calculations Complete. Data ready for plotting." << endl;
+    out << "    [Run Arena] ";
+    runArena().report(out);
+    out << endl;
+
+    // Kept from here on as the sufficient statistics an incremental refresh updates
+    g_live.rebuild(g_registry, g_N);
+
+    g_calcReady = true;
+    curl_easy_cleanup(curl);
+    return true;
+
+}
+
+// g_runThread body: the report goes to g_runLogFile, one line to the terminal at the end
+void runPull(int N, EstimationWindow estWindow)
+{
+    auto start = chrono::steady_clock::now();
+    ofstream log(g_runLogFile);
+    bool ok = pullAndCompute(N, estWindow, log.is_open() ? static_cast<ostream&>(log) : cout);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    ostringstream line;
+    line << "\n[Run] Option 1 (N = " << N << ") " << (ok ? "finished" : "failed") << " in "
+         << fixed << setprecision(1) << secs << " s; report in " << g_runLogFile << "." << endl;
+    cout << line.str() << flush;
+    g_runActive = false;
+}
+
+// Collect a finished background run (or wait for it); the menu thread then owns the run globals again
+void joinRun(bool save, uint64_t inputs, bool wait = false)
+{
+    if (!g_runThread.joinable() || (g_runActive && !wait)) return;
+    g_runThread.join();
+    if (save && g_calcReady) saveSession(inputs);
+}
+// Option 7: re-read the earnings file and apply only what changed. The affected sectors
+// are regrouped; after a run, only new events are fetched, and the group
+// statistics are updated from the maintained sums in g_live instead of a new bootstrap.
+// False if the file could not be used and the loaded state is unchanged
+bool refreshUniverse(const string& earningFile, const string& sectorFile)
+{
+    auto start = chrono::steady_clock::now();
+    StockMap incoming;
+    enrichStocksWithGroupInfo(incoming, earningFile);
+    if (incoming.empty()) {
+        cerr << "[Refresh] Warning: no events in " << earningFile << "; universe unchanged." << endl;
+        return false;
+    }
+    enrichStocksWithSectorInfo(incoming, sectorFile);
+    vector<GroupingKey> keys = StockGrouper::buildGroupingKeys(incoming);
+
+    UniverseDiff diff = diffUniverse(g_groupingKeys, keys);  // [From UniverseUpdate.h]
+    cout << "[Refresh] " << diff.added.size() << " added, " << diff.removed.size() << " removed, "
+         << diff.changed.size() << " changed events";
+    if (diff.empty()) { cout << "; nothing to update." << endl; return true; }
+    cout << " in " << diff.sectors.size() << " sector(s)." << endl;
+
+    UniverseRefresh refresh = planUniverseRefresh(incoming, g_registry, diff);
+    g_groupingKeys = std::move(keys);
+    g_quantileGroups = StockGrouper::assignQuantileGroups(g_groupingKeys, StockGrouper::defaultSchemes());
+
+    // Ids change with the universe; the return panel refers to the old ones
+    g_returnPanel.reset();
+    runArena().reset();
+    g_registry.assign(std::move(refresh.stocks));
+    cout << "    -> Universe: " << g_registry.size() << " events, " << refresh.regrouped
+         << " kept in a new group, " << refresh.refetch.size() << " to fetch." << endl;
+
+    if (!g_calcReady || !g_statCalc || !g_iwvBenchmark.getHistory()) {
+        g_calcReady = false;
+        cout << "    -> No Option 1 results to update." << endl;
+        return true;
+    }
+
+    // --- Prices of the new and changed events only, on the last run's calendar ---
+    int N = g_statCalc->getN();
+    EstimationWindow estWindow;
+    estWindow.end = min(estWindow.end, -N);
+    const PriceHistory& iwvPrices = *g_iwvBenchmark.getHistory();
+    map<string, double> iwvMap;
+    for (size_t i = 0; i < iwvPrices.size(); ++i) iwvMap[formatDay(iwvPrices.days[i])] = iwvPrices.prices[i];
+
+    vector<EventId> ids;
+    ids.reserve(refresh.refetch.size());
+    for (const EventKey& k : refresh.refetch) ids.push_back(g_registry.find(k));
+    if (!ids.empty()) {
+        Diagnostics diagnostics;
+        map<string, string> dateWarns;
+        SETALLStocks(g_registry, iwvMap, N, diagnostics, dateWarns, 1 - estWindow.start,
+                     g_journal.isOpen() ? &g_journal : nullptr,
+                     g_archive.isOpen() ? &g_archive : nullptr,
+                     nullptr, cout, &ids);
+        diagnostics.printSummary(cout);
+    }
+
+    // --- Panel and model fit over the whole universe: in memory, no downloads ---
+    g_returnPanel = make_unique<ReturnPanel>(buildReturnPanel(g_registry, iwvMap, N, estWindow, &runArena()));
+    g_modelFit = fitAbnormalReturnModel(*g_returnPanel, estWindow, g_arModel);
+    if (g_arModel == AbnormalReturnModel::MarketModel) applyAbnormalReturns(*g_returnPanel, g_modelFit, N, g_registry);
+
+    // --- Group sums: out with the old contributions, in with the new ---
+    for (size_t i = 0; i < ids.size(); ++i) {
+        g_registry.read(ids[i], [&](const Stock& s) { refresh.pending[i].toReturns = s.getAbnormReturns(); });
+        refresh.changes.push_back(std::move(refresh.pending[i]));
+    }
+    g_live.update(refresh.changes, g_registry.size());
+
+    LiveGroupSnapshot sums = g_live.snapshot();
+    StatCalculator* calc = new StatCalculator(N);
+    calc->restore(sums.miss.estimate(g_sampleSize), sums.meet.estimate(g_sampleSize), sums.beat.estimate(g_sampleSize), {}, {}, {},
+                  StdEstimate::Analytic);
+    calc->computeEventStudyTests(*g_returnPanel, g_modelFit, g_arModel);
+    delete g_statCalc;
+    g_statCalc = calc;
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "[Refresh] Group statistics updated from " << refresh.changes.size() << " event change(s) (Beat: "
+         << sums.beat.count() << ", Meet: " << sums.meet.count() << ", Miss: " << sums.miss.count()
+         << ") in " << fixed << setprecision(1) << ms << " ms." << endl;
+    cout << "    -> AAR / CAAR are exact group means, STD the analytic sd / sqrt(30); Option 1 re-runs the bootstrap." << endl;
+    return true;
+}
+
+// ./main --batch <scenarios.csv> [--out <dir>]: every scenario of the file without the menu
+int runBatch(const string& scenarioFile, const string& outDir)
+{
+    vector<Scenario> scenarios;
+    string error;
+    if (!loadScenarios(scenarioFile, scenarios, error)) {  // [From BatchRunner.h]
+        cerr << "[Batch] " << error << endl;
+        return 1;
+    }
+    cout << "[Batch] " << scenarios.size() << " scenario(s) from " << scenarioFile << "." << endl;
+
+    CURL* curl = g_archive.isOpen() ? nullptr : curl_easy_init();
+    PriceHistory iwvPrices = fetchBenchmark(curl);
+    curl_easy_cleanup(curl);
+    if (iwvPrices.empty()) { cerr << "[Error] Failed to download IWV." << endl; return 1; }
+
+    map<string, double> iwvMap;
+    for (size_t i = 0; i < iwvPrices.size(); ++i) iwvMap[formatDay(iwvPrices.days[i])] = iwvPrices.prices[i];
+
+    BatchRunner runner(g_registry, g_groupingKeys, iwvMap,
+                       g_journal.isOpen() ? &g_journal : nullptr,
+                       g_archive.isOpen() ? &g_archive : nullptr);
+    return runner.run(scenarios, outDir, cout) ? 0 : 1;
+}
+
+// ./main --serve <socket>: answer queries over a Unix domain socket until SIGINT / SIGTERM.
+// Serves the snapshot's run if there is one, otherwise runs Option 1 with the defaults first
+int runServe(const string& socketPath, bool save, uint64_t inputs)
+{
+    if (!g_calcReady || !g_statCalc) {
+        cout << "[Serve] No Option 1 results; running it with N = " << default_N << " first." << endl;
+        EstimationWindow estWindow;
+        estWindow.end = min(estWindow.end, -default_N);
+        g_live.reset(default_N, g_registry.size());
+        g_dataLoaded = true;
+        if (!pullAndCompute(default_N, estWindow, cout)) return 1;
+        if (save) saveSession(inputs);
+    }
+
+    AnalysisServer server;  // [From AnalysisServer.h]
+    server.publish(captureServerState(g_registry, *g_statCalc, g_arModel));
+    string error;
+    if (!server.serve(socketPath, cout, error)) {
+        cerr << "[Serve] " << error << endl;
+        return 1;
+    }
+    return 0;
+}
+
+// ./main --shard <k>/<n> --seed <s>: pull and compute one shard of the universe, swap the
+// lists of usable events with the other shards through <dir>, then write its part of every
+// bootstrap resample to <dir>/shard_<k>_of_<n>.bin. Any host with the same input CSVs can
+// run any shard; all shards of a run need the same seed and a shared <dir>
+int runShard(uint32_t shard, uint32_t shards, int N, AbnormalReturnModel model,
+             const string& dir, uint64_t seed, uint64_t inputs)
+{
+    auto start = chrono::steady_clock::now();
+    EstimationWindow estWindow;
+    estWindow.end = min(estWindow.end, -N);
+    vector<EventId> ids = shardEvents(g_registry, shard, shards);  // [From ShardStats.h]
+    cout << "[Shard] " << shard << " of " << shards << ": " << ids.size() << " of "
+         << g_registry.size() << " events (N = " << N << ")." << endl;
+
+    CURL* curl = g_archive.isOpen() ? nullptr : curl_easy_init();
+    PriceHistory iwvPrices = fetchBenchmark(curl);
+    curl_easy_cleanup(curl);
+    if (iwvPrices.empty()) { cerr << "[Error] Failed to download IWV." << endl; return 1; }
+    map<string, double> iwvMap;
+    for (size_t i = 0; i < iwvPrices.size(); ++i) iwvMap[formatDay(iwvPrices.days[i])] = iwvPrices.prices[i];
+
+    Diagnostics diagnostics;
+    map<string, string> dateWarns;
+    SETALLStocks(g_registry, iwvMap, N, diagnostics, dateWarns, 1 - estWindow.start,
+                 g_journal.isOpen() ? &g_journal : nullptr,
+                 g_archive.isOpen() ? &g_archive : nullptr,
+                 nullptr, cout, &ids);
+    diagnostics.printSummary(cout);
+
+    // The market model is fitted per event, so a shard's fit needs only its own events
+    if (model == AbnormalReturnModel::MarketModel) {
+        ReturnPanel panel = buildReturnPanel(g_registry, iwvMap, N, estWindow, &runArena());
+        MarketModelFit fit = fitAbnormalReturnModel(panel, estWindow, model);
+        applyAbnormalReturns(panel, fit, N, g_registry);
+    }
+
+    // Publish the shard's usable events, then wait for every other shard's, so all shards
+    // draw over the groups Option 1 would draw over
+    ShardValidity own;
+    own.inputs = inputs;
+    own.N = N;
+    own.model = model;
+    own.shard = shard;
+    own.shards = shards;
+    own.seed = seed;
+    own.events = shardValidEvents(g_registry, ids);  // [From ShardStats.h]
+    error_code ec;
+    filesystem::create_directories(dir, ec);
+    string error;
+    if (!writeShardValidity((filesystem::path(dir) / shardValidityFileName(shard, shards)).string(), own, error)) {
+        cerr << "[Shard] " << error << endl;
+        return 1;
+    }
+    vector<EventId> valid;
+    for (uint32_t k = 0; k < shards; ++k) {
+        string path = (filesystem::path(dir) / shardValidityFileName(k, shards)).string();
+        ShardValidity other;
+        bool announced = false;
+        while (!readShardValidity(path, other, error)) {
+            if (filesystem::exists(path)) { cerr << "[Shard] " << error << endl; return 1; }
+            if (!announced) cout << "[Shard] Waiting for " << path << "..." << endl;
+            announced = true;
+            this_thread::sleep_for(chrono::milliseconds(200));
+        }
+        if (other.inputs != inputs || other.N != N || other.model != model || other.seed != seed || other.shard != k) {
+            cerr << "[Shard] " << path << " is from another run (input CSVs, N, model or seed differ)." << endl;
+            return 1;
+        }
+        valid.insert(valid.end(), other.events.begin(), other.events.end());
+    }
+
+    ShardPartial partial;
+    partial.inputs = inputs;
+    partial.N = N;
+    partial.model = model;
+    partial.shard = shard;
+    partial.shards = shards;
+    partial.seed = seed;
+    partial.resamples = g_numResamples;
+    partial.sampleSize = g_sampleSize;
+    bootstrapShard(g_registry, ids, valid, partial);  // [From ShardStats.h]
+
+    string path = (filesystem::path(dir) / shardFileName(shard, shards)).string();
+    if (!writeShardPartial(path, partial, error)) {
+        cerr << "[Shard] " << error << endl;
+        return 1;
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "[Shard] " << partial.usable << " events with abnormal returns (Beat: " << partial.beat.usable
+         << ", Meet: " << partial.meet.usable << ", Miss: " << partial.miss.usable << "); their draws under seed "
+         << seed << " written to " << path << " in " << fixed << setprecision(1) << secs << " s." << endl;
+    return 0;
+}
+
+// Merge shard results into the group statistics of the whole universe. Each resample is the
+// exact sum of the shards' parts, so the statistics are those of an Option 1 run with the
+// same seed, bit for bit, for any number of shards
+int mergeShards(const vector<string>& paths, const string& dir, uint64_t inputs)
+{
+    vector<ShardPartial> partials(paths.size());
+    string error;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!readShardPartial(paths[i], partials[i], error)) { cerr << "[Merge] " << error << endl; return 1; }
+    }
+    ShardPartial merged;
+    if (!mergeShardPartials(partials, merged, error)) { cerr << "[Merge] " << error << endl; return 1; }
+    if (merged.inputs != inputs) {
+        cerr << "[Merge] The shards were run on other input CSVs than those in this directory." << endl;
+        return 1;
+    }
+
+    const int N = merged.N;
+    StatCalculator calc(N);
+    calc.computeForAllGroup(Bootstrapper::resultFromSums(merged.miss.draws),
+                            Bootstrapper::resultFromSums(merged.meet.draws),
+                            Bootstrapper::resultFromSums(merged.beat.draws));
+    const Matrix& result = calc.getResultMatrix();
+
+    cout << "[Merge] " << partials.size() << " shard(s), " << merged.events << " events, "
+         << merged.usable << " with abnormal returns (N = " << N << ", "
+         << (merged.model == AbnormalReturnModel::MarketModel ? "market model" : "market-adjusted")
+         << ", seed " << merged.seed << ")." << endl;
+    cout << left << setw(W_COL) << "Group" << setw(W_COL) << "Events" << setw(W_COL) << "Exp AAR"
+         << setw(W_COL) << "AAR STD" << setw(W_COL) << "Exp CAAR" << setw(W_COL) << "CAAR STD" << "\n";
+    const char* names[3] = { "Miss", "Meet", "Beat" };
+    const ShardGroup* groups[3] = { &merged.miss, &merged.meet, &merged.beat };
+    for (int g = 0; g < 3; ++g) {
+        cout << left << setw(W_COL) << names[g] << setw(W_COL) << groups[g]->usable << fixed << setprecision(6);
+        for (int c = 0; c < 4; ++c) cout << setw(W_COL) << result[g][c];
+        cout << "\n";
+    }
+
+    // 17 digits round-trip every double, so result files of two splits compare exactly
+    string file = (filesystem::path(dir) / "merged.csv").string();
+    ofstream out(file);
+    out << "group,events,t,AAR_mean,AAR_std,CAAR_mean,CAAR_std\n" << setprecision(17);
+    const GroupStats* stats[3] = { &calc.getMissStats(), &calc.getMeetStats(), &calc.getBeatStats() };
+    for (int g = 0; g < 3; ++g) {
+        for (size_t d = 0; d < stats[g]->AAR_mean.size(); ++d) {
+            out << names[g] << ',' << groups[g]->usable << ',' << static_cast<int>(d) - N + 1 << ','
+                << stats[g]->AAR_mean[d] << ',' << stats[g]->AAR_std[d] << ','
+                << stats[g]->CAAR_mean[d] << ',' << stats[g]->CAAR_std[d] << '\n';
+        }
+    }
+    if (!out.flush()) { cerr << "[Merge] Cannot write " << file << endl; return 1; }
+    cout << "    -> Time series in " << file << endl;
+    return 0;
+}
+
+// ./main --merge <dir>: merge every shard file in dir, e.g. collected from several hosts
+int mergeShardDir(const string& dir, uint64_t inputs)
+{
+    vector<string> paths;
+    error_code ec;
+    for (const auto& entry : filesystem::directory_iterator(dir, ec)) {
+        string name = entry.path().filename().string();
+        if (name.rfind("shard_", 0) == 0 && entry.path().extension() == ".bin") paths.push_back(entry.path().string());
+    }
+    sort(paths.begin(), paths.end());
+    if (paths.empty()) { cerr << "[Merge] No shard files in " << dir << "." << endl; return 1; }
+    return mergeShards(paths, dir, inputs);
+}
+
+// ./main --shards <n>: run every shard as a local worker process (this program with
+// --shard k/n, output in <dir>/shard_<k>_of_<n>.log), wait for all, then merge. The workers
+// share one seed (--seed, else a new one) and split the host's API quota between them; if
+// one fails, the rest are stopped, since they wait for its validity list.
+int runShards(uint32_t shards, int N, AbnormalReturnModel model, const string& dir,
+              const vector<string>& sessionFlags, uint64_t inputs)
+{
+    error_code ec;
+    filesystem::create_directories(dir, ec);
+    string self = filesystem::read_symlink("/proc/self/exe", ec).string();
+    if (self.empty()) { cerr << "[Shards] Cannot locate this program." << endl; return 1; }
+
+    uint64_t seed = g_seed;
+    if (!g_hasSeed) {
+        random_device rd;
+        seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+    int qps = max(1, kApiQpsLimit / static_cast<int>(shards));  // [From CurlUtils.h]
+
+    auto start = chrono::steady_clock::now();
+    map<pid_t, uint32_t> workers;
+    vector<string> paths, logs;
+    for (uint32_t k = 0; k < shards; ++k) {
+        vector<string> args = { self, "--shard", to_string(k) + "/" + to_string(shards), "--n", to_string(N),
+                                "--model", model == AbnormalReturnModel::MarketModel ? "2" : "1", "--shard-dir", dir,
+                                "--seed", to_string(seed), "--qps", to_string(qps) };
+        args.insert(args.end(), sessionFlags.begin(), sessionFlags.end());
+        vector<char*> argv;
+        for (string& a : args) argv.push_back(&a[0]);
+        argv.push_back(nullptr);
+        paths.push_back((filesystem::path(dir) / shardFileName(k, shards)).string());
+        logs.push_back(filesystem::path(paths.back()).replace_extension(".log").string());
+        remove(paths.back().c_str());  // a result left by an earlier run must not be merged
+        remove((filesystem::path(dir) / shardValidityFileName(k, shards)).string().c_str());  // nor its validity list
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            int fd = open(logs.back().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd >= 0) { dup2(fd, 1); dup2(fd, 2); close(fd); }
+            execv(self.c_str(), argv.data());
+            _exit(127);
+        }
+        if (pid < 0) { cerr << "[Shards] Cannot start shard " << k << "." << endl; break; }
+        workers[pid] = k;
+    }
+    cout << "[Shards] " << workers.size() << " worker process(es) started with seed " << seed << " and "
+         << qps << " API requests/s each; logs in " << dir << "." << endl;
+
+    bool ok = workers.size() == shards;
+    while (!workers.empty()) {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) break;
+        auto it = workers.find(pid);
+        if (it == workers.end()) continue;
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        bool done = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        cout << "    -> Shard " << it->second << " " << (done ? "finished" : "FAILED") << " after "
+             << fixed << setprecision(1) << secs << " s" << (done ? "." : "; see " + logs[it->second] + ".") << endl;
+        ok = ok && done;
+        workers.erase(it);
+        // The others would wait for the failed shard's validity list forever
+        if (!done) for (const auto& w : workers) kill(w.first, SIGTERM);
+    }
+    if (!ok) return 1;
+    return mergeShards(paths, dir, inputs);
+}
+
+// The running Option 1's groups so far in the shape of its final results, without the
+// event-study tests. Prints the progress and, per group, how far the final CAAR may still move
+unique_ptr<StatCalculator> liveEstimate(LiveGroupSnapshot& live, ostream& os)
+{
+    live = g_live.snapshot();
+    auto calc = make_unique<StatCalculator>(live.N);
+    calc->restore(live.miss.estimate(g_sampleSize), live.meet.estimate(g_sampleSize), live.beat.estimate(g_sampleSize), {}, {}, {},
+                  StdEstimate::Analytic);
+
+    size_t pct = live.total == 0 ? 0 : live.completed * 100 / live.total;
+    os << "\n[Live] Option 1 in progress: " << live.completed << "/" << live.total
+       << " events (" << pct << "%), market-adjusted AR until the run completes.\n";
+    const EventGroup groups[3] = { EventGroup::Miss, EventGroup::Meet, EventGroup::Beat };
+    const GroupStats* stats[3] = { &calc->getMissStats(), &calc->getMeetStats(), &calc->getBeatStats() };
+    for (int g = 0; g < 3; ++g) {
+        const GroupAccumulator& acc = live.group(groups[g]);
+        os << "       " << left << setw(5) << eventGroupName(groups[g]) << " n = " << setw(5) << acc.count()
+           << " final CAAR " << fixed << setprecision(6)
+           << (stats[g]->CAAR_mean.empty() ? 0.0 : stats[g]->CAAR_mean.back())
+           << " +/- " << 1.96 * acc.finalCAARStdErr() << " (95%)\n";
+    }
+    return calc;
+}
+
+
+// Whole-string unsigned decimal for a command-line value; false on anything else
+bool parseArgNumber(const string& text, uint64_t& value)
+{
+    if (text.empty() || text.find_first_not_of("0123456789") != string::npos) return false;
+    try { value = stoull(text); } catch (const out_of_range&) { return false; }
+    return true;
+}
+
+int main(int argc, char* argv[]) 
+{
+    // Executor microbenchmark: ./main --bench-pool [tasks] [workers]
+    if (argc >= 2 && string(argv[1]) == "--bench-pool") {
+        uint64_t tasks = 1000000, workers = max(1u, thread::hardware_concurrency());
+        if ((argc >= 3 && (!parseArgNumber(argv[2], tasks) || tasks == 0))
+            || (argc >= 4 && (!parseArgNumber(argv[3], workers) || workers == 0 || workers > 1024))) {
+            cerr << "[Bench] Expected --bench-pool [tasks >= 1] [workers 1-1024]." << endl;
+            return 1;
+        }
+        ExecutorBenchmark b = benchmarkExecutors(tasks, workers); // [From ThreadUtils.h]
+        cout << fixed << setprecision(0);
+        cout << "Tiny tasks: " << b.tasks << ", workers: " << b.workers << "\n";
+        cout << "  ThreadPool2 (single locked queue) : " << b.threadPool2PerSec << " tasks/s\n";
+        cout << "  WorkStealingPool (external)       : " << b.workStealingPerSec << " tasks/s\n";
+        cout << "  WorkStealingPool (nested fan-out) : " << b.workStealingNestedPerSec << " tasks/s\n";
+        cout << "  parallel_for (auto grain)         : " << b.parallelForPerSec << " items/s\n";
+        return 0;
+    }
+
+    // Log kernel accuracy check: ./main --check-log-kernel [samples]
+    if (argc >= 2 && string(argv[1]) == "--check-log-kernel") {
+        uint64_t samples = 1000000;
+        if (argc >= 3 && (!parseArgNumber(argv[2], samples) || samples == 0)) {
+            cerr << "[LogKernel] Expected --check-log-kernel [samples >= 1]." << endl;
+            return 1;
+        }
+        vector<LogKernelAccuracy> results = checkLogKernel(samples); // [From LogKernel.h]
+        printLogKernelCheck(results, cout);
+        bool passed = all_of(results.begin(), results.end(),
+                             [](const LogKernelAccuracy& r) { return r.passed; });
+        return passed ? 0 : 1;
+    }
+
     curl_global_init(CURL_GLOBAL_ALL);
 
     // ---------------------------------------------------------
     // Phase 1: Static data download and initialization
     // ---------------------------------------------------------
-
-    // ---------------------------------------------------------
-    // Step 1: Read the CSV into a Map
-    // ---------------------------------------------------------
     string earningFile = "Russell3000EarningsAnnouncements.csv";
-    cout << "[Step 1] Loading earnings data directly into Map..." << endl;
-    enrichStocksWithGroupInfo(g_stockMap, earningFile); // [From StockUtils.h] read CSV and populate Map
-    if (g_stockMap.empty()) {cerr << "[Error] Failed to load stocks. Please check the CSV file." << endl; return 1;}
-    cout << "   -> Loaded " << g_stockMap.size() << " records." << endl;
-
-    // ---------------------------------------------------------
-    // Step 2: Add Sector and Company Name information
-    // ---------------------------------------------------------
-    cout << "[Step 2] Enriching stocks with Sector/Name info..." << endl;
     string sectorFile = "iShares-Russell-3000-ETF_fund.csv"; 
-    enrichStocksWithSectorInfo(g_stockMap, sectorFile); // [From StockUtils.h] add sector info
-    cout << "   -> Enrichment complete." << endl;
 
+    // A snapshot of the same input CSVs skips Steps 1-5; ./main --no-snapshot always rebuilds
+    // Session flags may be combined, e.g. --no-snapshot --import <path>
+    bool useSnapshot = true;
+    bool usePrefetch = true;
+    string importPath;
+    string batchFile;
+    string batchOut = "fre_batch";
+    string servePath;
+    string shardSpec;
+    string mergeDir;
+    string shardDir = "fre_shards";
+    string shardCountText, shardNText, seedText, qpsText;
+    AbnormalReturnModel shardModel = AbnormalReturnModel::MarketAdjusted;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--no-snapshot") useSnapshot = false;
+        else if (arg == "--no-prefetch") usePrefetch = false;
+        else if (arg == "--import" && i + 1 < argc) importPath = argv[++i];
+        else if (arg == "--batch" && i + 1 < argc) batchFile = argv[++i];
+        else if (arg == "--out" && i + 1 < argc) batchOut = argv[++i];
+        else if (arg == "--serve" && i + 1 < argc) servePath = argv[++i];
+        else if (arg == "--shards" && i + 1 < argc) shardCountText = argv[++i];
+        else if (arg == "--shard" && i + 1 < argc) shardSpec = argv[++i];
+        else if (arg == "--merge" && i + 1 < argc) mergeDir = argv[++i];
+        else if (arg == "--shard-dir" && i + 1 < argc) shardDir = argv[++i];
+        else if (arg == "--n" && i + 1 < argc) shardNText = argv[++i];
+        else if (arg == "--seed" && i + 1 < argc) seedText = argv[++i];
+        else if (arg == "--qps" && i + 1 < argc) qpsText = argv[++i];
+        else if (arg == "--model" && i + 1 < argc)
+            shardModel = string(argv[++i]) == "2" ? AbnormalReturnModel::MarketModel : AbnormalReturnModel::MarketAdjusted;
+    }
 
-    // ---------------------------------------------------------
-    // Step 3: Prepare for Grouping (Split by Sector)
-    // ---------------------------------------------------------
-    cout << "[Step 3] Organizing stocks by Sector..." << endl;
-    auto sectorMap = StockGrouper::splitStocksBySector(g_stockMap); // [From StockGrouper.h]
-    cout << "   -> Organized stocks into sector map (raw size: " << sectorMap.size() << " keys)." << endl;
+    // Sharded run: --shard k/n is one worker process, --shards n starts n local workers and merges
+    uint32_t shardIndex = 0, shardTotal = 0;
+    if (!shardSpec.empty()) {
+        size_t slash = shardSpec.find('/');
+        uint64_t k = 0, n = 0;
+        if (slash == string::npos || !parseArgNumber(shardSpec.substr(0, slash), k)
+            || !parseArgNumber(shardSpec.substr(slash + 1), n) || n == 0 || n > UINT32_MAX || k >= n) {
+            cerr << "[Shard] Expected --shard <k>/<n> with 0 <= k < n." << endl;
+            return 1;
+        }
+        shardIndex = static_cast<uint32_t>(k);
+        shardTotal = static_cast<uint32_t>(n);
+    }
+    // Local workers share the host's API quota: each gets an equal part of it, at least 1 QPS
+    uint32_t shardCount = 0;
+    if (!shardCountText.empty()) {
+        uint64_t n = 0;
+        if (!parseArgNumber(shardCountText, n) || n < 1 || n > static_cast<uint64_t>(kApiQpsLimit)) {
+            cerr << "[Shards] Expected --shards <n> with 1 <= n <= " << kApiQpsLimit << "." << endl;
+            return 1;
+        }
+        shardCount = static_cast<uint32_t>(n);
+    }
+    int shardN = default_N;
+    if (!shardNText.empty()) {
+        uint64_t n = 0;
+        if (!parseArgNumber(shardNText, n) || n < 30 || n > 60) {
+            cerr << "[Shard] Expected --n <N> with 30 <= N <= 60." << endl;
+            return 1;
+        }
+        shardN = static_cast<int>(n);
+    }
+    if (!seedText.empty()) {
+        if (!parseArgNumber(seedText, g_seed)) {
+            cerr << "[Seed] Expected --seed <non-negative integer>." << endl;
+            return 1;
+        }
+        g_hasSeed = true;
+    }
+    if (!qpsText.empty()) {
+        uint64_t qps = 0;
+        if (!parseArgNumber(qpsText, qps) || qps < 1 || qps > static_cast<uint64_t>(kApiQpsLimit)) {
+            cerr << "[Shard] Expected --qps <q> with 1 <= q <= " << kApiQpsLimit << "." << endl;
+            return 1;
+        }
+        apiLimiter().set_qps_limit(static_cast<int>(qps));  // [From CurlUtils.h]
+    }
+    if (shardTotal && !g_hasSeed) {
+        cerr << "[Shard] --shard needs --seed <s>, the same for every shard of the run." << endl;
+        return 1;
+    }
+    vector<string> sessionFlags;  // passed on to the workers of --shards
+    if (!useSnapshot) sessionFlags.push_back("--no-snapshot");
+    if (!importPath.empty()) { sessionFlags.push_back("--import"); sessionFlags.push_back(importPath); }
 
+    // Offline import: price histories come from a directory or tar file of per-ticker CSVs
+    if (!importPath.empty()) {
+        string error;
+        if (!g_archive.open(importPath, error)) {
+            cerr << "[Import] " << error << endl;
+            return 1;
+        }
+        cout << "[Import] " << g_archive.size() << " ticker files in " << g_archive.path()
+             << "; Option 1 will not use the network." << endl;
+    }
+    uint64_t inputsFingerprint = fingerprintInputs({ earningFile, sectorFile }, importPath); // [From Snapshot.h]
+    bool restored = useSnapshot && restoreSession(inputsFingerprint);
 
-    // ---------------------------------------------------------
-    // Step 4: Execute the Core Grouping Logic (Beat/Meet/Miss)
-    // ---------------------------------------------------------
-    cout << "[Step 4] Running Sector-Neutral Grouping Algorithm..." << endl;
-    StockGrouper grouper;  // [From StockGrouper.h]
-    grouper.processAllSectors(sectorMap);  // [From StockGrouper.h] execute grouping logic
-    grouper.printGroupSummary();  // [From StockGrouper.h] Write the group labels back to the global variable g_stockMap
+    if (!restored)
+    {
+        // ---------------------------------------------------------
+        // Step 1: Read the CSV into a Map
+        // ---------------------------------------------------------
+        StockMap stockMap;  // [From StockStructure.h] loading and grouping only, frozen into g_registry in Step 5
+        cout << "[Step 1] Loading earnings data directly into Map..." << endl;
+        enrichStocksWithGroupInfo(stockMap, earningFile); // [From StockUtils.h] read CSV and populate Map
+        if (stockMap.empty()) {cerr << "[Error] Failed to load stocks. Please check the CSV file." << endl; return 1;}
+        cout << "   -> Loaded " << stockMap.size() << " records." << endl;
 
+        // ---------------------------------------------------------
+        // Step 2: Add Sector and Company Name information
+        // ---------------------------------------------------------
+        cout << "[Step 2] Enriching stocks with Sector/Name info..." << endl;
+        enrichStocksWithSectorInfo(stockMap, sectorFile); // [From StockUtils.h] add sector info
+        cout << "   -> Enrichment complete." << endl;
 
-    // ---------------------------------------------------------
-    // Step 5: Update the Global Map
-    // ---------------------------------------------------------
-    cout << "[Step 5] Syncing groups to Global Map..." << endl;
-    grouper.updateMapWithGroups(g_stockMap);  // [From StockGrouper.h]
-    cout << "[Success] Phase 1 Complete. Ready for Menu." << endl;
-    cout << "   -> Final Global Map Size: " << g_stockMap.size() << endl;
+
+        // ---------------------------------------------------------
+        // Step 3: Prepare for Grouping (Split by Sector)
+        // ---------------------------------------------------------
+        cout << "[Step 3] Organizing stocks by Sector..." << endl;
+        auto sectorMap = StockGrouper::splitStocksBySector(stockMap); // [From StockGrouper.h]
+        cout << "   -> Organized stocks into sector map (raw size: " << sectorMap.size() << " keys)." << endl;
+
+
+        // ---------------------------------------------------------
+        // Step 4: Execute the Core Grouping Logic (Beat/Meet/Miss)
+        // ---------------------------------------------------------
+        cout << "[Step 4] Running Sector-Neutral Grouping Algorithm..." << endl;
+        StockGrouper grouper;  // [From StockGrouper.h]
+        grouper.processAllSectors(sectorMap);  // [From StockGrouper.h] execute grouping logic
+        grouper.printGroupSummary();  // [From StockGrouper.h] Write the group labels back to the map
+
+        // Label the full universe under terciles / quintiles / deciles in one pass for the CAAR ladder
+        g_groupingKeys = StockGrouper::buildGroupingKeys(stockMap);
+        g_quantileGroups = StockGrouper::assignQuantileGroups(g_groupingKeys, StockGrouper::defaultSchemes());
+        cout << "   -> Quantile labels ready for " << g_quantileGroups.schemes.size() << " schemes." << endl;
+
+
+        // ---------------------------------------------------------
+        // Step 5: Update the Global Map
+        // ---------------------------------------------------------
+        cout << "[Step 5] Syncing groups to Global Map..." << endl;
+        grouper.updateMapWithGroups(stockMap);  // [From StockGrouper.h]
+        g_registry.assign(std::move(stockMap));  // [From StockRegistry.h] ids fixed from here on
+        cout << "[Success] Phase 1 Complete. Ready for Menu." << endl;
+        cout << "   -> Final Global Map Size: " << g_registry.size() << endl;
+        if (useSnapshot && !shardTotal) saveSession(inputsFingerprint);  // workers share one snapshot, read-only
+    }
+
+    // Resume from the journal: Option 1 fetches only ranges not downloaded by an earlier
+    // run or by the prefetcher. An offline import has nothing to resume and is not journaled
+    // A shard worker keeps its own journal next to its result, as workers may run side by side
+    if (!g_archive.isOpen()) {
+        string journalFile = g_journalFile;
+        if (shardTotal) {
+            error_code ec;
+            filesystem::create_directories(shardDir, ec);
+            journalFile = (filesystem::path(shardDir) / shardFileName(shardIndex, shardTotal)).replace_extension(".journal").string();
+        }
+        string journalError;
+        if (!g_journal.open(journalFile, journalError))
+            cerr << "[Journal] Warning: " << journalError << "; downloading without a journal." << endl;
+    }
+
+    // Headless: run the scenario file and exit instead of showing the menu
+    if (!batchFile.empty()) {
+        int status = runBatch(batchFile, batchOut);
+        curl_global_cleanup();
+        return status;
+    }
+
+    // Daemon: the results stay in memory and are queried over the socket instead of the menu
+    if (!servePath.empty()) {
+        int status = runServe(servePath, useSnapshot, inputsFingerprint);
+        curl_global_cleanup();
+        return status;
+    }
+
+    // Sharded: one worker, all workers on this host, or the merge of collected shard files
+    if (shardTotal || shardCount || !mergeDir.empty()) {
+        int status = shardTotal ? runShard(shardIndex, shardTotal, shardN, shardModel, shardDir, g_seed, inputsFingerprint)
+                   : shardCount ? runShards(shardCount, shardN, shardModel, shardDir, sessionFlags, inputsFingerprint)
+                                : mergeShardDir(mergeDir, inputsFingerprint);
+        curl_global_cleanup();
+        return status;
+    }
+
+    // Use the menu's idle time: fetch the ranges any N in [30, 60] needs into the journal.
+    // Not after a restored run: its results are ready, and a new N reads the journal anyway
+    if (usePrefetch && g_journal.isOpen() && g_calcReady) {
+        cout << "[Prefetch] Skipped: the snapshot holds a completed Option 1 run." << endl;
+    }
+    else if (usePrefetch && g_journal.isOpen()) {
+        vector<EventKey> events;
+        events.reserve(g_registry.size());
+        for (size_t e = 0; e < g_registry.size(); ++e) events.push_back(g_registry.key(static_cast<EventId>(e)));
+        g_prefetcher.start(std::move(events), g_benchFrom, g_benchTo, 30, 60,
+                           1 - EstimationWindow().start, g_journal);  // [From Prefetcher.h]
+        cout << "[Prefetch] Downloading price histories in the background." << endl;
+    }
     cout << "===============================================" << endl;
 
 
@@ -88,12 +939,19 @@ int main()
     int choice;
     while(true) 
     {
+        if (g_runActive) {
+            LiveGroupSnapshot live = g_live.snapshot();
+            cout << "\n[Run] Option 1 in progress: " << live.completed << "/" << live.total << " events." << endl;
+        }
         cout << "\n---------------- MENU ----------------" << endl;
         cout << "1. Enter N and Pull Data" << endl;
         cout << "2. Show Stock Info" << endl;
         cout << "3. Show Group Stats" << endl;
         cout << "4. Plot Results" << endl;
-        cout << "5. Exit" << endl;
+        cout << "5. Sample-Size Sweep" << endl;
+        cout << "6. Quantile CAAR Ladder" << endl;
+        cout << "7. Refresh Earnings File" << endl;
+        cout << "8. Exit" << endl;
         cout << "Enter Choice: ";
         cin >> choice;
 
@@ -103,93 +961,59 @@ int main()
             cout << "Invalid input. Please enter a number.\n";
             continue; }
 
+        // A background run that has finished hands its results to the menu here
+        joinRun(useSnapshot, inputsFingerprint);
+
 
         // =================================================
         // Option 1: Enter the time range and process the data
         // =================================================
         if (choice == 1) 
         {
+            if (g_runActive) { cout << "Option 1 is already running; see Option 3 for its progress." << endl; continue; }
+
             // --- A. User Input ---
             cout << "Enter N (30 <= N <= 60): "; 
             int g_N;
             cin >> g_N;
             if (g_N < 30) { g_N = default_N; cout << "[Warn] N too small, set to 60." << endl; }
             if (g_N > 60) { g_N = default_N; cout << "[Warn] N too large, set to 60." << endl; }
-    
-            CURL* curl = curl_easy_init();
-            if (!curl) { cerr << "CURL Init failed" << endl; continue; }
 
-            // --- B. Access Benchmark (IWV) ---
-            cout << "Fetching Benchmark (IWV)..." << endl;
-            vector<PriceData> iwvPrices = FetchPriceSeriesWithDates(curl, "IWV", "2023-12-01", "2025-12-30", ""); 
-            if (iwvPrices.empty()) {cerr << "[Error] Failed to download IWV." << endl; curl_easy_cleanup(curl); continue;}
-            
-            // Process IWV
-            g_iwvBenchmark.setPrices(iwvPrices); 
-            g_iwvBenchmark.getAdjClosePrice();  
-            g_iwvBenchmark.CalcReturns();  
-
-            // Form Trading Calendar
-            map<string, double> iwvMap;
-            for (auto& p : iwvPrices) iwvMap[p.date] = p.price;
-            vector<string> tradingDays = createTradingDaysList(iwvMap);
-            cout << "    -> Trading Calendar built (" << tradingDays.size() << " days)." << endl;
-            
-            // --- C. Download all stock data in parallel ---
-            cout << "Fetching prices for " << g_stockMap.size() << " stocks..." << endl;
-            vector<string> warns;
-            map<string, string> dateWarns;
-            
-            // Multithreaded download, filling in the "prices" and "returns"
-            SETALLStocks(g_stockMap, iwvMap, g_N, warns, dateWarns); 
-            cout << "\n===== Trading Day Warnings =====\n";
-            for (const auto& p : dateWarns) {
-                if (p.second.empty()) continue;
-                cout << "EventDate: " << p.first << "\n"
-                    << "Warning:   " << p.second << "\n"
-                    << "----------------------------------------\n";
-            }
-            cout << "\n===== Stock-Level Warnings =====\n";
-            if (warns.empty()) {
-                cout << "No warnings.\n";
-            } else {
-                for (size_t i = 0; i < warns.size(); ++i) {
-                    cout << "[" << i + 1 << "] " << warns[i] << "\n"
-                    << "----------------------------------------\n";
-                }
-            }
+            cout << "Abnormal return model (1 = market-adjusted, 2 = market model): ";
+            int modelChoice;
+            cin >> modelChoice;
+            if (cin.fail()) { cin.clear(); cin.ignore(1000, '\n'); modelChoice = 1; }
+            g_arModel = (modelChoice == 2) ? AbnormalReturnModel::MarketModel
+                                           : AbnormalReturnModel::MarketAdjusted;
 
-            // --- D. Prepare Bootstrap Data ---
-            cout << ">>> Preparing Data for Bootstrap..." << endl;
-            
-            vector<Stock> beatVec, meetVec, missVec;
-            int validCount = StockGrouper::extractValidGroups(g_stockMap, beatVec, meetVec, missVec);
+            // Estimation window [-250, -30], pulled back so it never overlaps the event window
+            EstimationWindow estWindow;
+            estWindow.end = min(estWindow.end, -g_N);
 
-            cout << "    [Data Summary] Beat: " << beatVec.size() 
-                 << ", Meet: " << meetVec.size() 
-                 << ", Miss: " << missVec.size() 
-                 << " (Total Valid: " << validCount << ")" << endl;
+            // The previous run's panel is the only user of the run arena; drop it and rewind
+            g_returnPanel.reset();
+            runArena().reset();  // [From RunArena.h]
+    
+            // The prefetcher's queue is cancelled; what it has journaled is used below
+            if (g_prefetcher.started()) {
+                g_prefetcher.stop();
+                cout << "    [Prefetch] ";
+                g_prefetcher.report(cout);
+                cout << endl;
+            }
 
-            // --- E. Run Bootstrap and Statistical Calculations ---
-            
             // Each time Option 1 is re-run, first clear the old StatCalculator.
             if(g_statCalc) { delete g_statCalc; g_statCalc = nullptr; }
-            
-            // 40 iterations, with 30 samples taken each time
-            Bootstrapper bootstrap(g_N, 40, 30);
-            GroupBootstrapResult beatResult, meetResult, missResult;
-
-            bootstrap.runBootstrap(missVec, meetVec, beatVec, missResult, meetResult, beatResult);
-            
-            // Create a new statistical calculator and save to global pointer.
-            g_statCalc = new StatCalculator(g_N);
-            g_statCalc->computeForAllGroup(missResult, meetResult, beatResult);
+            g_calcReady = false;
+            g_dataLoaded = true;  // Option 2 shows each event as it is committed
 
-            cout << ">>> Calculations Complete. Data ready for plotting." << endl;
-
-            g_dataLoaded = true;
-            g_calcReady = true;
-            curl_easy_cleanup(curl);
+            // --- B-E. Pull and compute on g_runThread; the report goes to g_runLogFile ---
+            g_live.reset(g_N, g_registry.size());
+            g_runActive = true;
+            g_runThread = thread(runPull, g_N, estWindow);
+            cout << "[Run] Option 1 started in the background (N = " << g_N << ", "
+                 << g_registry.size() << " events); report in " << g_runLogFile << "." << endl;
+            cout << "      Options 2-4 are available meanwhile; 3 and 4 show the live estimate." << endl;
         }
         
         // =================================================
@@ -230,14 +1054,17 @@ int main()
                 }
                 // ------------------------------------
 
-                if (!g_stockMap.count(t)) {
+                // A ticker may have several announcements; show every event
+                EventIdRange ids = g_registry.findTicker(t);
+                if (ids.empty()) {
                     cout << "Ticker not found. Please try again.\n";
                     continue;
                 }
 
-                Stock& s = g_stockMap[t];
                 cout << "\n========== Information for " << t << " ==========\n";
-                cout << s << endl;
+                for (EventId id = ids.begin; id < ids.end; ++id) {
+                    cout << g_registry.snapshot(id) << endl;
+                }
                 break;
             }
         }
@@ -248,7 +1075,7 @@ int main()
         // =================================================
         else if (choice == 3) 
         {
-            if(!g_calcReady || !g_statCalc) { cout << "Data not loaded yet. Please run Option 1 first." << endl; continue; } //Check if option1 is run
+            if(!g_runActive && (!g_calcReady || !g_statCalc)) { cout << "Data not loaded yet. Please run Option 1 first." << endl; continue; } //Check if option1 is run
             
             bool exit = false;
             while(!exit){
@@ -281,12 +1108,19 @@ int main()
 
                 int idx = g - 1;
 
+                // While Option 1 runs, the estimate from the events committed so far stands in
+                LiveGroupSnapshot live;
+                unique_ptr<StatCalculator> liveCalc;
+                if (g_runActive) liveCalc = liveEstimate(live, cout);
+                const StatCalculator* calc = liveCalc ? liveCalc.get() : g_statCalc;
+                if (!calc) { cout << "Option 1 did not complete. Please run it again." << endl; break; }
+
                 // group name
                 string groupName;
                 if (g == 1) groupName = "Miss";
                 else if (g == 2) groupName = "Meet";
                 else groupName = "Beat";
-                const Matrix& resultMatrix = g_statCalc->getResultMatrix();
+                const Matrix& resultMatrix = calc->getResultMatrix();
 
                 cout << "\n========== Group Summary: " << groupName << " ==========\n";
                 cout << setprecision(6);
@@ -294,6 +1128,40 @@ int main()
                 cout << "AAR STD        : " << resultMatrix[idx][1] << endl;
                 cout << "Expected CAAR  : " << resultMatrix[idx][2] << endl;
                 cout << "CAAR STD       : " << resultMatrix[idx][3] << endl;
+                if (calc->getStdEstimate() == StdEstimate::Analytic)
+                    cout << "STD estimate   : analytic sd / sqrt(" << g_sampleSize << ") of the exact group sums, "
+                         << "not bootstrapped; Option 1 re-runs the bootstrap" << endl;
+                else
+                    cout << "STD estimate   : bootstrap, " << g_numResamples << " resamples of " << g_sampleSize << endl;
+
+                const EventTestResult& tests = (g == 1) ? calc->getMissTests()
+                                             : (g == 2) ? calc->getMeetTests()
+                                                        : calc->getBeatTests();
+
+                if (!tests.car.empty()) {
+                    cout << "\n----- Event-Study Tests (CAR windows, n = " << tests.car[0].n
+                         << ", standardized n = " << tests.car[0].nStd << ") -----\n";
+                    cout << left
+                        << setw(W_COL) << "Window"
+                        << setw(W_COL) << "Mean CAR"
+                        << setw(W_COL) << "t_CS"
+                        << setw(W_COL) << "Patell Z"
+                        << setw(W_COL) << "BMP t"
+                        << setw(W_COL) << "Corrado"
+                        << "\n";
+                    for (size_t w = 0; w < tests.car.size(); ++w) {
+                        const EventTestRow& r = tests.car[w];
+                        string win = "[" + to_string(tests.carWindows[w].first) + "," + to_string(tests.carWindows[w].second) + "]";
+                        cout << left
+                            << setw(W_COL) << win
+                            << setw(W_COL) << fixed << setprecision(6) << r.meanAR
+                            << setw(W_COL) << fixed << setprecision(3) << r.tCS
+                            << setw(W_COL) << fixed << setprecision(3) << r.patellZ
+                            << setw(W_COL) << fixed << setprecision(3) << r.bmpT
+                            << setw(W_COL) << fixed << setprecision(3) << r.corradoT
+                            << "\n";
+                    }
+                }
 
                 cout << "====================================================\n";
 
@@ -305,9 +1173,9 @@ int main()
                 {
                     const GroupStats* statsptr;
 
-                    if (g == 1) statsptr = &g_statCalc->getMissStats();
-                    else if (g == 2) statsptr = &g_statCalc->getMeetStats();
-                    else statsptr = &g_statCalc->getBeatStats();
+                    if (g == 1) statsptr = &calc->getMissStats();
+                    else if (g == 2) statsptr = &calc->getMeetStats();
+                    else statsptr = &calc->getBeatStats();
 
                     const GroupStats& stats = *statsptr;
 
@@ -319,7 +1187,7 @@ int main()
                         << setw(W_COL) << "CAAR_mean"
                         << setw(W_COL) << "CAAR_std"
                         << "\n";
-                    int N = g_statCalc->getN();
+                    int N = calc->getN();
                         // Print rows
                     for (int t = -N+1; t <= N; ++t) {
                         int date = t + N;    // map -N+1,..N → 1,..2N // cause we do not have return in the first day
@@ -332,6 +1200,29 @@ int main()
                             << setw(W_COL) << fixed << setprecision(6) << stats.CAAR_std[date-1]
                             << "\n";
                     }
+
+                    if (!tests.daily.empty()) {
+                        cout << "\n===== Event-Study Tests for " << groupName << " =====\n";
+                        cout << left
+                            << setw(W_T)   << "t"
+                            << setw(W_COL) << "Mean AR"
+                            << setw(W_COL) << "t_CS"
+                            << setw(W_COL) << "Patell Z"
+                            << setw(W_COL) << "BMP t"
+                            << setw(W_COL) << "Corrado"
+                            << "\n";
+                        for (size_t i = 0; i < tests.daily.size(); ++i) {
+                            const EventTestRow& r = tests.daily[i];
+                            cout << left
+                                << setw(W_T)   << tests.days[i]
+                                << setw(W_COL) << fixed << setprecision(6) << r.meanAR
+                                << setw(W_COL) << fixed << setprecision(3) << r.tCS
+                                << setw(W_COL) << fixed << setprecision(3) << r.patellZ
+                                << setw(W_COL) << fixed << setprecision(3) << r.bmpT
+                                << setw(W_COL) << fixed << setprecision(3) << r.corradoT
+                                << "\n";
+                        }
+                    }
                 }
             }
         }
@@ -341,22 +1232,212 @@ int main()
         // =================================================
         else if (choice == 4) 
         {
-            // 1. Check if the data is ready
+            // 1. While Option 1 runs, re-plot the estimate from the events committed so far
+            Gnuplot plotter;
+            if (g_runActive) {
+                LiveGroupSnapshot live;
+                unique_ptr<StatCalculator> liveCalc = liveEstimate(live, cout);
+                plotter.plotCAAR(liveCalc->getCAARMeanForGnuplot(), liveCalc->getN(),
+                                 "Live CAAR estimate (" + to_string(live.completed) + "/" + to_string(live.total) + " events)");
+                continue;
+            }
+
+            // 2. Check if the data is ready
             if(!g_calcReady || !g_statCalc) 
             { 
                 cout << "Data not loaded yet. Please run Option 1 first." << endl; 
                 continue; 
             } 
             
-            Gnuplot plotter;
             plotter.plotCAAR(g_statCalc->getCAARMeanForGnuplot(), g_statCalc->getN());
         }
 
         // =================================================
-        // Option 5: Exit
+        // Option 5: Sample-Size Sweep
         // =================================================
-        else if (choice == 5) 
+        else if (choice == 5)
         {
+            if (g_runActive) { cout << "Option 1 is still running; this needs its final results." << endl; continue; }
+            if(!g_calcReady || !g_statCalc) { cout << "Data not loaded yet. Please run Option 1 first." << endl; continue; }
+
+            // --- A. Read the list of sample sizes ---
+            vector<int> sizes;
+            cout << "Enter sample sizes separated by spaces (blank for 10 20 30 50 100): ";
+            cin.ignore(1000, '\n');
+            string line;
+            getline(cin, line);
+            stringstream ss(line);
+            int m;
+            while (ss >> m) { if (m > 0) sizes.push_back(m); }
+            if (sizes.empty()) sizes = {10, 20, 30, 50, 100};
+
+            // --- B. One stream of draws per group, evaluated at every size ---
+            // The groups and resample count of Option 1, so the M = 30 row measures the
+            // estimator Option 3 reports; under --seed it makes Option 1's very draws
+            vector<Stock> beatVec, meetVec, missVec;
+            StockGrouper::extractValidGroups(g_registry, beatVec, meetVec, missVec);
+
+            int N = g_statCalc->getN();
+            Bootstrapper bootstrap(N, g_numResamples, g_sampleSize);
+            if (g_hasSeed) bootstrap.setSeed(g_seed);
+            SampleSizeSweepResult missSweep, meetSweep, beatSweep;
+            bootstrap.runSampleSizeSweep(missVec, meetVec, beatVec, sizes, missSweep, meetSweep, beatSweep);
+
+            // --- C. Report dispersion against M ---
+            const SampleSizeSweepResult* sweeps[3] = { &missSweep, &meetSweep, &beatSweep };
+            const char* names[3] = { "Miss", "Meet", "Beat" };
+            const size_t groupSizes[3] = { missVec.size(), meetVec.size(), beatVec.size() };
+
+            for (int g = 0; g < 3; ++g) {
+                vector<SampleSizeDispersion> rows = g_statCalc->computeSampleSizeDispersion(*sweeps[g]);
+
+                cout << "\n===== Sample-Size Sweep: " << names[g] << " =====\n";
+                cout << left
+                    << setw(W_T)   << "M"
+                    << setw(W_COL) << "AAR_std"
+                    << setw(W_COL) << "CAAR_std"
+                    << setw(W_COL + 4) << "CAAR_std*sqrtM"
+                    << "\n";
+                for (const auto& r : rows) {
+                    cout << left
+                        << setw(W_T)   << r.sampleSize
+                        << setw(W_COL) << fixed << setprecision(6) << r.avgAARStd
+                        << setw(W_COL) << fixed << setprecision(6) << r.finalCAARStd
+                        << setw(W_COL + 4) << fixed << setprecision(6) << r.scaledCAARStd
+                        << "\n";
+                }
+                if (!sweeps[g]->droppedSizes.empty()) {
+                    cout << "Not run, above the group's " << groupSizes[g] << " stocks: M =";
+                    for (int dm : sweeps[g]->droppedSizes) cout << " " << dm;
+                    cout << "\n";
+                }
+
+                double slope = StatCalculator::dispersionScalingExponent(rows);
+                if (std::isnan(slope)) {
+                    cout << "Scaling exponent: n/a (need at least two sample sizes)\n";
+                } else {
+                    cout << "Scaling exponent: CAAR_std ~ M^" << fixed << setprecision(3) << slope
+                         << " (iid sampling predicts -0.5)\n";
+                }
+            }
+        }
+
+        // =================================================
+        // Option 6: Quantile CAAR Ladder
+        // =================================================
+        else if (choice == 6)
+        {
+            if (g_runActive) { cout << "Option 1 is still running; this needs its final results." << endl; continue; }
+            if(!g_calcReady || !g_statCalc) { cout << "Data not loaded yet. Please run Option 1 first." << endl; continue; }
+
+            // --- A. Pick a scheme: a precomputed default or a custom one ---
+            const vector<GroupingScheme>& schemes = g_quantileGroups.schemes;
+            cout << "\nSelect Grouping Scheme:\n";
+            for (size_t i = 0; i < schemes.size(); ++i) {
+                cout << i + 1 << ". " << schemes[i].name << " (" << schemes[i].numGroups << " groups, "
+                     << schemes[i].trimFraction * 100 << "% trim)\n";
+            }
+            cout << schemes.size() + 1 << ". Custom\n";
+            cout << "Enter choice: ";
+
+            int sel;
+            cin >> sel;
+            if (cin.fail() || sel < 1 || sel > static_cast<int>(schemes.size()) + 1) {
+                cin.clear();
+                cin.ignore(1000, '\n');
+                cout << "Invalid selection.\n";
+                continue;
+            }
+
+            QuantileGrouping custom;
+            const QuantileGrouping* grouping = &g_quantileGroups;
+            int schemeIdx = sel - 1;
+
+            if (sel == static_cast<int>(schemes.size()) + 1) {
+                GroupingScheme scheme;
+                double trimPct;
+                cout << "Number of groups (2-20): ";
+                cin >> scheme.numGroups;
+                cout << "Trim per side in % (0-20): ";
+                cin >> trimPct;
+                if (cin.fail() || scheme.numGroups < 2 || scheme.numGroups > 20 || trimPct < 0 || trimPct > 20) {
+                    cin.clear();
+                    cin.ignore(1000, '\n');
+                    cout << "Invalid scheme.\n";
+                    continue;
+                }
+                scheme.name = "Custom";
+                scheme.trimFraction = trimPct / 100.0;
+                custom = StockGrouper::assignQuantileGroups(g_groupingKeys, {scheme});
+                grouping = &custom;
+                schemeIdx = 0;
+            }
+
+            // --- B. Bucket stocks with valid abnormal returns by quantile ---
+            const GroupingScheme& scheme = grouping->schemes[schemeIdx];
+            const vector<int>& labels = grouping->labels[schemeIdx];
+            int N = g_statCalc->getN();
+
+            // Tercile outliers stay in the registry ungrouped, so every member is fetched; a member
+            // without abnormal returns (no prices, or not in a snapshot from an older build) is dropped
+            vector<vector<Stock>> buckets(scheme.numGroups);
+            vector<size_t> dropped(scheme.numGroups, 0);
+            for (size_t i = 0; i < grouping->keys.size(); ++i) {
+                if (labels[i] < 0) continue;
+                EventId id = g_registry.find(EventKey(grouping->keys[i].ticker, grouping->keys[i].date));
+                if (id == kNoEvent) { ++dropped[labels[i]]; continue; }
+                Stock s = g_registry.snapshot(id);
+                if (static_cast<int>(s.getAbnormReturns().size()) != 2 * N) { ++dropped[labels[i]]; continue; }
+                buckets[labels[i]].push_back(std::move(s));
+            }
+
+            // --- C. Bootstrap each rung and print the ladder ---
+            Bootstrapper bootstrap(N, g_numResamples, g_sampleSize);
+            cout << "\n===== CAAR Ladder: " << scheme.name << " =====\n";
+            cout << left
+                << setw(W_T)   << "Group"
+                << setw(W_T + 2) << "Stocks"
+                << setw(W_T + 2) << "Dropped"
+                << setw(W_COL) << "AAR_mean"
+                << setw(W_COL) << "CAAR_mean"
+                << setw(W_COL) << "CAAR_std"
+                << "\n";
+            for (int q = 0; q < scheme.numGroups; ++q) {
+                GroupStats stats = g_statCalc->computeForOneGroup(bootstrap.bootstrapSingleGroup(buckets[q]));
+                double aar = 0.0;
+                for (double v : stats.AAR_mean) aar += v;
+                if (!stats.AAR_mean.empty()) aar /= stats.AAR_mean.size();
+
+                cout << left
+                    << setw(W_T)   << StockGrouper::labelName(scheme, q)
+                    << setw(W_T + 2) << buckets[q].size()
+                    << setw(W_T + 2) << dropped[q]
+                    << setw(W_COL) << fixed << setprecision(6) << aar
+                    << setw(W_COL) << fixed << setprecision(6) << (stats.CAAR_mean.empty() ? 0.0 : stats.CAAR_mean.back())
+                    << setw(W_COL) << fixed << setprecision(6) << (stats.CAAR_std.empty() ? 0.0 : stats.CAAR_std.back())
+                    << "\n";
+            }
+        }
+
+        // =================================================
+        // Option 7: Incremental refresh from the earnings file
+        // =================================================
+        else if (choice == 7)
+        {
+            if (g_runActive) { cout << "Option 1 is still running; refresh once it has finished." << endl; continue; }
+
+            if (!refreshUniverse(earningFile, sectorFile)) continue;
+            inputsFingerprint = fingerprintInputs({ earningFile, sectorFile }, importPath);
+            if (useSnapshot) saveSession(inputsFingerprint);
+        }
+
+        // =================================================
+        // Option 8: Exit
+        // =================================================
+        else if (choice == 8) 
+        {
+            if (g_runActive) cout << "Waiting for Option 1 to finish..." << endl;
+            joinRun(useSnapshot, inputsFingerprint, true);
             cout << "Exiting program..." << endl;
             break;
         }
@@ -364,7 +1445,7 @@ int main()
         // Handle invalid input
         else 
         {
-            cout << "Invalid choice. Please enter 1-5." << endl;
+            cout << "Invalid choice. Please enter 1-8." << endl;
         }
 
     }
@@ -380,7 +1461,10 @@ int main()
         g_statCalc = nullptr;
     }
 
-    // 2. Release global resources of Libcurl
+    // 2. Cancel the background prefetch: queued downloads are dropped, not finished
+    g_prefetcher.stop();
+
+    // 3. Release global resources of Libcurl
     curl_global_cleanup();
     
     return 0;